@@ -8,9 +8,18 @@
 #include "engine/api_private.hpp"
 
 blit::AudioChannel channels[CHANNEL_COUNT];
+blit::AudioCommandQueue audio_commands;
 
-Audio::Audio() {
+Audio::Audio(bool output) {
     blit::api.channels = channels;
+    blit::api.audio_commands = &audio_commands;
+
+    blit::api.audio_channel_count = CHANNEL_COUNT;
+    blit::api.audio_sample_rate = blit::sample_rate;
+    blit::api.audio_channel_size = sizeof(blit::AudioChannel);
+
+    if(!output)
+        return;
 
     SDL_AudioSpec desired = {}, audio_spec = {};
 
@@ -33,18 +42,18 @@ Audio::Audio() {
 }
 
 Audio::~Audio() {
+    if(!audio_device)
+        return;
+
     SDL_PauseAudioDevice(audio_device, 1);
     SDL_CloseAudioDevice(audio_device);
 }
 
 void _audio_bufferfill(short *buffer, int buffer_size){
-    memset(buffer, 0, buffer_size);
-
-    for(auto sample = 0; sample < buffer_size; sample++){
-        buffer[sample] = (int)blit::get_audio_frame() - 0x8000;
-    }
+    blit::get_audio_frames(buffer, buffer_size);
 }
 
 void _audio_callback(void *userdata, uint8_t *stream, int len){
+    blit::PhaseTimer phase_timer(blit::EnginePhase::AUDIO);
     _audio_bufferfill((short *)stream, len / 2);
 }
@@ -1,12 +1,14 @@
+#include "audio/audio.hpp"
+
 class Audio {
 	public:
-		Audio();
+		Audio(bool output = true); // without output, samples are only made by calling _audio_bufferfill
 		~Audio();
 
 	private:
-        const unsigned int _sample_rate = 22050;
+        const unsigned int _sample_rate = blit::sample_rate;
 
-        SDL_AudioDeviceID audio_device;
+        SDL_AudioDeviceID audio_device = 0;
 };
 
 void _audio_bufferfill(short *pBuffer, int pBufferSize);
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include "SDL.h"
+
+#include "Audio.hpp"
+#include "Headless.hpp"
+#include "System.hpp"
+
+#include "32blit.hpp"
+#include "engine/running_average.hpp"
+
+static void usage() {
+	std::cerr << "Headless options:\n"
+		<< "  --headless           run without a window or audio output\n"
+		<< "  --frames N           number of frames to run (default 1000)\n"
+		<< "  --frame-ms N         advance a virtual clock by N ms each frame instead of using the real time\n"
+		<< "  --seed N             seed for blit::random (default 0)\n"
+		<< "  --hash FRAMES        print a hash of the screen at these frames\n"
+		<< "  --dump FRAMES        save the screen at these frames as <prefix>-<frame>.bmp\n"
+		<< "  --dump-prefix PATH   start of the file names for --dump (default \"frame\")\n"
+		<< "  --csv FILE           write the timings of each frame to a CSV file\n"
+		<< "FRAMES is a comma separated list of frame numbers, starting at 1, or \"all\".\n";
+}
+
+static bool parse_number(const char *str, uint32_t &value) {
+	if (!str || !*str)
+		return false;
+
+	char *end;
+	auto parsed = strtoul(str, &end, 10);
+	if (*end || parsed > UINT32_MAX)
+		return false;
+
+	value = parsed;
+	return true;
+}
+
+static uint32_t us_between(Uint64 start, Uint64 end) {
+	return (end - start) * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+static void print_stats(const char *name, const blit::RunningAverage<uint32_t> &times) {
+	printf("%-8s avg %7u  min %7u  p50 %7u  p95 %7u  p99 %7u  max %7u us\n", name,
+		times.average(), times.min(), times.percentile(50), times.percentile(95), times.percentile(99), times.max());
+}
+
+bool Headless::FrameList::parse(const char *list) {
+	if (!list)
+		return false;
+
+	if (strcmp(list, "all") == 0) {
+		all = true;
+		return true;
+	}
+
+	std::string str(list);
+	size_t pos = 0;
+
+	while (pos <= str.length()) {
+		auto comma = str.find(',', pos);
+		if (comma == std::string::npos)
+			comma = str.length();
+
+		uint32_t frame;
+		if (!parse_number(str.substr(pos, comma - pos).c_str(), frame) || frame == 0)
+			return false;
+
+		frames.insert(frame);
+		pos = comma + 1;
+	}
+
+	return true;
+}
+
+bool Headless::FrameList::contains(uint32_t frame) const {
+	return all || frames.count(frame);
+}
+
+bool Headless::requested(int argc, char *argv[]) {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0)
+			return true;
+	}
+
+	return false;
+}
+
+bool Headless::parse_args(int argc, char *argv[]) {
+	for (int i = 1; i < argc; i++) {
+		auto arg = argv[i];
+		auto value = i + 1 < argc ? argv[i + 1] : nullptr;
+		bool ok = true;
+
+		if (strcmp(arg, "--headless") == 0)
+			continue;
+		else if (strcmp(arg, "--frames") == 0)
+			ok = parse_number(value, num_frames) && num_frames > 0;
+		else if (strcmp(arg, "--frame-ms") == 0)
+			ok = parse_number(value, frame_ms);
+		else if (strcmp(arg, "--seed") == 0)
+			ok = parse_number(value, seed);
+		else if (strcmp(arg, "--hash") == 0)
+			ok = hash_frames.parse(value);
+		else if (strcmp(arg, "--dump") == 0)
+			ok = dump_frames.parse(value);
+		else if (strcmp(arg, "--dump-prefix") == 0 && value)
+			dump_prefix = value;
+		else if (strcmp(arg, "--csv") == 0 && value)
+			csv_path = value;
+		else if (strcmp(arg, "--dump-prefix") == 0 || strcmp(arg, "--csv") == 0)
+			ok = false;
+		else {
+			std::cerr << "Unknown option: " << arg << std::endl;
+			usage();
+			return false;
+		}
+
+		if (!ok) {
+			std::cerr << "Bad value for " << arg << ": " << (value ? value : "(none)") << std::endl;
+			usage();
+			return false;
+		}
+
+		i++; // skip the value
+	}
+
+	return true;
+}
+
+int Headless::run() {
+	if (SDL_Init(0) < 0) {
+		fprintf(stderr, "could not initialize SDL2: %s\n", SDL_GetError());
+		return 1;
+	}
+
+	FILE *csv = nullptr;
+	if (!csv_path.empty()) {
+		csv = fopen(csv_path.c_str(), "w");
+		if (!csv) {
+			fprintf(stderr, "could not open %s\n", csv_path.c_str());
+			return 1;
+		}
+
+		fprintf(csv, "frame,time_ms,frame_us,tick_us,render_us,updates");
+		for (int i = 0; i < int(blit::EnginePhase::COUNT); i++)
+			fprintf(csv, ",%s_us", blit::get_phase_name(blit::EnginePhase(i)));
+		fprintf(csv, "\n");
+	}
+
+	sys = new System();
+	Audio audio(false);
+
+	sys->set_random_seed(seed);
+	if (frame_ms)
+		sys->set_virtual_time(0);
+
+	sys->run_headless();
+
+	blit::RunningAverage<uint32_t> frame_times(num_frames), tick_times(num_frames), render_times(num_frames);
+
+	auto run_start = SDL_GetPerformanceCounter();
+
+	for (uint32_t frame = 1; frame <= num_frames; frame++) {
+		if (frame_ms)
+			sys->set_virtual_time(frame * frame_ms);
+
+		auto frame_start = SDL_GetPerformanceCounter();
+
+		sys->loop();
+
+		auto render_start = SDL_GetPerformanceCounter();
+
+		sys->render_headless();
+
+		auto render_end = SDL_GetPerformanceCounter();
+
+		fill_audio(blit::now());
+
+		auto frame_end = SDL_GetPerformanceCounter();
+
+		blit::end_stats_frame();
+
+		uint32_t frame_us = us_between(frame_start, frame_end);
+		uint32_t tick_us = us_between(frame_start, render_start);
+		uint32_t render_us = us_between(render_start, render_end);
+
+		frame_times.add(frame_us);
+		tick_times.add(tick_us);
+		render_times.add(render_us);
+
+		if (csv) {
+			auto stats = blit::get_engine_frame_stats();
+
+			fprintf(csv, "%u,%u,%u,%u,%u,%u", frame, blit::now(), frame_us, tick_us, render_us, stats ? stats->updates : 0);
+			for (uint32_t i = 0; i < blit::engine_stats_phases; i++)
+				fprintf(csv, ",%u", stats ? stats->phase_us[i] : 0);
+			fprintf(csv, "\n");
+		}
+
+		capture(frame);
+	}
+
+	double total_s = double(SDL_GetPerformanceCounter() - run_start) / SDL_GetPerformanceFrequency();
+
+	printf("%u frames in %.3fs (%.1f fps)\n", num_frames, total_s, num_frames / total_s);
+	print_stats("frame", frame_times);
+	print_stats("tick", tick_times);
+	print_stats("render", render_times);
+
+	if (csv)
+		fclose(csv);
+
+	sys->stop();
+	delete sys;
+	sys = nullptr;
+
+	SDL_Quit();
+	return 0;
+}
+
+// makes the samples that would have been played by now, so that the audio still takes time and
+// anything waiting on it (queued commands, sequencers) keeps going
+void Headless::fill_audio(uint32_t time) {
+	blit::PhaseTimer phase_timer(blit::EnginePhase::AUDIO);
+
+	const uint64_t target = uint64_t(time) * blit::sample_rate / 1000;
+	int16_t buffer[256];
+
+	while (audio_samples < target) {
+		int count = std::min(target - audio_samples, uint64_t(std::size(buffer)));
+		_audio_bufferfill(buffer, count);
+		audio_samples += count;
+	}
+}
+
+void Headless::capture(uint32_t frame) {
+	bool do_hash = hash_frames.contains(frame), do_dump = dump_frames.contains(frame);
+	if (!do_hash && !do_dump)
+		return;
+
+	static uint8_t buf[320 * 240 * 3];
+	int width, height;
+	auto pixels = sys->get_screen_rgb(buf, width, height);
+
+	if (do_hash) {
+		// FNV-1a of the size and pixels
+		uint64_t hash = 0xcbf29ce484222325;
+		auto add = [&hash](uint8_t byte) {
+			hash = (hash ^ byte) * 0x100000001b3;
+		};
+
+		add(width >> 8); add(width);
+		add(height >> 8); add(height);
+
+		for (int i = 0; i < width * height * 3; i++)
+			add(pixels[i]);
+
+		printf("frame %u hash %016" PRIx64 "\n", frame, hash);
+	}
+
+	if (do_dump) {
+		char filename[32];
+		snprintf(filename, sizeof(filename), "-%05u.bmp", frame);
+		auto path = dump_prefix + filename;
+
+		auto surface = SDL_CreateRGBSurfaceWithFormatFrom((void *)pixels, width, height, 24, width * 3, SDL_PIXELFORMAT_RGB24);
+
+		if (!surface || SDL_SaveBMP(surface, path.c_str()) != 0)
+			fprintf(stderr, "could not save %s: %s\n", path.c_str(), SDL_GetError());
+
+		SDL_FreeSurface(surface);
+	}
+}
@@ -0,0 +1,40 @@
+#include <cstdint>
+#include <set>
+#include <string>
+
+class System;
+
+// Runs the game without a window or audio device for a number of frames as fast as possible,
+// printing timing statistics and optionally hashing or saving the screen at chosen frames.
+class Headless {
+	public:
+		static bool requested(int argc, char *argv[]);
+
+		bool parse_args(int argc, char *argv[]);
+		int run();
+
+	private:
+		struct FrameList {
+			bool all = false;
+			std::set<uint32_t> frames;
+
+			bool parse(const char *list);
+			bool contains(uint32_t frame) const;
+		};
+
+		void fill_audio(uint32_t time);
+		void capture(uint32_t frame);
+
+		System *sys = nullptr;
+
+		uint32_t num_frames = 1000;
+		uint32_t frame_ms = 0; // virtual clock step, 0 to use the real clock
+		uint32_t seed = 0;
+
+		FrameList hash_frames;
+		FrameList dump_frames;
+		std::string dump_prefix = "frame";
+		std::string csv_path;
+
+		uint64_t audio_samples = 0;
+};
@@ -1,37 +1,35 @@
 #include <cstdint>
 
-#include "SDL.h"
-#include "SDL_image.h"
-
 #include "JPEG.hpp"
 
-static blit::JPEGImage decode_jpeg_rwops(SDL_RWops *rwops)
-{
-  auto image = IMG_LoadJPG_RW(rwops);
-  SDL_RWclose(rwops);
-  blit::JPEGImage ret = {};
-
-  if(!image)
-    return ret;
-
-  ret.size = blit::Size(image->w, image->h);
+// uses the engine's software decoder, so the SDL build accepts the same files as games decoding with JPEGDecoder
+static blit::JPEGImage decode_jpeg(blit::JPEGDecoder &decoder, blit::AllocateCallback alloc) {
+  auto size = decoder.get_size();
+  if(size.empty())
+    return {};
 
-  // FIXME: assuming surface is RGB
-  ret.data = new uint8_t[image->w * image->h * 3];
-  memcpy(ret.data, image->pixels, image->w * image->h * 3);
+  auto data = alloc(size.w * size.h * 3);
+  if(!data)
+    return {};
 
-  SDL_FreeSurface(image);
+  // the game owns the buffer once it's allocated, so it's returned even if the data is corrupt (same as the device)
+  decoder.decode(data, size.w * 3);
 
-  return ret;
+  return {size, data};
 }
 
-// these don't bother using the allocation callback since there's only one heap anyway
 blit::JPEGImage blit_decode_jpeg_buffer(const uint8_t *ptr, uint32_t len, blit::AllocateCallback alloc) {
-  auto rwops = SDL_RWFromConstMem(ptr, len);
-  return decode_jpeg_rwops(rwops);
+  blit::JPEGDecoder decoder;
+  if(!decoder.open(ptr, len))
+    return {};
+
+  return decode_jpeg(decoder, alloc);
 }
 
 blit::JPEGImage blit_decode_jpeg_file(const std::string &filename, blit::AllocateCallback alloc) {
-  auto rwops = SDL_RWFromFile(filename.c_str(), "rb");
-  return decode_jpeg_rwops(rwops);
+  blit::JPEGDecoder decoder;
+  if(!decoder.open(filename))
+    return {};
+
+  return decode_jpeg(decoder, alloc);
 }
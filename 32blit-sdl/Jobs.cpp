@@ -0,0 +1,152 @@
+#include "SDL.h"
+
+#include "Jobs.hpp"
+
+JobPool *blit_jobs = nullptr;
+
+// index of the worker running on this thread, -1 for threads outside the pool
+static thread_local int current_worker = -1;
+
+struct WorkerStart {
+	JobPool *pool;
+	int index;
+};
+
+static int worker_thread(void *ptr) {
+	auto start = static_cast<WorkerStart *>(ptr);
+	auto pool = start->pool;
+	int index = start->index;
+	delete start;
+
+	return pool->worker_thread(index);
+}
+
+JobPool::JobPool(int num_workers) {
+	s_work = SDL_CreateSemaphore(0);
+
+	workers.resize(num_workers);
+
+	for(auto &worker : workers)
+		worker.m_queue = SDL_CreateMutex();
+
+	for(int i = 0; i < num_workers; i++)
+		workers[i].thread = SDL_CreateThread(::worker_thread, "Job", new WorkerStart{this, i});
+}
+
+JobPool::~JobPool() {
+	running = false;
+
+	for(size_t i = 0; i < workers.size(); i++)
+		SDL_SemPost(s_work);
+
+	// workers may look at each other's queues until they have all stopped
+	for(auto &worker : workers)
+		SDL_WaitThread(worker.thread, nullptr);
+
+	for(auto &worker : workers)
+		SDL_DestroyMutex(worker.m_queue);
+
+	SDL_DestroySemaphore(s_work);
+}
+
+void JobPool::submit(blit::jobs::JobFunc func, void *data) {
+	// jobs created by a job go to the same worker, others are spread out
+	int index = current_worker != -1 ? current_worker : next_worker++ % workers.size();
+	auto &worker = workers[index];
+
+	SDL_LockMutex(worker.m_queue);
+	worker.queue.push_back({func, data});
+	SDL_UnlockMutex(worker.m_queue);
+
+	SDL_SemPost(s_work);
+}
+
+// called while waiting for jobs, so that waiting threads help instead of blocking
+void JobPool::help() {
+	Job job;
+
+	if(pop(current_worker, job) || steal(current_worker, job))
+		job.func(job.data);
+	else
+		SDL_Delay(0);
+}
+
+int JobPool::get_worker_count() {
+	return workers.size();
+}
+
+int JobPool::worker_thread(int index) {
+	current_worker = index;
+
+	while(running) {
+		Job job;
+
+		if(pop(index, job) || steal(index, job)) {
+			job.func(job.data);
+			continue;
+		}
+
+		SDL_SemWait(s_work);
+	}
+
+	return 0;
+}
+
+// takes the newest job from a worker's own queue
+bool JobPool::pop(int index, Job &job) {
+	if(index == -1)
+		return false;
+
+	auto &worker = workers[index];
+	bool found = false;
+
+	SDL_LockMutex(worker.m_queue);
+	if(!worker.queue.empty()) {
+		job = worker.queue.back();
+		worker.queue.pop_back();
+		found = true;
+	}
+	SDL_UnlockMutex(worker.m_queue);
+
+	return found;
+}
+
+// takes the oldest job from another worker's queue
+bool JobPool::steal(int thief, Job &job) {
+	int count = workers.size();
+	int start = thief == -1 ? 0 : thief + 1;
+
+	for(int i = 0; i < count; i++) {
+		int index = (start + i) % count;
+		if(index == thief)
+			continue;
+
+		auto &worker = workers[index];
+		bool found = false;
+
+		SDL_LockMutex(worker.m_queue);
+		if(!worker.queue.empty()) {
+			job = worker.queue.front();
+			worker.queue.pop_front();
+			found = true;
+		}
+		SDL_UnlockMutex(worker.m_queue);
+
+		if(found)
+			return true;
+	}
+
+	return false;
+}
+
+void blit_submit_job(blit::jobs::JobFunc func, void *data) {
+	blit_jobs->submit(func, data);
+}
+
+void blit_help_jobs() {
+	blit_jobs->help();
+}
+
+uint32_t blit_get_job_worker_count() {
+	return blit_jobs->get_worker_count();
+}
@@ -0,0 +1,48 @@
+#include <atomic>
+#include <deque>
+#include <vector>
+
+#include "engine/jobs.hpp"
+
+// Runs jobs for blit::jobs on a thread per spare core. Each worker has its own queue and
+// takes jobs from the others' when it runs out, so nested jobs stay on the thread that
+// created them where possible.
+class JobPool {
+	public:
+		JobPool(int num_workers);
+		~JobPool();
+
+		void submit(blit::jobs::JobFunc func, void *data);
+		void help();
+
+		int get_worker_count();
+
+		int worker_thread(int index);
+
+	private:
+		struct Job {
+			blit::jobs::JobFunc func;
+			void *data;
+		};
+
+		struct Worker {
+			SDL_Thread *thread = nullptr;
+			SDL_mutex *m_queue = nullptr;
+			std::deque<Job> queue;
+		};
+
+		bool pop(int index, Job &job);
+		bool steal(int thief, Job &job);
+
+		std::vector<Worker> workers;
+
+		SDL_sem *s_work = nullptr;
+		std::atomic<bool> running{true};
+		std::atomic<uint32_t> next_worker{0};
+};
+
+void blit_submit_job(blit::jobs::JobFunc func, void *data);
+void blit_help_jobs();
+uint32_t blit_get_job_worker_count();
+
+extern JobPool *blit_jobs;
@@ -13,8 +13,11 @@
 #include "System.hpp"
 #include "Renderer.hpp"
 #include "Audio.hpp"
+#include "Headless.hpp"
 #include "UserCode.hpp"
 
+#include "engine/engine_stats.hpp"
+
 #ifdef VIDEO_CAPTURE
 #include "VideoCapture.hpp"
 #endif
@@ -60,16 +63,21 @@ void handle_event(SDL_Event &event) {
 		case SDL_KEYDOWN: // fall-though
 		case SDL_KEYUP:
 			if (!blit_input->handle_keyboard(event.key.keysym.sym, event.type == SDL_KEYDOWN)) {
-#ifdef VIDEO_CAPTURE
 				switch (event.key.keysym.sym) {
+				case SDLK_F3:
+					if (event.type == SDL_KEYDOWN && !event.key.repeat)
+						blit::set_stats_overlay(!blit::get_stats_overlay());
+					break;
+#ifdef VIDEO_CAPTURE
 				case SDLK_r:
 					if (event.type == SDL_KEYDOWN && SDL_GetTicks() - last_record_startstop > 1000) {
 						if (blit_capture->recording()) blit_capture->stop();
 						else blit_capture->start();
 						last_record_startstop = SDL_GetTicks();
 					}
-				}
+					break;
 #endif
+				}
 			}
 			break;
 
@@ -141,6 +149,16 @@ int main(int argc, char *argv[]) {
   std::cout << "32Blit SDL2 runtime" << std::endl;
   std::cout << "(c) Pimoroni et.al. 2019-2020" << std::endl;
 
+#ifndef __EMSCRIPTEN__
+	if (Headless::requested(argc, argv)) {
+		Headless headless;
+		if (!headless.parse_args(argc, argv))
+			return 1;
+
+		return headless.run();
+	}
+#endif
+
 	if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_GAMECONTROLLER|SDL_INIT_AUDIO) < 0) {
 		fprintf(stderr, "could not initialize SDL2: %s\n", SDL_GetError());
 		return 1;
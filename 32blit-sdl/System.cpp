@@ -8,6 +8,7 @@
 #include "32blit.hpp"
 #include "UserCode.hpp"
 #include "JPEG.hpp"
+#include "Jobs.hpp"
 
 #include "engine/api_private.hpp"
 
@@ -19,6 +20,8 @@ blit::Surface __fb_lores((uint8_t *)framebuffer, blit::PixelFormat::RGB, blit::S
 
 static blit::Pen palette[256];
 
+static blit::EngineStats engine_stats;
+
 // blit debug callback
 void blit_debug(const char *message) {
 	std::cout << message;
@@ -49,7 +52,12 @@ static void set_screen_palette(const blit::Pen *colours, int num_cols) {
 
 // blit timer callback
 std::chrono::steady_clock::time_point start;
+static bool use_virtual_time = false;
+static uint32_t virtual_time = 0;
 uint32_t now() {
+	if (use_virtual_time)
+		return virtual_time;
+
 	auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
 	return (uint32_t)elapsed.count();
 }
@@ -125,7 +133,7 @@ System::~System() {
 	SDL_DestroySemaphore(s_loop_ended);
 }
 
-void System::run() {
+void System::setup() {
 	running = true;
 
 	start = std::chrono::steady_clock::now();
@@ -158,11 +166,34 @@ void System::run() {
 	blit::api.get_us_timer = ::get_us_timer;
 	blit::api.get_max_us_timer = ::get_max_us_timer;
 
+	blit::api.engine_stats = &engine_stats;
+
 	blit::api.decode_jpeg_buffer = blit_decode_jpeg_buffer;
 	blit::api.decode_jpeg_file = blit_decode_jpeg_file;
 
 	::set_screen_mode(blit::lores);
 
+#ifndef __EMSCRIPTEN__
+	// workers for the spare cores, the loop thread helps while it waits for jobs
+	if(SDL_GetCPUCount() > 1) {
+		blit_jobs = new JobPool(SDL_GetCPUCount() - 1);
+
+		blit::api.submit_job = ::blit_submit_job;
+		blit::api.help_jobs = ::blit_help_jobs;
+		blit::api.get_job_worker_count = ::blit_get_job_worker_count;
+	}
+#endif
+}
+
+void System::stop_jobs() {
+	blit::api.submit_job = nullptr;
+	delete blit_jobs;
+	blit_jobs = nullptr;
+}
+
+void System::run() {
+	setup();
+
 #ifdef __EMSCRIPTEN__
 	::init();
 #else
@@ -171,6 +202,22 @@ void System::run() {
 #endif
 }
 
+// runs init on the calling thread, which then calls loop and render_headless itself
+void System::run_headless() {
+	setup();
+	::init();
+}
+
+// replaces the real clock with one that only changes when this is called
+void System::set_virtual_time(uint32_t time) {
+	use_virtual_time = true;
+	virtual_time = time;
+}
+
+void System::set_random_seed(uint32_t seed) {
+	random_generator.seed(seed);
+}
+
 int System::timer_thread() {
 	// Signal the system loop every 20 msec.
 	int dropped = 0;
@@ -235,26 +282,60 @@ Uint32 System::mode() {
 }
 
 void System::update_texture(SDL_Texture *texture) {
-	blit::render(::now());
+	{
+		blit::PhaseTimer phase_timer(blit::EnginePhase::RENDER);
+		blit::render(::now());
+	}
+
+	if (blit::get_stats_overlay())
+		blit::render_stats_overlay(blit::screen);
+
+	uint32_t flip_start_us = ::get_us_timer();
+
+	uint8_t col_fb[320 * 240 * 3];
+	int width, height;
+	auto pixels = get_screen_rgb(col_fb, width, height);
+
+	SDL_UpdateTexture(texture, nullptr, pixels, width * 3);
+
+	blit::add_phase_time(blit::EnginePhase::FLIP, ::get_us_timer() - flip_start_us);
+	blit::end_stats_frame();
+}
+
+void System::render_headless() {
+	{
+		blit::PhaseTimer phase_timer(blit::EnginePhase::RENDER);
+		blit::render(::now());
+	}
+
+	if (blit::get_stats_overlay())
+		blit::render_stats_overlay(blit::screen);
+}
+
+// returns the framebuffer, or buf (320x240x3) with the colours looked up for paletted modes
+const uint8_t *System::get_screen_rgb(uint8_t *buf, int &width, int &height) {
 	if (_mode == blit::ScreenMode::lores) {
-		SDL_UpdateTexture(texture, nullptr, __fb_lores.data, 160 * 3);
+		width = 160;
+		height = 120;
+		return __fb_lores.data;
 	}
-	else if(_mode == blit::ScreenMode::hires) {
-		SDL_UpdateTexture(texture, nullptr, __fb_hires.data, 320 * 3);
-	} else {
-		uint8_t col_fb[320 * 240 * 3];
 
-		auto in = __fb_hires_pal.data, out = col_fb;
+	width = 320;
+	height = 240;
 
-		for(int i = 0; i < 320 * 240; i++) {
-			uint8_t index = *(in++);
-			(*out++) = palette[index].r;
-			(*out++) = palette[index].g;
-			(*out++) = palette[index].b;
-		}
+	if (_mode == blit::ScreenMode::hires)
+		return __fb_hires.data;
+
+	auto in = __fb_hires_pal.data, out = buf;
 
-		SDL_UpdateTexture(texture, nullptr, col_fb, 320 * 3);
+	for(int i = 0; i < 320 * 240; i++) {
+		uint8_t index = *(in++);
+		(*out++) = palette[index].r;
+		(*out++) = palette[index].g;
+		(*out++) = palette[index].b;
 	}
+
+	return buf;
 }
 
 void System::notify_redraw() {
@@ -291,11 +372,20 @@ void System::stop() {
 	int returnValue;
 	running = false;
 
+	// headless, there are no threads to stop
+	if(!t_system_loop) {
+		stop_jobs();
+		return;
+	}
+
 	if(SDL_SemWaitTimeout(s_loop_ended, 500)) {
 		fprintf(stderr, "User code appears to have frozen. Detaching thread.\n");
 		SDL_DetachThread(t_system_loop);
 	} else {
 		SDL_WaitThread(t_system_loop, &returnValue);
+
+		// a frozen loop thread may still be using the workers, so they are only stopped here
+		stop_jobs();
 	}
 
 	SDL_SemPost(s_timer_stop);
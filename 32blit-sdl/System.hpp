@@ -10,8 +10,12 @@ class System {
 		~System();
 
 		void run();
+		void run_headless();
 		void stop();
 
+		void set_virtual_time(uint32_t time);
+		void set_random_seed(uint32_t seed);
+
 		int update_thread();
 		int timer_thread();
 
@@ -19,6 +23,8 @@ class System {
 
 		Uint32 mode();
 		void update_texture(SDL_Texture *);
+		void render_headless();
+		const uint8_t *get_screen_rgb(uint8_t *buf, int &width, int &height);
 		void notify_redraw();
 
 		void set_joystick(int axis, float value);
@@ -26,6 +32,8 @@ class System {
 		void set_button(int button, bool state);
 
 	private:
+		void setup();
+		void stop_jobs();
 
 		SDL_Thread *t_system_timer = nullptr;
 		SDL_Thread *t_system_loop = nullptr;
@@ -7,6 +7,7 @@ extern DAC_HandleTypeDef hdac1;
 
 extern "C" {
   void TIM6_DAC_IRQHandler(void);
+  void sound_render_audio(void);
   void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);  
 }
 
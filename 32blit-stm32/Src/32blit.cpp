@@ -53,7 +53,7 @@ bool exit_game = false;
 bool toggle_menu = false;
 bool take_screenshot = false;
 const float volume_log_base = 2.0f;
-RunningAverage<float> battery_average(8);
+RunningAverage<float, 8> battery_average;
 float battery = 0.0f;
 uint8_t battery_status = 0;
 uint8_t battery_fault = 0;
@@ -63,6 +63,8 @@ const uint32_t long_press_exit_time = 1000;
 
 __attribute__((section(".persist"))) Persist persist;
 
+static EngineStats engine_stats;
+
 static bool (*do_tick)(uint32_t time) = blit::tick;
 
 // pointers to user code
@@ -154,7 +156,17 @@ const char *battery_charge_status() {
 
 static void do_render() {
   if(display::needs_render) {
-    blit::render(blit::now());
+    // a frame is everything from one render to the next, including the flip in the LTDC interrupt
+    blit::end_stats_frame();
+
+    {
+      PhaseTimer phase_timer(EnginePhase::RENDER);
+      blit::render(blit::now());
+    }
+
+    if(get_stats_overlay())
+      render_stats_overlay(screen);
+
     display::enable_vblank_interrupt();
   }
 }
@@ -231,9 +243,9 @@ enum I2CState {
   PROC_BAT
 };
 
-RunningAverage<float> accel_x(8);
-RunningAverage<float> accel_y(8);
-RunningAverage<float> accel_z(8);
+RunningAverage<float, 8> accel_x;
+RunningAverage<float, 8> accel_y;
+RunningAverage<float, 8> accel_z;
 
 I2CState i2c_state = SEND_ACL;
 uint8_t i2c_buffer[6] = {0};
@@ -397,6 +409,7 @@ void blit_init() {
       lis3dh_init(&hi2c4);
     }
     bq24295_init(&hi2c4);
+    blit::api.version = blit::api_version;
     blit::api.debug = blit_debug;
     blit::api.now = HAL_GetTick;
     blit::api.random = HAL_GetRandom;
@@ -426,6 +439,11 @@ void blit_init() {
     blit::api.get_us_timer = ::get_us_timer;
     blit::api.get_max_us_timer = ::get_max_us_timer;
 
+    // task budgets and frame timing in the engine read the us timer without enabling it
+    ::enable_us_timer();
+
+    blit::api.engine_stats = &engine_stats;
+
     blit::api.decode_jpeg_buffer = blit_decode_jpeg_buffer;
     blit::api.decode_jpeg_file = blit_decode_jpeg_file;
 
@@ -764,7 +782,10 @@ void blit_switch_execution(uint32_t address, bool force_game)
       user_render = (BlitRenderFunction) ((uint8_t *)game_header->render + address);
       user_tick = (BlitTickFunction) ((uint8_t *)game_header->tick + address);
 
-      if(!init(address)) {
+      // games built with an older API would use the wrong layout for the shared audio channels
+      bool compatible = game_header->api_magic == blit::api_game_magic && game_header->api_version >= blit::api_min_game_version;
+
+      if(!compatible || !init(address)) {
         user_render = nullptr;
         user_tick = nullptr;
         // this would just be a return, but qspi is already mapped by this point
@@ -37,6 +37,7 @@ enum MenuItem {
   BACKLIGHT,
   VOLUME,
   SCREENSHOT,
+  FRAME_STATS,
   CONNECTIVITY,
   BATTERY_INFO,
   ABOUT,
@@ -48,6 +49,7 @@ static Menu::Item firmware_menu_items[] {
     {BACKLIGHT, "Backlight"},
     {VOLUME, "Volume"},
     {SCREENSHOT, "Take Screenshot"},
+    {FRAME_STATS, "Frame Stats"},
     {Menu::Separator,nullptr},
     {CONNECTIVITY, "Connectivity >"},
     {Menu::Separator,nullptr},
@@ -111,6 +113,10 @@ void FirmwareMenu::render_item(const Item &item, int y, int index) const {
       draw_slider(Point(bar_x, y + bar_margin), bar_width, persist.volume, foreground_colour);
     }
     break;
+  case FRAME_STATS:
+    screen.pen = foreground_colour;
+    screen.text(get_stats_overlay() ? "On" : "Off", minimal_font, Point(screen_width - item_padding_x, y + 1), true, TextAlign::right);
+    break;
   default:
     screen.pen = foreground_colour;
     screen.text("Press A", minimal_font, Point(screen_width - item_padding_x, y + 1), true, TextAlign::right);
@@ -192,6 +198,9 @@ void FirmwareMenu::item_activated(const Item &item) {
   case SCREENSHOT:
     take_screenshot = true;
     break;
+  case FRAME_STATS:
+    set_stats_overlay(!get_stats_overlay());
+    break;
   case POWER_OFF:
     bq24295_enable_shipping_mode(&hi2c4);
     break;
@@ -21,7 +21,10 @@ void LTDC_IRQHandler() {
 
     // flip the framebuffer to the ltdc buffer and request
     // a new frame to be rendered
-    display::flip(blit::screen);
+    {
+      blit::PhaseTimer phase_timer(blit::EnginePhase::FLIP);
+      display::flip(blit::screen);
+    }
     display::needs_render = true; 
   }
 }
@@ -8,6 +8,13 @@
 TIM_HandleTypeDef htim6;
 DAC_HandleTypeDef hdac1;
 
+// samples are rendered in small blocks, which is much cheaper than one at a time. The timer
+// interrupt plays one half of the buffer while the other is rendered at a lower priority, so
+// rendering never delays a sample
+static const int sample_block_size = 32;
+static int16_t sample_buffer[sample_block_size * 2];
+static volatile int sample_pos = 0;
+
 void TIM6_DAC_IRQHandler(void) {  
 
   if (__HAL_TIM_GET_FLAG(&htim6, TIM_FLAG_UPDATE) != RESET)
@@ -16,37 +23,70 @@ void TIM6_DAC_IRQHandler(void) {
     {
       __HAL_TIM_CLEAR_IT(&htim6, TIM_IT_UPDATE);
 
-      static bool was_amp_enabled = true;
-      bool enable_amp = is_audio_playing();
+      // timer period elapsed, output the next sample
+      int pos = sample_pos;
+      hdac1.Instance->DHR12R2 = uint16_t(sample_buffer[pos] + 0x8000) >> 4;
+
+      if(++pos == sample_block_size * 2)
+        pos = 0;
 
-      if(enable_amp != was_amp_enabled) {
-        HAL_GPIO_WritePin(AMP_SHUTDOWN_GPIO_Port, AMP_SHUTDOWN_Pin, enable_amp ? GPIO_PIN_SET : GPIO_PIN_RESET);
-        was_amp_enabled = enable_amp;
-      }
+      sample_pos = pos;
 
-      // timer period elapsed, update audio sample
-      hdac1.Instance->DHR12R2 = blit::get_audio_frame() >> 4;
+      // finished playing a half, render the next samples into it
+      if(pos % sample_block_size == 0)
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
     }
   }
 }
 
+// called from PendSV, which only the timer and other short interrupts can preempt
+void sound_render_audio(void) {
+  static bool was_amp_enabled = true;
+  bool enable_amp = is_audio_playing();
+
+  if(enable_amp != was_amp_enabled) {
+    HAL_GPIO_WritePin(AMP_SHUTDOWN_GPIO_Port, AMP_SHUTDOWN_Pin, enable_amp ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    was_amp_enabled = enable_amp;
+  }
+
+  // the half that isn't playing
+  auto buffer = sample_pos < sample_block_size ? sample_buffer + sample_block_size : sample_buffer;
+
+  blit::PhaseTimer phase_timer(blit::EnginePhase::AUDIO);
+  blit::get_audio_frames(buffer, sample_block_size);
+}
+
 namespace sound {
 
   AudioChannel channels[CHANNEL_COUNT];
+  AudioCommandQueue audio_commands;
 
   void init() {
     blit::api.channels = channels;
+    blit::api.audio_commands = &audio_commands;
+
+    blit::api.audio_channel_count = CHANNEL_COUNT;
+    blit::api.audio_sample_rate = blit::sample_rate;
+    blit::api.audio_channel_size = sizeof(AudioChannel);
 
-    // setup the 22,010Hz audio timer    
+    // the timer only writes the DAC, the rendering it triggers is below it but still ahead of
+    // the display and DMA interrupts so that it finishes within a block
+    HAL_NVIC_SetPriority(TIM6_DAC_IRQn, 0, 0);
+    HAL_NVIC_SetPriority(PendSV_IRQn, 1, 0);
+
+    // setup the audio timer to run at the engine's sample rate
     HAL_NVIC_EnableIRQ(TIM6_DAC_IRQn);
     __TIM6_CLK_ENABLE();
 
     TIM_MasterConfigTypeDef sMasterConfig = {0};
 
+    // TIM6 runs at twice the APB1 clock (240MHz)
+    uint32_t timer_clock = HAL_RCC_GetPCLK1Freq() * 2;
+
     htim6.Instance = TIM6;
-    htim6.Init.Prescaler = 310;
+    htim6.Init.Prescaler = 0;
     htim6.Init.CounterMode = TIM_COUNTERMODE_UP;
-    htim6.Init.Period = 34;
+    htim6.Init.Period = (timer_clock + sample_rate / 2) / sample_rate - 1;
 
     if (HAL_TIM_Base_Init(&htim6) != HAL_OK)
     {
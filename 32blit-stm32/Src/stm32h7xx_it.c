@@ -31,6 +31,7 @@
 //__attribute__((section(".dac_data"))) uint16_t sine_wave_array[32];
 
 extern void blit_reset_with_error();
+extern void sound_render_audio(void);
 
 //uint8_t dac_ready;
 /* Private typedef -----------------------------------------------------------*/
@@ -187,7 +188,7 @@ void DebugMon_Handler(void)
 void PendSV_Handler(void)
 {
   /* USER CODE BEGIN PendSV_IRQn 0 */
-
+  sound_render_audio();
   /* USER CODE END PendSV_IRQn 0 */
   /* USER CODE BEGIN PendSV_IRQn 1 */
 
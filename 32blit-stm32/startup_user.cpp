@@ -5,10 +5,19 @@ extern void init();
 extern void update(uint32_t time);
 extern void render(uint32_t time);
 
+// placed straight after the header in startup_user.s, so that the firmware can refuse an incompatible game before calling it
+extern "C" __attribute__((section(".isr_vector.api"), used))
+const uint32_t blit_game_api[2] = {blit::api_game_magic, blit::api_version};
+
 extern "C" bool cpp_do_init() {
     if(blit::api.version < blit::api_version)
         return false;
 
+    // the channels are shared with the firmware, so it must have been built with the same audio options
+    if(blit::api.audio_channel_count != CHANNEL_COUNT || blit::api.audio_sample_rate != blit::sample_rate
+    || blit::api.audio_channel_size != sizeof(blit::AudioChannel))
+        return false;
+
     blit::update = update;
     blit::render = render;
 
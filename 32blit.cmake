@@ -29,6 +29,11 @@ if (NOT DEFINED BLIT_ONCE)
 		add_definitions("-DWIN32")
 	endif()
 
+	# audio engine configuration, the firmware and games must use the same values
+	set(BLIT_AUDIO_CHANNELS 8 CACHE STRING "Number of audio channels")
+	set(BLIT_AUDIO_SAMPLE_RATE 22050 CACHE STRING "Audio output sample rate (Hz)")
+	add_definitions("-DAUDIO_CHANNEL_COUNT=${BLIT_AUDIO_CHANNELS}" "-DAUDIO_SAMPLE_RATE=${BLIT_AUDIO_SAMPLE_RATE}")
+
 	add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/32blit 32blit)
 
 	function (blit_assets_yaml TARGET FILE)
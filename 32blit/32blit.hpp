@@ -2,11 +2,14 @@
 
 #include "engine/api.hpp"
 #include "engine/engine.hpp"
+#include "engine/engine_stats.hpp"
 #include "engine/file.hpp"
 #include "engine/output.hpp"
 #include "engine/input.hpp"
+#include "engine/jobs.hpp"
 #include "audio/audio.hpp"
 #include "engine/save.hpp"
+#include "engine/task.hpp"
 #include "engine/timer.hpp"
 #include "engine/tweening.hpp"
 #include "graphics/blend.hpp"
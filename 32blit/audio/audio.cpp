@@ -5,6 +5,9 @@
 #include "../engine/input.hpp"
 #include "../32blit.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 #include "audio.hpp"
 
 namespace blit {
@@ -22,6 +25,12 @@ namespace blit {
     return prng_lfsr;
   }
 
+  // samples rendered at once, limited by stack usage
+  static const int audio_block_size = 64;
+
+  // waveforms that can be baked into the oscillator table
+  static const uint8_t periodic_waveforms = Waveform::SQUARE | Waveform::SAW | Waveform::TRIANGLE | Waveform::SINE | Waveform::WAVETABLE;
+
   uint16_t volume = 0xffff;
   const int16_t sine_waveform[256] = {-32768,-32758,-32729,-32679,-32610,-32522,-32413,-32286,-32138,-31972,-31786,-31581,-31357,-31114,-30853,-30572,-30274,-29957,-29622,-29269,-28899,-28511,-28106,-27684,-27246,-26791,-26320,-25833,-25330,-24812,-24279,-23732,-23170,-22595,-22006,-21403,-20788,-20160,-19520,-18868,-18205,-17531,-16846,-16151,-15447,-14733,-14010,-13279,-12540,-11793,-11039,-10279,-9512,-8740,-7962,-7180,-6393,-5602,-4808,-4011,-3212,-2411,-1608,-804,0,804,1608,2411,3212,4011,4808,5602,6393,7180,7962,8740,9512,10279,11039,11793,12540,13279,14010,14733,15447,16151,16846,17531,18205,18868,19520,20160,20788,21403,22006,22595,23170,23732,24279,24812,25330,25833,26320,26791,27246,27684,28106,28511,28899,29269,29622,29957,30274,30572,30853,31114,31357,31581,31786,31972,32138,32286,32413,32522,32610,32679,32729,32758,32767,32758,32729,32679,32610,32522,32413,32286,32138,31972,31786,31581,31357,31114,30853,30572,30274,29957,29622,29269,28899,28511,28106,27684,27246,26791,26320,25833,25330,24812,24279,23732,23170,22595,22006,21403,20788,20160,19520,18868,18205,17531,16846,16151,15447,14733,14010,13279,12540,11793,11039,10279,9512,8740,7962,7180,6393,5602,4808,4011,3212,2411,1608,804,0,-804,-1608,-2411,-3212,-4011,-4808,-5602,-6393,-7180,-7962,-8740,-9512,-10279,-11039,-11793,-12540,-13279,-14010,-14733,-15447,-16151,-16846,-17531,-18205,-18868,-19520,-20160,-20788,-21403,-22006,-22595,-23170,-23732,-24279,-24812,-25330,-25833,-26320,-26791,-27246,-27684,-28106,-28511,-28899,-29269,-29622,-29957,-30274,-30572,-30853,-31114,-31357,-31581,-31786,-31972,-32138,-32286,-32413,-32522,-32610,-32679,-32729,-32758};
 
@@ -40,22 +49,12 @@ namespace blit {
     return any_channel_playing;
   }
 
-  uint16_t get_audio_frame() {
-    int32_t sample = 0;  // used to combine channel output
-
-    for(int c = 0; c < CHANNEL_COUNT; c++) {
-
-      auto &channel = channels[c];
-
-      // increment the waveform position counter. this provides an
-      // Q16 fixed point value representing how far through
-      // the current waveform we are
-      channel.waveform_offset += ((channel.frequency * 256) << 8) / sample_rate;
-
-      if(channel.adsr_phase == ADSRPhase::OFF) {
-        continue;
-      }
+  // advances the envelope of a channel by up to `count` samples, writing the level for
+  // each one to `env`. Returns the number of samples before the channel turned off
+  static int update_envelope(AudioChannel &channel, int32_t *env, int count) {
+    int i = 0;
 
+    while(i < count && channel.adsr_phase != ADSRPhase::OFF) {
       if ((channel.adsr_frame >= channel.adsr_end_frame) && (channel.adsr_phase != ADSRPhase::SUSTAIN)) {
         switch (channel.adsr_phase) {
           case ADSRPhase::ATTACK:
@@ -72,89 +71,851 @@ namespace blit {
         }
       }
 
-      channel.adsr += channel.adsr_step;
-      channel.adsr_frame++;
+      // number of samples until the next phase change
+      int run = count - i;
 
-      if(channel.waveform_offset & 0b10000) {
-        // if the waveform offset overflows then generate a new
-        // random noise sample
-        channel.noise = (prng_lfsr_next() & 0xffff) - 0x7fff;
+      if(channel.adsr_phase == ADSRPhase::OFF)
+        run = 1; // the sample that ended the release is still played
+      else if(channel.adsr_phase != ADSRPhase::SUSTAIN)
+        run = std::min(run, int(std::max(channel.adsr_end_frame - channel.adsr_frame, uint32_t(1))));
+
+      uint32_t adsr = channel.adsr;
+      int32_t adsr_step = channel.adsr_step;
+
+      for(int j = 0; j < run; j++) {
+        adsr += adsr_step;
+        env[i + j] = int32_t(adsr >> 8);
       }
 
-      channel.waveform_offset &= 0xffff;
+      channel.adsr = adsr;
+      channel.adsr_frame += run;
+      i += run;
+    }
 
-      // check if any waveforms are active for this channel
-      if(channel.waveforms) {
-        uint8_t waveform_count = 0;
-        int32_t channel_sample = 0;
+    return i;
+  }
+
+  // calculates biquad coefficients for the channel's filter settings
+  static void update_filter_coefs(AudioChannel &channel) {
+    channel.filter_coefs_cutoff = channel.filter_cutoff_frequency;
+    channel.filter_coefs_resonance = channel.filter_resonance;
+    channel.filter_coefs_type = channel.filter_type;
+
+    // keep the cutoff in a stable range
+    float cutoff = std::min(std::max(int(channel.filter_cutoff_frequency), 10), int(sample_rate * 0.45f));
+    float q = std::max(int(channel.filter_resonance), 16) / 256.0f;
+
+    float w0 = 2.0f * pi * cutoff / sample_rate;
+    float cos_w0 = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+
+    float b0, b1, b2;
+
+    switch(channel.filter_type) {
+      case FilterType::LOW_PASS:
+        b1 = 1.0f - cos_w0;
+        b0 = b2 = b1 / 2.0f;
+        break;
+      case FilterType::HIGH_PASS:
+        b1 = -(1.0f + cos_w0);
+        b0 = b2 = -b1 / 2.0f;
+        break;
+      case FilterType::BAND_PASS:
+      default:
+        b0 = alpha;
+        b1 = 0.0f;
+        b2 = -alpha;
+        break;
+    }
+
+    float scale = float(1 << 28) / (1.0f + alpha);
+    channel.filter_coefs[0] = b0 * scale;
+    channel.filter_coefs[1] = b1 * scale;
+    channel.filter_coefs[2] = b2 * scale;
+    channel.filter_coefs[3] = -2.0f * cos_w0 * scale;
+    channel.filter_coefs[4] = (1.0f - alpha) * scale;
+  }
+
+  // runs a block of samples through the channel's biquad filter
+  static void apply_filter(AudioChannel &channel, int32_t *samples, int count) {
+    if(channel.filter_cutoff_frequency != channel.filter_coefs_cutoff
+    || channel.filter_resonance != channel.filter_coefs_resonance
+    || channel.filter_type != channel.filter_coefs_type
+    || !channel.filter_coefs[0]) {
+      update_filter_coefs(channel);
+    }
+
+    int32_t b0 = channel.filter_coefs[0], b1 = channel.filter_coefs[1], b2 = channel.filter_coefs[2];
+    int32_t a1 = channel.filter_coefs[3], a2 = channel.filter_coefs[4];
+    int32_t x1 = channel.filter_history[0], x2 = channel.filter_history[1];
+    int32_t y1 = channel.filter_history[2], y2 = channel.filter_history[3];
+
+    for(int i = 0; i < count; i++) {
+      int32_t x = samples[i];
+      int64_t acc = int64_t(b0) * x + int64_t(b1) * x1 + int64_t(b2) * x2
+                  - int64_t(a1) * y1 - int64_t(a2) * y2;
+      int32_t y = (acc + (1 << 27)) >> 28;
 
-        if(channel.waveforms & Waveform::NOISE) {
-          channel_sample += channel.noise;
-          waveform_count++;
+      x2 = x1; x1 = x;
+      y2 = y1; y1 = y;
+      samples[i] = y;
+    }
+
+    channel.filter_history[0] = x1;
+    channel.filter_history[1] = x2;
+    channel.filter_history[2] = y1;
+    channel.filter_history[3] = y2;
+  }
+
+  static int count_waveforms(uint8_t waveforms) {
+    int count = 0;
+    for(; waveforms; waveforms >>= 1)
+      count += waveforms & 1;
+
+    return count;
+  }
+
+  // mixes the enabled periodic waveforms of a channel into its oscillator table
+  static void bake_oscillator_table(AudioChannel &channel) {
+    auto waveforms = channel.waveforms;
+
+    channel.osc_table_waveforms = waveforms;
+    channel.osc_table_pulse_width = channel.pulse_width;
+    channel.osc_table_wavetable = channel.wavetable;
+
+    // the non-periodic waveforms are divided by the same count when they are mixed in
+    int waveform_count = std::max(count_waveforms(waveforms), 1);
+
+    for(int i = 0; i < 256; i++) {
+      uint16_t offset = i << 8;
+      int32_t sample = 0;
+
+      if(waveforms & Waveform::SAW)
+        sample += (int32_t)offset - 0x7fff;
+
+      // creates a triangle wave of ^
+      if(waveforms & Waveform::TRIANGLE) {
+        if (offset < 0x7fff) { // initial quarter up slope
+          sample += int32_t(offset * 2) - int32_t(0x7fff);
         }
+        else { // final quarter up slope
+          sample += int32_t(0x7fff) - ((int32_t(offset) - int32_t(0x7fff)) * 2);
+        }
+      }
+
+      if(waveforms & Waveform::SQUARE)
+        sample += (offset < channel.pulse_width) ? 0x7fff : -0x7fff;
+
+      if(waveforms & Waveform::SINE)
+        sample += sine_waveform[i];
+
+      if((waveforms & Waveform::WAVETABLE) && channel.wavetable)
+        sample += channel.wavetable[i];
+
+      channel.osc_table[i] = sample / waveform_count;
+    }
+
+    // extra entry to interpolate towards at the end of the table
+    channel.osc_table[256] = channel.osc_table[0];
+  }
+
+  static const int16_t adpcm_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+    107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428,
+    4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350,
+    22385, 24623, 27086, 29794, 32767
+  };
+
+  static const int8_t adpcm_index_table[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+  static int16_t decode_adpcm(AudioChannel &channel, uint8_t nibble) {
+    int step = adpcm_step_table[channel.adpcm_index];
+
+    int diff = step >> 3;
+    if(nibble & 1) diff += step >> 2;
+    if(nibble & 2) diff += step >> 1;
+    if(nibble & 4) diff += step;
+    if(nibble & 8) diff = -diff;
+
+    int predictor = std::min(std::max(channel.adpcm_predictor + diff, -0x8000), 0x7fff);
+    channel.adpcm_predictor = predictor;
+    channel.adpcm_index = std::min(std::max(channel.adpcm_index + adpcm_index_table[nibble & 7], 0), 88);
+
+    return predictor;
+  }
+
+  // reads sample `index` from a buffer
+  static int16_t read_sample(AudioChannel &channel, const void *data, SampleFormat format, uint32_t index) {
+    switch(format) {
+      case SampleFormat::PCM8:
+        return static_cast<const int8_t *>(data)[index] * 256;
+      case SampleFormat::PCM16:
+        return static_cast<const int16_t *>(data)[index];
+      case SampleFormat::IMA_ADPCM: {
+        uint8_t byte = static_cast<const uint8_t *>(data)[index >> 1];
+        return decode_adpcm(channel, (index & 1) ? byte >> 4 : byte & 0xf);
+      }
+    }
+
+    return 0;
+  }
+
+  // reads the next sample of the channel's sample data or stream
+  static int16_t next_sample(AudioChannel &channel, uint32_t &stream_read_pos, uint32_t stream_write_pos, bool &underrun) {
+    if(channel.sample_stream) {
+      auto stream = channel.sample_stream;
+
+      if(stream_read_pos == stream_write_pos) {
+        if(stream->finished.load(std::memory_order_acquire) && stream_write_pos == stream->write_pos.load(std::memory_order_acquire))
+          channel.sample_ended = true;
+        else
+          underrun = true;
+
+        return 0;
+      }
+
+      return read_sample(channel, stream->buffer, stream->format, stream_read_pos++ % stream->size);
+    }
+
+    uint32_t end = channel.sample_loop_end ? std::min(channel.sample_loop_end, channel.sample_length) : channel.sample_length;
+
+    if(channel.sample_pos >= end) {
+      if(!channel.sample_loop_end || channel.sample_loop_start >= end) {
+        channel.sample_ended = true;
+        return 0;
+      }
+
+      channel.sample_pos = channel.sample_loop_start;
+      channel.adpcm_predictor = channel.adpcm_loop_predictor;
+      channel.adpcm_index = channel.adpcm_loop_index;
+    } else if(channel.sample_pos == channel.sample_loop_start) {
+      // the decoder state can't be recovered later
+      channel.adpcm_loop_predictor = channel.adpcm_predictor;
+      channel.adpcm_loop_index = channel.adpcm_index;
+    }
+
+    return read_sample(channel, channel.sample_data, channel.sample_format, channel.sample_pos++);
+  }
+
+  // renders the SAMPLE waveform, interpolating between samples of the data.
+  // Returns `true` once the last sample has been played
+  static bool render_sample(AudioChannel &channel, int32_t *samples, int count) {
+    if(!channel.sample_data && !channel.sample_stream) {
+      for(int i = 0; i < count; i++)
+        samples[i] = 0;
+      return false;
+    }
+
+    auto stream = channel.sample_stream;
+    uint32_t stream_read_pos = 0, stream_write_pos = 0;
+    bool underrun = false, finished = false;
+
+    if(stream) {
+      stream_read_pos = stream->read_pos.load(std::memory_order_relaxed);
+      stream_write_pos = stream->write_pos.load(std::memory_order_acquire);
+    }
 
-        if(channel.waveforms & Waveform::SAW) {
-          channel_sample += (int32_t)channel.waveform_offset - 0x7fff;
-          waveform_count++;
+    uint32_t step = channel.sample_step;
+    uint32_t frac = channel.sample_frac;
+    int32_t s0 = channel.sample_history[0], s1 = channel.sample_history[1];
+
+    int i = 0;
+    for(; i < count; i++) {
+      while(frac >= 0x10000) {
+        // s1 was past the end, so there is nothing left to interpolate towards.
+        // (Checked here so that where the sample stops doesn't depend on the block size)
+        if(channel.sample_ended) {
+          finished = true;
+          break;
         }
 
-        // creates a triangle wave of ^
-        if (channel.waveforms & Waveform::TRIANGLE) {
-          if (channel.waveform_offset < 0x7fff) { // initial quarter up slope
-            channel_sample += int32_t(channel.waveform_offset * 2) - int32_t(0x7fff);
-          }
-          else { // final quarter up slope
-            channel_sample += int32_t(0x7fff) - ((int32_t(channel.waveform_offset) - int32_t(0x7fff)) * 2);
-          }
-          waveform_count++;
+        frac -= 0x10000;
+        s0 = s1;
+        s1 = next_sample(channel, stream_read_pos, stream_write_pos, underrun);
+      }
+
+      if(finished)
+        break;
+
+      samples[i] = s0 + (((s1 - s0) * int32_t(frac >> 1)) >> 15);
+      frac += step;
+    }
+
+    for(; i < count; i++)
+      samples[i] = 0;
+
+    channel.sample_frac = frac;
+    channel.sample_history[0] = s0;
+    channel.sample_history[1] = s1;
+
+    if(stream) {
+      stream->read_pos.store(stream_read_pos, std::memory_order_release);
+
+      if(underrun)
+        stream->underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return finished;
+  }
+
+  template<int divisor>
+  static void divide_samples(int32_t *samples, int count) {
+    for(int i = 0; i < count; i++)
+      samples[i] /= divisor;
+  }
+
+  // renders up to audio_block_size samples of a channel and adds them to `mix`
+  static void render_channel(AudioChannel &channel, int32_t *mix, int count) {
+    // increment for the waveform position counter. this provides an
+    // Q16 fixed point value representing how far through
+    // the current waveform we are
+    if(channel.waveform_offset_inc_frequency != channel.frequency) {
+      channel.waveform_offset_inc = (uint64_t(channel.frequency) << 16) / sample_rate;
+      channel.waveform_offset_inc_frequency = channel.frequency;
+    }
+
+    uint32_t offset_inc = channel.waveform_offset_inc;
+
+    int32_t env[audio_block_size];
+    int active = channel.adsr_phase == ADSRPhase::OFF ? 0 : update_envelope(channel, env, count);
+
+    uint32_t offset = channel.waveform_offset;
+
+    // check if any waveforms are active for this channel
+    if(active && channel.waveforms) {
+      int32_t samples[audio_block_size];
+
+      auto waveforms = channel.waveforms;
+      bool sample_finished = false;
+
+      if(waveforms != channel.osc_table_waveforms || channel.pulse_width != channel.osc_table_pulse_width
+      || channel.wavetable != channel.osc_table_wavetable) {
+        bake_oscillator_table(channel);
+      }
+
+      if(waveforms & periodic_waveforms) {
+        // one interpolated table read per sample, however many waveforms are mixed
+        const int16_t *table = channel.osc_table;
+        uint32_t phase = offset;
+
+        for(int i = 0; i < active; i++) {
+          phase = (phase + offset_inc) & 0xffff;
+
+          int index = phase >> 8, frac = phase & 0xff;
+          samples[i] = table[index] + (((table[index + 1] - table[index]) * frac) >> 8);
         }
+      } else {
+        for(int i = 0; i < active; i++)
+          samples[i] = 0;
+      }
+
+      // non-periodic waveforms are mixed in separately
+      if(waveforms & (Waveform::NOISE | Waveform::SAMPLE | Waveform::WAVE)) {
+        int32_t extra[audio_block_size];
+
+        if(waveforms & Waveform::NOISE) {
+          int16_t noise = channel.noise;
+          uint32_t phase = offset;
+
+          for(int i = 0; i < active; i++) {
+            phase = (phase + offset_inc) & 0xffff;
 
-        if (channel.waveforms & Waveform::SQUARE) {
-          channel_sample += (channel.waveform_offset < channel.pulse_width) ? 0x7fff : -0x7fff;
-          waveform_count++;
+            if(phase & 0b10000) {
+              // if the waveform offset overflows then generate a new
+              // random noise sample
+              noise = (prng_lfsr_next() & 0xffff) - 0x7fff;
+            }
+
+            extra[i] = noise;
+          }
+
+          channel.noise = noise;
+        } else {
+          for(int i = 0; i < active; i++)
+            extra[i] = 0;
         }
 
-        if(channel.waveforms & Waveform::SINE) {
-          // the sine_waveform sample contains 256 samples in
-          // total so we'll just use the most significant bits
-          // of the current waveform position to index into it
-          channel_sample += sine_waveform[channel.waveform_offset >> 8];
-          waveform_count++;
+        if(waveforms & Waveform::SAMPLE) {
+          int32_t sample_samples[audio_block_size];
+          sample_finished = render_sample(channel, sample_samples, active);
+
+          for(int i = 0; i < active; i++)
+            extra[i] += sample_samples[i];
         }
 
-        if(channel.waveforms & Waveform::WAVE) {
-          channel_sample += channel.wave_buffer[channel.wave_buf_pos] << 8;
-          if (++channel.wave_buf_pos == 64) { // If the position is at the end, reset and hit up callback for more.
-            channel.wave_buf_pos = 0;
-            (*channel.callback_waveBufferRefresh)(channel.wave_callback_arg);
+        if(waveforms & Waveform::WAVE) {
+          for(int i = 0; i < active; i++) {
+            extra[i] += channel.wave_buffer[channel.wave_buf_pos] << 8;
+            if (++channel.wave_buf_pos == 64) { // If the position is at the end, reset and hit up callback for more.
+              channel.wave_buf_pos = 0;
+              (*channel.callback_waveBufferRefresh)(channel.wave_callback_arg);
+            }
           }
-          waveform_count++;
         }
 
-        channel_sample = channel_sample / waveform_count;
+        // constant divisors so the compiler can avoid a division per sample
+        switch(count_waveforms(waveforms)) {
+          case 2: divide_samples<2>(extra, active); break;
+          case 3: divide_samples<3>(extra, active); break;
+          case 4: divide_samples<4>(extra, active); break;
+          case 5: divide_samples<5>(extra, active); break;
+          case 6: divide_samples<6>(extra, active); break;
+          case 7: divide_samples<7>(extra, active); break;
+          case 8: divide_samples<8>(extra, active); break;
+        }
 
-        channel_sample = (int64_t(channel_sample) * int32_t(channel.adsr >> 8)) >> 16;
+        for(int i = 0; i < active; i++)
+          samples[i] += extra[i];
+      }
 
-        // apply channel volume
-        channel_sample = (int64_t(channel_sample) * int32_t(channel.volume)) >> 16;
+      offset = (offset + offset_inc * active) & 0xffff;
 
-        // apply channel filter
-        if (channel.filter_enable) {
-          float filter_epow = 1 - expf(-(1.0f / 22050.0f) * 2.0f * pi * int32_t(channel.filter_cutoff_frequency));
-          channel_sample += (channel_sample - channel.filter_last_sample) * filter_epow;
-        }
+      // apply envelope and channel volume
+      int32_t channel_volume = channel.volume;
+      for(int i = 0; i < active; i++) {
+        int32_t channel_sample = (int64_t(samples[i]) * env[i]) >> 16;
+        samples[i] = (int64_t(channel_sample) * channel_volume) >> 16;
+      }
+
+      // apply channel filter
+      if (channel.filter_enable)
+        apply_filter(channel, samples, active);
+
+      // combine channel samples into the final mix
+      for(int i = 0; i < active; i++)
+        mix[i] += samples[i];
+
+      count -= active;
+
+      // one-shot samples and finished streams stop the channel when they end
+      if(sample_finished)
+        channel.off();
+    }
+
+    // the waveform position keeps moving while the channel is silent
+    channel.waveform_offset = (offset + offset_inc * count) & 0xffff;
+  }
+
+  /**
+   * Set the sample data played by the SAMPLE waveform, from memory or flash. This should
+   * be called while the channel is off, playback starts from the beginning when the channel
+   * is triggered. The channel turns off at the end of the sample, unless a loop is set
+   * with `set_sample_loop`. For example:
+   *
+   *     channels[0].waveforms = Waveform::SAMPLE;
+   *     channels[0].set_sample(asset_explosion, asset_explosion_length, SampleFormat::PCM8, 11025);
+   *     channels[0].trigger_attack();
+   *
+   * \param data Sample data, must stay valid while the sample is playing
+   * \param length Length of the data in samples
+   * \param format Format of the data
+   * \param rate Sample rate of the data, `sample_step` can be changed later to adjust the pitch
+   */
+  void AudioChannel::set_sample(const void *data, uint32_t length, SampleFormat format, uint32_t rate) {
+    sample_data = data;
+    sample_stream = nullptr;
+    sample_length = length;
+    sample_format = format;
+    sample_loop_start = sample_loop_end = 0;
+
+    set_sample_rate(rate);
+
+    // reading the first two samples sets up the interpolation
+    sample_pos = 0;
+    sample_frac = 0x20000;
+    sample_history[0] = sample_history[1] = 0;
+    adpcm_predictor = 0;
+    adpcm_index = 0;
+    sample_ended = false;
+  }
+
+  /**
+   * Loop part of the sample set by `set_sample`.
+   *
+   * \param start First sample of the loop
+   * \param end Sample after the end of the loop, 0 to play once
+   */
+  void AudioChannel::set_sample_loop(uint32_t start, uint32_t end) {
+    sample_loop_start = start;
+    sample_loop_end = end;
+  }
+
+  /**
+   * Play a stream with the SAMPLE waveform. The channel keeps playing until turned off
+   * or the end of a finished stream, outputting silence (and counting an underrun) if
+   * the stream runs out.
+   *
+   * \param stream Stream to play, must stay valid while the channel is using it
+   * \param rate Sample rate of the stream
+   */
+  void AudioChannel::set_sample_stream(SampleStream *stream, uint32_t rate) {
+    sample_data = nullptr;
+    sample_stream = stream;
+    sample_loop_start = sample_loop_end = 0;
+
+    set_sample_rate(rate);
+
+    sample_frac = 0x20000;
+    sample_history[0] = sample_history[1] = 0;
+    adpcm_predictor = 0;
+    adpcm_index = 0;
+    sample_ended = false;
+  }
+
+  /**
+   * Set `sample_step` to play the sample data at its original pitch.
+   *
+   * \param rate Sample rate of the data
+   */
+  void AudioChannel::set_sample_rate(uint32_t rate) {
+    sample_step = (uint64_t(rate) << 16) / blit::sample_rate;
+  }
+
+  /**
+   * Create a stream using a buffer. The size of the buffer in bytes should be `size`,
+   * `size * 2` or `size / 2` for PCM8, PCM16 and IMA_ADPCM streams respectively.
+   *
+   * \param buffer Buffer for the stream data
+   * \param size Number of samples the buffer holds
+   * \param format Format of the stream data
+   */
+  SampleStream::SampleStream(void *buffer, uint32_t size, SampleFormat format) : buffer(buffer), size(size), format(format) {
+  }
+
+  static uint32_t sample_bytes(SampleFormat format, uint32_t count) {
+    switch(format) {
+      case SampleFormat::PCM8:
+        return count;
+      case SampleFormat::PCM16:
+        return count * 2;
+      case SampleFormat::IMA_ADPCM:
+        return count / 2;
+    }
+
+    return 0;
+  }
+
+  /**
+   * Add data to the stream. IMA-ADPCM data is written a byte (two samples) at a time.
+   *
+   * \param data Samples to add, in the stream's format
+   * \param count Number of samples
+   *
+   * \return Number of samples added, less than `count` if the stream is full
+   */
+  uint32_t SampleStream::write(const void *data, uint32_t count) {
+    uint32_t pos = write_pos.load(std::memory_order_relaxed);
+
+    count = std::min(count, get_free());
+
+    if(format == SampleFormat::IMA_ADPCM)
+      count &= ~1;
+
+    // copy up to the end of the buffer, then wrap around
+    uint32_t offset = pos % size;
+    uint32_t first = std::min(count, size - offset);
+
+    auto in = static_cast<const uint8_t *>(data);
+    auto out = static_cast<uint8_t *>(buffer);
+
+    memcpy(out + sample_bytes(format, offset), in, sample_bytes(format, first));
+    memcpy(out, in + sample_bytes(format, first), sample_bytes(format, count - first));
+
+    write_pos.store(pos + count, std::memory_order_release);
+
+    return count;
+  }
+
+  /**
+   * Mark the end of the stream. A channel playing the stream turns off once it
+   * has played everything written, instead of counting an underrun.
+   */
+  void SampleStream::finish() {
+    finished.store(true, std::memory_order_release);
+  }
+
+  /**
+   * Discard all data in the stream. The stream should not be playing.
+   */
+  void SampleStream::reset() {
+    write_pos = read_pos = 0;
+    underruns = 0;
+    finished = false;
+  }
 
-        channel.filter_last_sample = channel_sample;
+  /** \returns Number of samples waiting to be played */
+  uint32_t SampleStream::get_buffered() const {
+    return write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire);
+  }
+
+  /** \returns Number of samples that can be written */
+  uint32_t SampleStream::get_free() const {
+    return size - get_buffered();
+  }
 
-        // combine channel sample into the final sample
-        sample += channel_sample;
+  static void apply_command(AudioChannel *channels, int channel_count, const AudioCommand &command) {
+    if(command.channel >= channel_count)
+      return;
+
+    auto &channel = channels[command.channel];
+
+    switch(command.type) {
+      case AudioCommandType::NOTE_ON:
+        if(command.value)
+          channel.frequency = command.value;
+        channel.trigger_attack();
+        break;
+      case AudioCommandType::NOTE_OFF:
+        channel.trigger_release();
+        break;
+      case AudioCommandType::OFF:
+        channel.off();
+        break;
+      case AudioCommandType::FREQUENCY:
+        channel.frequency = command.value;
+        break;
+      case AudioCommandType::VOLUME:
+        channel.volume = command.value;
+        break;
+      case AudioCommandType::WAVEFORMS:
+        channel.waveforms = command.value;
+        break;
+      case AudioCommandType::PULSE_WIDTH:
+        channel.pulse_width = command.value;
+        break;
+      case AudioCommandType::ATTACK_MS:
+        channel.attack_ms = command.value;
+        break;
+      case AudioCommandType::DECAY_MS:
+        channel.decay_ms = command.value;
+        break;
+      case AudioCommandType::SUSTAIN:
+        channel.sustain = command.value;
+        break;
+      case AudioCommandType::RELEASE_MS:
+        channel.release_ms = command.value;
+        break;
+      case AudioCommandType::FILTER_ENABLE:
+        channel.filter_enable = command.value != 0;
+        break;
+      case AudioCommandType::FILTER_CUTOFF_FREQUENCY:
+        channel.filter_cutoff_frequency = command.value;
+        break;
+      case AudioCommandType::FILTER_RESONANCE:
+        channel.filter_resonance = command.value;
+        break;
+    }
+  }
+
+  // runs the sequencer if it is due (or new) and returns how many samples (up to `count`)
+  // can be rendered before its next call
+  static int run_sequencer(AudioCommandQueue &queue, int count) {
+    uint32_t sequencer_id = queue.sequencer_id.load();
+    auto sequencer = queue.sequencer.load(std::memory_order_relaxed);
+    auto sequencer_arg = queue.sequencer_arg.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    // being changed (possibly by the code this interrupted), try again next block
+    if((sequencer_id & 1) || queue.sequencer_id.load(std::memory_order_relaxed) != sequencer_id)
+      return count;
+
+    if(sequencer_id != queue.sequencer_last_id.load(std::memory_order_relaxed)) {
+      queue.sequencer_last_id.store(sequencer_id, std::memory_order_release);
+      queue.sequencer_wait = 0;
+      queue.sequencer_finished = false;
+    }
+
+    if(sequencer && !queue.sequencer_finished) {
+      if(!queue.sequencer_wait) {
+        queue.sequencer_wait = sequencer(sequencer_arg);
+        queue.sequencer_finished = queue.sequencer_wait == 0;
       }
+
+      if(queue.sequencer_wait)
+        count = std::min(count, int(std::min(queue.sequencer_wait, uint32_t(audio_block_size))));
     }
 
-    sample = (int64_t(sample) * int32_t(volume)) >> 16;
+    return count;
+  }
+
+  // applies the queued commands that are due and returns how many samples
+  // (up to `count`) can be rendered before the next one
+  static int apply_commands(AudioChannel *channels, int channel_count, AudioCommandQueue &queue, int count) {
+    uint32_t time = queue.time.load(std::memory_order_relaxed);
+    uint32_t read_pos = queue.read_pos.load(std::memory_order_relaxed);
+    uint32_t write_pos = queue.write_pos.load(std::memory_order_acquire);
+
+    while(read_pos != write_pos) {
+      auto &command = queue.commands[read_pos % AudioCommandQueue::size];
+
+      // commands are applied in order, so a later one never overtakes this
+      int32_t delay = int32_t(command.time - time);
+      if(delay > 0) {
+        count = std::min(count, int(delay));
+        break;
+      }
+
+      apply_command(channels, channel_count, command);
+      read_pos++;
+    }
+
+    queue.read_pos.store(read_pos, std::memory_order_release);
+
+    // set before reading the sequencer so that set_audio_sequencer either sees it or this sees the new one
+    queue.sequencer_running.store(true);
+    count = run_sequencer(queue, count);
+    queue.sequencer_running.store(false, std::memory_order_release);
+
+    return count;
+  }
+
+  // renders `count` samples of a set of channels
+  static void render_audio(AudioChannel *channels, int channel_count, AudioCommandQueue *queue, int16_t *buffer, uint32_t count, int32_t master_volume) {
+    while(count) {
+      int block_count = std::min(count, uint32_t(audio_block_size));
+
+      // split the block at the next queued command or sequencer call
+      if(queue)
+        block_count = apply_commands(channels, channel_count, *queue, block_count);
+
+      int32_t mix[audio_block_size] = {0};
+
+      for(int c = 0; c < channel_count; c++)
+        render_channel(channels[c], mix, block_count);
+
+      for(int i = 0; i < block_count; i++) {
+        int32_t sample = (int64_t(mix[i]) * master_volume) >> 16;
+
+        // clip result to 16-bit
+        buffer[i] = sample <= -0x8000 ? -0x8000 : (sample > 0x7fff ? 0x7fff : sample);
+      }
+
+      buffer += block_count;
+      count -= block_count;
+
+      if(queue) {
+        queue->time.store(queue->time.load(std::memory_order_relaxed) + block_count, std::memory_order_release);
+
+        if(queue->sequencer_wait)
+          queue->sequencer_wait -= block_count;
+      }
+    }
+  }
+
+  /**
+   * Render a block of audio, mixing all channels.
+   *
+   * This is much faster than calling `get_audio_frame` for each sample, as
+   * each channel's envelope and waveforms are processed for the whole block at once.
+   *
+   * \param buffer Buffer for the signed 16-bit samples
+   * \param count Number of samples to render
+   */
+  void get_audio_frames(int16_t *buffer, uint32_t count) {
+    render_audio(channels, CHANNEL_COUNT, audio_commands, buffer, count, volume);
+  }
+
+  /**
+   * Render audio from a separate set of channels, without affecting the output. This can be
+   * used to render sound offline, for example to a file. The master volume is not applied.
+   *
+   * \param channels Channels to mix
+   * \param channel_count Number of channels
+   * \param queue Command queue/sequencer for the channels, can be `nullptr`
+   * \param buffer Buffer for the signed 16-bit samples
+   * \param count Number of samples to render
+   */
+  void mix_audio_frames(AudioChannel *channels, int channel_count, AudioCommandQueue *queue, int16_t *buffer, uint32_t count) {
+    render_audio(channels, channel_count, queue, buffer, count, 0x10000);
+  }
+
+  /**
+   * Render a single sample of audio. See `get_audio_frames`.
+   *
+   * \return Unsigned 16-bit sample
+   */
+  uint16_t get_audio_frame() {
+    int16_t sample;
+    get_audio_frames(&sample, 1);
 
-    // clip result to 16-bit and convert to unsigned
-    sample = sample <= -0x8000 ? -0x8000 : (sample > 0x7fff ? 0x7fff : sample);
     return sample + 0x8000;
   }
+
+  /**
+   * \return Number of samples rendered so far, the time used by `queue_audio_command`
+   */
+  uint32_t get_audio_time() {
+    return audio_commands ? audio_commands->time.load(std::memory_order_acquire) : 0;
+  }
+
+  /**
+   * Queue a change to a channel to be applied by the audio renderer at an exact sample.
+   * This avoids writing to `channels` while audio is being rendered and keeps note
+   * timing independent of when `update` is called. For example, to start a note 50ms
+   * from now:
+   *
+   *     queue_audio_command(get_audio_time() + sample_rate / 20, 0, AudioCommandType::NOTE_ON, 440);
+   *
+   * Commands are applied in the order they were queued, so times should not decrease.
+   * Commands for times that have already passed are applied as soon as possible.
+   * Only the game's `update`/`render` should queue commands.
+   *
+   * \param time Sample time to apply the command at
+   * \param channel Index of the channel
+   * \param type Command
+   * \param value Value for the command
+   *
+   * \return `true` if the command was queued, `false` if the queue is full
+   */
+  bool queue_audio_command(uint32_t time, uint8_t channel, AudioCommandType type, uint16_t value) {
+    if(!audio_commands)
+      return false;
+
+    auto &queue = *audio_commands;
+    uint32_t write_pos = queue.write_pos.load(std::memory_order_relaxed);
+
+    if(write_pos - queue.read_pos.load(std::memory_order_acquire) == AudioCommandQueue::size)
+      return false;
+
+    queue.commands[write_pos % AudioCommandQueue::size] = {time, channel, type, value};
+    queue.write_pos.store(write_pos + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  /**
+   * Set a callback to be run by the audio renderer. It is called as soon as possible, then
+   * again after the number of samples it returns, splitting rendering so that changes it makes
+   * to channels start at an exact sample. This is how music players can get sample-accurate
+   * timing without depending on when `update` is called. Returning 0 removes the callback.
+   *
+   * The callback runs with the renderer (in an interrupt on the device), so should be quick and
+   * only touch the channels it is responsible for. If the renderer is on another thread, this
+   * waits for any call to the old callback to return, so its argument can be freed afterwards.
+   * This means it must not be called from a callback.
+   *
+   * \param sequencer Callback, or `nullptr` to remove the current one
+   * \param arg Argument to pass to the callback
+   * \param queue Queue to set the sequencer of, defaults to the output's
+   */
+  void set_audio_sequencer(AudioSequencer sequencer, void *arg, AudioCommandQueue *queue) {
+    if(!queue)
+      return;
+
+    // the id is odd while the two are changed, so the renderer never calls the old callback
+    // with the new argument (or the new one with the old)
+    uint32_t id = queue->sequencer_id.load(std::memory_order_relaxed);
+    queue->sequencer_id.store(id + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    queue->sequencer.store(sequencer, std::memory_order_relaxed);
+    queue->sequencer_arg.store(arg, std::memory_order_relaxed);
+
+    queue->sequencer_id.store(id + 2);
+
+    // only seen set if the renderer is on another thread, an interrupt or a render from the game
+    // loop has already finished by the time this runs
+    while(queue->sequencer_running.load() && queue->sequencer_last_id.load(std::memory_order_acquire) != id + 2) {}
+  }
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 
 namespace blit {  
@@ -39,9 +40,29 @@ namespace blit {
   // |X   |    |    |    |    |    |    |    |    |    |    |    |    |    |    |    |    |
   // +----+----+----+----+----+----+----+----+----+----+----+----+----+----+----+----+----+--->
 
-  #define CHANNEL_COUNT 8
+  // the number of channels and output rate can be changed at build time with the
+  // BLIT_AUDIO_CHANNELS/BLIT_AUDIO_SAMPLE_RATE CMake options. The firmware and games
+  // must be built with the same values, the firmware refuses to start a game that wasn't
+  #ifndef AUDIO_CHANNEL_COUNT
+  #define AUDIO_CHANNEL_COUNT 8
+  #endif
+
+  #ifndef AUDIO_SAMPLE_RATE
+  #define AUDIO_SAMPLE_RATE 22050
+  #endif
+
+  #define CHANNEL_COUNT AUDIO_CHANNEL_COUNT
+
+  const uint32_t sample_rate = AUDIO_SAMPLE_RATE;
+
+  static_assert(CHANNEL_COUNT > 0 && CHANNEL_COUNT <= 32, "unsupported channel count");
+  static_assert(sample_rate >= 8000 && sample_rate <= 48000, "unsupported sample rate");
+
+  // converts a duration to a number of frames at the output rate (at least one)
+  constexpr uint32_t ms_to_frames(uint32_t ms) {
+    return ms * sample_rate >= 1000 ? ms * sample_rate / 1000 : 1;
+  }
 
-  const uint32_t sample_rate = 22050;
   extern uint16_t volume;
 
   enum Waveform {
@@ -50,9 +71,45 @@ namespace blit {
     SAW       = 32,
     TRIANGLE  = 16,
     SINE      = 8,
+    SAMPLE    = 4,
+    WAVETABLE = 2,
     WAVE      = 1
   };
 
+  enum class SampleFormat : uint8_t {
+    PCM8,       // signed 8-bit
+    PCM16,      // signed 16-bit
+    IMA_ADPCM   // 4-bit IMA-ADPCM, low nibble first, with no block headers
+  };
+
+  // ring buffer of sample data, filled by the game and played by the SAMPLE waveform.
+  // The buffer is owned by the caller
+  struct SampleStream {
+    SampleStream(void *buffer, uint32_t size, SampleFormat format = SampleFormat::PCM16);
+
+    void *buffer;
+    uint32_t size;                      // in samples, must be even for IMA_ADPCM
+    SampleFormat format;
+
+    std::atomic<uint32_t> write_pos{0}; // total samples written, only modified by the game
+    std::atomic<uint32_t> read_pos{0};  // total samples played, only modified by the renderer
+    std::atomic<uint32_t> underruns{0}; // number of times the buffer ran out while playing
+    std::atomic<bool> finished{false};  // no more data will be written
+
+    uint32_t write(const void *data, uint32_t count);
+    void finish();
+    void reset();
+
+    uint32_t get_buffered() const;
+    uint32_t get_free() const;
+  };
+
+  enum class FilterType : uint8_t {
+    LOW_PASS,
+    HIGH_PASS,
+    BAND_PASS
+  };
+
   enum class ADSRPhase : uint8_t {
     ATTACK,
     DECAY,
@@ -73,11 +130,21 @@ namespace blit {
       uint16_t  pulse_width   = 0x7fff; // duty cycle of square wave (default 50%)
       int16_t   noise         = 0;      // current noise value
   
-      uint32_t  waveform_offset  = 0;   // voice offset (Q8)
+      uint32_t  waveform_offset  = 0;   // voice offset (Q16)
+      uint32_t  waveform_offset_inc = 0;          // offset increment per sample, recalculated when the frequency changes
+      uint16_t  waveform_offset_inc_frequency = 0;
 
-      int32_t   filter_last_sample = 0;
       bool      filter_enable = false;
-      uint16_t  filter_cutoff_frequency = 0;
+      FilterType filter_type  = FilterType::HIGH_PASS;
+      uint16_t  filter_cutoff_frequency = 0;    // cutoff/centre frequency (Hz)
+      uint16_t  filter_resonance = 0xb5;        // filter Q (8.8 fixed point, default ~0.707)
+
+      // biquad filter state, the coefficients are recalculated when the above settings change
+      int32_t   filter_coefs[5] = {0};          // b0, b1, b2, a1, a2 (Q28)
+      int32_t   filter_history[4] = {0};        // x[n-1], x[n-2], y[n-1], y[n-2]
+      uint16_t  filter_coefs_cutoff = 0;
+      uint16_t  filter_coefs_resonance = 0;
+      FilterType filter_coefs_type = FilterType::HIGH_PASS;
 
       uint32_t  adsr_frame    = 0;      // number of frames into the current ADSR phase
       uint32_t  adsr_end_frame = 0;     // frame target at which the ADSR changes to the next phase
@@ -85,6 +152,33 @@ namespace blit {
 	    int32_t   adsr_step	    = 0;
       ADSRPhase adsr_phase    = ADSRPhase::OFF;
 
+      const int16_t *wavetable = nullptr; // one period (256 samples) of a custom waveform, played by WAVETABLE
+
+      // table of the periodic waveforms mixed together, rebuilt when waveforms/pulse_width/wavetable change
+      int16_t   osc_table[257];
+      uint16_t  osc_table_waveforms = 0xffff;
+      uint16_t  osc_table_pulse_width = 0;
+      const int16_t *osc_table_wavetable = nullptr;
+
+      // sample playback, see set_sample/set_sample_stream
+      const void *sample_data = nullptr;        // sample data in memory/flash
+      SampleStream *sample_stream = nullptr;    // ...or a stream to play
+      uint32_t  sample_length = 0;              // length of sample_data (samples)
+      uint32_t  sample_loop_start = 0;
+      uint32_t  sample_loop_end = 0;            // loop back to sample_loop_start here, 0 to play once
+      uint32_t  sample_step = 0x10000;          // playback speed (Q16, 0x10000 = one sample of data per output sample)
+      SampleFormat sample_format = SampleFormat::PCM16;
+
+      // sample playback state
+      uint32_t  sample_pos = 0;                 // next sample of sample_data to read
+      uint32_t  sample_frac = 0;                // position between sample_history[0] and [1] (Q16)
+      int16_t   sample_history[2] = {0};
+      int16_t   adpcm_predictor = 0;
+      uint8_t   adpcm_index = 0;
+      int16_t   adpcm_loop_predictor = 0;       // decoder state at the loop start
+      uint8_t   adpcm_loop_index = 0;
+      bool      sample_ended = false;
+
       uint8_t   wave_buf_pos  = 0;      // 
       int16_t   wave_buffer[64];        // buffer for arbitrary waveforms. small as it's filled by user callback
 
@@ -94,13 +188,13 @@ namespace blit {
       void trigger_attack()  {
         adsr_frame = 0;
 		    adsr_phase = ADSRPhase::ATTACK;
-        adsr_end_frame = (attack_ms * sample_rate) / 1000;
+        adsr_end_frame = ms_to_frames(attack_ms);
 		    adsr_step = (int32_t(0xffffff) - int32_t(adsr)) / int32_t(adsr_end_frame);
 	    }
 	    void trigger_decay() {
         adsr_frame = 0;
 		    adsr_phase = ADSRPhase::DECAY;
-        adsr_end_frame = (decay_ms * sample_rate) / 1000;
+        adsr_end_frame = ms_to_frames(decay_ms);
 		    adsr_step = (int32_t(sustain << 8) - int32_t(adsr)) / int32_t(adsr_end_frame);
 	    }
       void trigger_sustain() {
@@ -112,7 +206,7 @@ namespace blit {
       void trigger_release() {
         adsr_frame = 0;
 		    adsr_phase = ADSRPhase::RELEASE;
-        adsr_end_frame = (release_ms * sample_rate) / 1000;
+        adsr_end_frame = ms_to_frames(release_ms);
 		    adsr_step = (int32_t(0) - int32_t(adsr)) / int32_t(adsr_end_frame);
 	    }
       void off() {
@@ -120,11 +214,75 @@ namespace blit {
 		    adsr_phase = ADSRPhase::OFF;
 		    adsr_step = 0;
 	    }
+
+      // call after changing the contents of `wavetable`
+      void update_wavetable() {
+        osc_table_waveforms = 0xffff;
+      }
+
+      void set_sample(const void *data, uint32_t length, SampleFormat format = SampleFormat::PCM16, uint32_t rate = sample_rate);
+      void set_sample_loop(uint32_t start, uint32_t end);
+      void set_sample_stream(SampleStream *stream, uint32_t rate = sample_rate);
+      void set_sample_rate(uint32_t rate);
+  };
+
+  enum class AudioCommandType : uint8_t {
+    NOTE_ON,          // trigger the attack, setting the frequency to `value` if it is not 0
+    NOTE_OFF,         // trigger the release
+    OFF,              // stop immediately
+    FREQUENCY,
+    VOLUME,
+    WAVEFORMS,
+    PULSE_WIDTH,
+    ATTACK_MS,
+    DECAY_MS,
+    SUSTAIN,
+    RELEASE_MS,
+    FILTER_ENABLE,
+    FILTER_CUTOFF_FREQUENCY,
+    FILTER_RESONANCE
+  };
+
+  struct AudioCommand {
+    uint32_t time;    // sample time to apply the command at (see get_audio_time)
+    uint8_t channel;
+    AudioCommandType type;
+    uint16_t value;
+  };
+
+  // called by the renderer to update channels at an exact sample, returns the number of
+  // samples until it should be called again (0 to remove it). See set_audio_sequencer
+  using AudioSequencer = uint32_t (*)(void *arg);
+
+  // single-producer/single-consumer queue of commands from the game to the audio renderer
+  struct AudioCommandQueue {
+    static const uint32_t size = 128; // must be a power of two
+
+    AudioCommand commands[size];
+    std::atomic<uint32_t> write_pos{0}; // only modified by the game
+    std::atomic<uint32_t> read_pos{0};  // only modified by the renderer
+    std::atomic<uint32_t> time{0};      // number of samples rendered
+
+    // the sequencer and its argument are only used if sequencer_id is even and unchanged after reading them
+    std::atomic<AudioSequencer> sequencer{nullptr};
+    std::atomic<void *> sequencer_arg{nullptr};
+    std::atomic<uint32_t> sequencer_id{0};       // odd while the sequencer is being set, +2 each time
+    std::atomic<uint32_t> sequencer_last_id{0};  // last id seen by the renderer, only modified by the renderer
+    uint32_t sequencer_wait = 0;                 // samples until the next call, only modified by the renderer
+    bool sequencer_finished = false;             // the sequencer returned 0, only modified by the renderer
+    std::atomic<bool> sequencer_running{false};  // the renderer may be calling the sequencer
   };
 
   extern AudioChannel *&channels;
+  extern AudioCommandQueue *&audio_commands;
 
   uint16_t get_audio_frame();
+  void get_audio_frames(int16_t *buffer, uint32_t count);
+  void mix_audio_frames(AudioChannel *channels, int channel_count, AudioCommandQueue *queue, int16_t *buffer, uint32_t count);
   bool is_audio_playing();
 
+  uint32_t get_audio_time();
+  bool queue_audio_command(uint32_t time, uint8_t channel, AudioCommandType type, uint16_t value = 0);
+  void set_audio_sequencer(AudioSequencer sequencer, void *arg, AudioCommandQueue *queue = audio_commands);
+
 }
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cinttypes>
 #include <cstring>
 
@@ -12,65 +13,192 @@
 #include "engine/file.hpp"
 
 namespace blit {
-  MP3Stream::MP3Stream() {
+  /**
+   * \param buffer_size Number of samples to decode ahead of playback, must be at least one
+   *                    frame at the output rate (`load` fails otherwise)
+   */
+  MP3Stream::MP3Stream(uint32_t buffer_size) : audio_buf(new int16_t[buffer_size]), stream(audio_buf, buffer_size) {
     mp3dec = new mp3dec_t;
   }
 
   MP3Stream::~MP3Stream() {
+#ifdef BLIT_MP3_DECODE_THREAD
+    stop_thread();
+#endif
+    if(channel != -1 && blit::channels[channel].sample_stream == &stream)
+      blit::channels[channel].off();
+
     delete static_cast<mp3dec_t *>(mp3dec);
+    delete[] audio_buf;
   }
 
-  bool MP3Stream::load(std::string filename, bool do_duration_calc) {
+  /**
+   * Open a file for playback.
+   *
+   * The duration and seek positions come from the Xing/VBRI header if the file has one.
+   * Otherwise the frame headers are scanned to index the file. Seeking with a Xing header
+   * is approximate, `cache_index` always indexes the file and saves the index to
+   * `filename.idx` to make loading it again faster.
+   *
+   * \param filename File to load
+   * \param do_duration_calc Scan the file now if there is no header. Otherwise the duration is unknown (0) and the scan happens on the first `seek`
+   * \param cache_index Use/create an index file next to the file
+   *
+   * \return `true` if the file was loaded
+   */
+  bool MP3Stream::load(std::string filename, bool do_duration_calc, bool cache_index) {
+#ifdef BLIT_MP3_DECODE_THREAD
+    stop_thread();
+#endif
+
     if(channel != -1)
       blit::channels[channel].off();
 
-    current_sample = nullptr;
-    buffered_samples = 0;
-    need_convert = false;
+    stream.reset();
+    started = ended = false;
+
+    seek_index.clear();
+    index_exact = false;
+    frame_count = 0;
+    seek_sample = 0;
+    duration_ms = 0;
 
     if(!file.open(filename))
       return false;
 
-    // fill initial buffer
-    file_buffer_filled = 0;
-    file_offset = 0;
-    read(0);
+    if(!find_first_frame())
+      return false;
 
-    if(!file_buffer_filled)
+    // convert to the output rate if needed
+    resampler.set_rates(frame_hz);
+
+    // fill() only decodes when a whole frame fits, so a smaller buffer would never play
+    uint32_t min_buffer_size = resampler.get_max_output(MINIMP3_MAX_SAMPLES_PER_FRAME / 2);
+    if(stream.size < min_buffer_size) {
+      debugf("MP3Stream: buffer of %" PRIu32 " samples is too small for %s, needs %" PRIu32 "\n", stream.size, filename.c_str(), min_buffer_size);
       return false;
+    }
 
-    if(do_duration_calc) {
-      mp3dec_init(static_cast<mp3dec_t *>(mp3dec));
-      duration_ms = calc_duration();
-    } else
-      duration_ms = 0;
+    parse_vbr_header();
+
+    // the Xing TOC is only accurate to 1/256 of the file, the index is exact
+    if(cache_index) {
+      if(!load_index(filename + ".idx")) {
+        build_index();
+        save_index(filename + ".idx");
+      }
+    } else if(!frame_count && do_duration_calc)
+      build_index();
+
+    if(frame_count)
+      duration_ms = uint64_t(frame_count) * frame_samples * 1000 / frame_hz;
 
     // start the decoder
+    read_from(data_offset);
     mp3dec_init(static_cast<mp3dec_t *>(mp3dec));
 
     return true;
   }
 
+  /**
+   * Move the play position. If the file has no Xing/VBRI header and wasn't indexed
+   * when loading, the first seek scans the file.
+   *
+   * \param ms Time from the start of the file
+   *
+   * \return `true` if the position was changed
+   */
+  bool MP3Stream::seek(uint32_t ms) {
+    if(!file.is_open() || !frame_hz)
+      return false;
+
+#ifdef BLIT_MP3_DECODE_THREAD
+    stop_thread();
+#endif
+
+    if(!frame_count) {
+      build_index();
+
+      if(frame_count)
+        duration_ms = uint64_t(frame_count) * frame_samples * 1000 / frame_hz;
+    }
+
+    if(!frame_count || seek_index.empty())
+      return false;
+
+    bool was_playing = get_playing();
+    if(was_playing)
+      blit::channels[channel].off();
+
+    uint32_t target = std::min(uint64_t(ms) * frame_hz / (frame_samples * 1000), uint64_t(frame_count - 1));
+
+    // start a few frames early, the decoder needs the bit reservoir from them (up to 511 bytes)
+    const uint32_t reservoir_frames = 6;
+    uint32_t start = target > reservoir_frames ? target - reservoir_frames : 0;
+
+    auto point = std::upper_bound(seek_index.begin(), seek_index.end(), start, [](uint32_t frame, const SeekPoint &p) {return frame < p.frame;});
+    if(point != seek_index.begin())
+      --point;
+
+    read_from(point->offset);
+    mp3dec_init(static_cast<mp3dec_t *>(mp3dec));
+
+    uint32_t frame = point->frame;
+
+    // skip the frames between the seek point and the start
+    if(index_exact) {
+      for(; frame < start && file_buffer_filled >= HDR_SIZE && hdr_valid(file_buffer); frame++) {
+        int len = hdr_frame_bytes(file_buffer, 0) + hdr_padding(file_buffer);
+        if(len <= HDR_SIZE || len > file_buffer_filled)
+          break;
+
+        read(len);
+      }
+    } else
+      target = std::min(target, frame + reservoir_frames); // the TOC isn't precise enough to do better
+
+    // decode up to the target
+    for(; frame < target && file_buffer_filled; frame++) {
+      mp3dec_frame_info_t info = {};
+      int16_t frame_buf[MINIMP3_MAX_SAMPLES_PER_FRAME];
+      mp3dec_decode_frame(static_cast<mp3dec_t *>(mp3dec), file_buffer, file_buffer_filled, frame_buf, &info);
+
+      if(!info.frame_bytes)
+        break;
+
+      read(info.frame_bytes);
+    }
+
+    stream.reset();
+    resampler.reset();
+    started = ended = false;
+
+    seek_sample = uint64_t(target) * frame_samples * blit::sample_rate / frame_hz;
+
+    if(was_playing)
+      play(channel);
+
+    return true;
+  }
+
   void MP3Stream::play(int channel) {
     if(!file_buffer_filled)
       return;
 
     this->channel = channel;
 
-    if(!current_sample) {
-      decode(0);
-      decode(1);
+    if(!started) {
+      started = true;
+      fill();
 
-      cur_audio_buf = 0;
-      current_sample = audio_buf[0];
-      end_sample = current_sample + data_size[0];
-      blit::channels[channel].wave_buf_pos = 0;
+#ifdef BLIT_MP3_DECODE_THREAD
+      start_thread();
+#endif
     }
 
-    blit::channels[channel].waveforms = blit::Waveform::WAVE;
-    blit::channels[channel].volume = 0xFF;
-    blit::channels[channel].wave_callback_arg = this;
-    blit::channels[channel].callback_waveBufferRefresh = &MP3Stream::static_callback;
+    blit::channels[channel].waveforms = blit::Waveform::SAMPLE;
+    blit::channels[channel].volume = 0xFFFF;
+    blit::channels[channel].set_sample_stream(&stream);
 
     blit::channels[channel].adsr = 0xFFFF00;
     blit::channels[channel].trigger_sustain();
@@ -84,138 +212,279 @@ namespace blit {
     return channel != -1 && blit::channels[channel].adsr_phase == blit::ADSRPhase::SUSTAIN;
   }
 
+  /**
+   * Decode more audio if there is space for it. Needs to be called regularly
+   * (from the game's `update`) on the device. Where threads are available decoding
+   * happens in the background and this does nothing.
+   */
   void MP3Stream::update() {
-    if(!current_sample)
-      return;
-
-    // refill audio buffers
-    for(int i = 0; i < 2; i++) {
-      if(!data_size[i])
-        decode(i);
-    }    
+#ifndef BLIT_MP3_DECODE_THREAD
+    if(started)
+      fill();
+#endif
   }
 
   unsigned int MP3Stream::get_current_sample() const {
-    return buffered_samples + blit::channels[channel].wave_buf_pos;
+    return seek_sample + stream.read_pos.load(std::memory_order_relaxed);
   }
 
   int MP3Stream::get_duration_ms() const {
     return duration_ms;
   }
 
-  void MP3Stream::decode(int buf_index) {
-    mp3dec_frame_info_t info = {};
+  /** \returns Number of times playback ran out of decoded audio */
+  uint32_t MP3Stream::get_underruns() const {
+    return stream.underruns.load(std::memory_order_relaxed);
+  }
+
+  // decodes until the stream is full or the file ends
+  void MP3Stream::fill() {
+    while(!ended && stream.get_free() >= resampler.get_max_output(MINIMP3_MAX_SAMPLES_PER_FRAME / 2)) {
+      if(!decode_frame()) {
+        // push the end of the audio through the filter
+        int16_t silence[Resampler::max_taps / 2] = {};
+        resampler.write(stream, silence, resampler.get_taps() / 2);
 
+        ended = true;
+        stream.finish();
+      }
+    }
+  }
+
+  // decodes the next frame into the stream, returns false at the end of the file
+  bool MP3Stream::decode_frame() {
+    mp3dec_frame_info_t info = {};
+    int16_t frame_buf[MINIMP3_MAX_SAMPLES_PER_FRAME];
     int samples = 0;
-    int freq_scale = 1;
 
-    do {
-      if(file_buffer_filled == 0)
-        break;
+    // skip anything that isn't audio
+    while(!samples) {
+      if(!file_buffer_filled)
+        return false;
 
-      if(need_convert) {
-        // attempt to convert to mono 22050Hz (badly)
-        int16_t tmp_buf[MINIMP3_MAX_SAMPLES_PER_FRAME];
-        int tmp_samples = mp3dec_decode_frame(static_cast<mp3dec_t *>(mp3dec), file_buffer, file_buffer_filled, tmp_buf, &info);
-        
-        if(tmp_samples) {
-          freq_scale = info.hz / 22050;
-          int div = info.channels * freq_scale;
-
-          for(int i = 0; i < tmp_samples * info.channels; i += div, samples++) {
-            int32_t tmp = 0;
-            for(int j = 0; j < div; j++)
-              tmp += tmp_buf[i + j];
-            
-            audio_buf[buf_index][samples] = tmp / div;
-          }
-        }
-      } else
-        samples += mp3dec_decode_frame(static_cast<mp3dec_t *>(mp3dec), file_buffer, file_buffer_filled, audio_buf[buf_index] + samples, &info);
+      samples = mp3dec_decode_frame(static_cast<mp3dec_t *>(mp3dec), file_buffer, file_buffer_filled, frame_buf, &info);
 
-      // switch conversion on and retry if needed
-      if(!need_convert && (info.channels != 1 || info.hz != 22050)) {
-        need_convert = true;
-        decode(buf_index);
-        return;
-      }
+      if(!info.frame_bytes)
+        return false;
 
       read(info.frame_bytes);
+    }
 
-      // / 2 because we only ever store mono
-    } while (samples + (MINIMP3_MAX_SAMPLES_PER_FRAME / (2 * freq_scale)) <= audio_buf_size);
+    // mix down to mono
+    if(info.channels == 2) {
+      for(int i = 0; i < samples; i++)
+        frame_buf[i] = (frame_buf[i * 2] + frame_buf[i * 2 + 1]) / 2;
+    }
 
-    if(!samples) {
-      data_size[buf_index] = -1;
-      return;
+    // fill() checked there is space for all of the output
+    resampler.write(stream, frame_buf, samples);
+
+    return true;
+  }
+
+  // skips any ID3v2 tag and reads the format from the first frame
+  bool MP3Stream::find_first_frame() {
+    read_from(0);
+
+    data_offset = 0;
+
+    if(file_buffer_filled >= 10 && memcmp(file_buffer, "ID3", 3) == 0) {
+      // size is 4x7 bits
+      data_offset = 10 + ((file_buffer[6] & 0x7f) << 21 | (file_buffer[7] & 0x7f) << 14 | (file_buffer[8] & 0x7f) << 7 | (file_buffer[9] & 0x7f));
+
+      if(file_buffer[5] & 0x10) // footer
+        data_offset += 10;
+
+      read_from(data_offset);
     }
 
-    data_size[buf_index] = samples;
+    int free_format_bytes = 0, frame_bytes = 0;
+    int i = mp3d_find_frame(file_buffer, file_buffer_filled, &free_format_bytes, &frame_bytes);
+
+    if(!frame_bytes)
+      return false;
+
+    data_offset += i;
+    read_from(data_offset);
+
+    frame_hz = hdr_sample_rate_hz(file_buffer);
+    frame_samples = hdr_frame_samples(file_buffer);
+
+    return true;
   }
 
-  void MP3Stream::static_callback(void *arg) {
-    reinterpret_cast<MP3Stream *>(arg)->callback();
+  static uint32_t read_be32(const uint8_t *p) {
+    return p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
   }
 
-  void MP3Stream::callback() {
-    if(!current_sample) {
-      blit::channels[channel].off();
+  static uint16_t read_be16(const uint8_t *p) {
+    return p[0] << 8 | p[1];
+  }
+
+  // reads the frame count and seek table from a Xing/Info or VBRI header in the first frame
+  void MP3Stream::parse_vbr_header() {
+    const uint8_t *hdr = file_buffer;
+    int frame_bytes = hdr_frame_bytes(hdr, 0) + hdr_padding(hdr);
+
+    if(frame_bytes <= HDR_SIZE || frame_bytes > file_buffer_filled)
       return;
-    }
 
-    // there was no buffer last time
-    if(current_sample == end_sample) {
-      if(data_size[cur_audio_buf]) {
-        end_sample = audio_buf[cur_audio_buf] + data_size[cur_audio_buf]; // recovered from underrun
-      } else {
-        memset(blit::channels[channel].wave_buffer, 0, 64 * sizeof(int16_t));
+    uint32_t stream_bytes = file.get_length() - data_offset - frame_bytes;
+
+    // Xing/Info follows the side info
+    int side_info = HDR_TEST_MPEG1(hdr) ? (HDR_IS_MONO(hdr) ? 17 : 32) : (HDR_IS_MONO(hdr) ? 9 : 17);
+    const uint8_t *xing = hdr + HDR_SIZE + side_info;
+
+    if(xing + 8 <= hdr + frame_bytes && (memcmp(xing, "Xing", 4) == 0 || memcmp(xing, "Info", 4) == 0)) {
+      uint32_t flags = read_be32(xing + 4);
+      const uint8_t *ptr = xing + 8;
+
+      if(!(flags & 1))
         return;
+
+      frame_count = read_be32(ptr);
+      ptr += 4;
+
+      if(flags & 2) {
+        stream_bytes = read_be32(ptr);
+        ptr += 4;
       }
+
+      // the TOC has the position of each 1% of the file (as a fraction of 256)
+      if((flags & 4) && ptr + 100 <= hdr + frame_bytes) {
+        for(int i = 0; i < 100; i++)
+          seek_index.push_back({uint32_t(uint64_t(frame_count) * i / 100), uint32_t(data_offset + frame_bytes + uint64_t(ptr[i]) * stream_bytes / 256)});
+      } else
+        seek_index.push_back({0, data_offset + frame_bytes});
+
+      // the header frame isn't audio
+      data_offset += frame_bytes;
+      return;
     }
 
-    auto out = blit::channels[channel].wave_buffer;
+    // VBRI is always 32 bytes after the header
+    const uint8_t *vbri = hdr + HDR_SIZE + 32;
+
+    if(vbri + 26 <= hdr + frame_bytes && memcmp(vbri, "VBRI", 4) == 0) {
+      frame_count = read_be32(vbri + 14);
+
+      int entries = read_be16(vbri + 18);
+      int scale = read_be16(vbri + 20);
+      int entry_size = read_be16(vbri + 22);
+      int entry_frames = read_be16(vbri + 24);
 
-    int i = 0;
-    for(; i < 64; i++)
-      *(out++) = *(current_sample++);
+      data_offset += frame_bytes;
 
+      const uint8_t *ptr = vbri + 26;
+      uint32_t offset = data_offset;
 
-    // swap buffers
-    if(current_sample == end_sample) {
-      data_size[cur_audio_buf] = 0;
-      cur_audio_buf = ++cur_audio_buf % 2;
+      seek_index.push_back({0, offset});
 
-      if(data_size[cur_audio_buf] == -1) // EOF
-        current_sample = end_sample = nullptr;
-      else {
-        current_sample = audio_buf[cur_audio_buf];
-        end_sample = current_sample + data_size[cur_audio_buf];
-        // if(current_sample == end_sample) underrun
+      // each entry is the size of the next `entry_frames` frames
+      for(int i = 0; i < entries && entry_size >= 1 && entry_size <= 4 && ptr + entry_size <= hdr + frame_bytes; i++, ptr += entry_size) {
+        uint32_t size = 0;
+        for(int j = 0; j < entry_size; j++)
+          size = size << 8 | ptr[j];
+
+        offset += size * scale;
+
+        if(uint32_t(i + 1) * entry_frames < frame_count)
+          seek_index.push_back({uint32_t(i + 1) * entry_frames, offset});
       }
+
+      index_exact = true;
     }
+  }
+
+  // scans the frame headers to get the frame count and seek points
+  bool MP3Stream::build_index() {
+    seek_index.clear();
+    index_exact = true;
+    frame_count = 0;
+
+    read_from(data_offset);
+
+    while(file_buffer_filled >= HDR_SIZE) {
+      if(!hdr_valid(file_buffer)) {
+        // lost sync, look for the next frame
+        int free_format_bytes = 0, frame_bytes = 0;
+        int i = mp3d_find_frame(file_buffer, file_buffer_filled, &free_format_bytes, &frame_bytes);
+
+        if(!frame_bytes && i == 0)
+          break;
+
+        read(i);
+        continue;
+      }
+
+      int len = hdr_frame_bytes(file_buffer, 0) + hdr_padding(file_buffer);
+      if(len <= HDR_SIZE || len > file_buffer_filled)
+        break; // free format or truncated
+
+      if(frame_count % index_interval == 0)
+        seek_index.push_back({frame_count, file_offset - file_buffer_filled});
 
-    buffered_samples += 64;
+      frame_count++;
+      read(len);
+    }
+
+    return frame_count != 0;
   }
 
-  int MP3Stream::calc_duration() {
-    // decode entire file to get length
-    unsigned int samples = 0;
+  #pragma pack(push, 1)
+  struct packed_mp3_index {
+    char type[4];         // "BMPI"
+    uint32_t file_length; // of the MP3 file, to detect changes
+    uint32_t data_offset;
+    uint32_t frame_count;
+    uint32_t point_count;
+  };
+  #pragma pack(pop)
+
+  bool MP3Stream::load_index(const std::string &filename) {
+    File index_file;
+    packed_mp3_index header;
+
+    if(!index_file.open(filename) || index_file.read(0, sizeof(header), (char *)&header) != sizeof(header))
+      return false;
 
-    mp3dec_frame_info_t info = {};
+    if(memcmp(header.type, "BMPI", 4) != 0 || header.file_length != file.get_length() || header.data_offset != data_offset || !header.point_count)
+      return false;
 
-    //while(true)
-    while(file_buffer_filled) {
-      samples += mp3dec_decode_frame(static_cast<mp3dec_t *>(mp3dec), file_buffer, file_buffer_filled, nullptr, &info);
-      read(info.frame_bytes);
+    seek_index.resize(header.point_count);
+
+    int32_t len = header.point_count * sizeof(SeekPoint);
+    if(index_file.read(sizeof(header), len, (char *)seek_index.data()) != len) {
+      seek_index.clear();
+      return false;
     }
 
-    // reset;
-    file_offset = 0;
+    frame_count = header.frame_count;
+    index_exact = true;
+
+    return true;
+  }
+
+  void MP3Stream::save_index(const std::string &filename) {
+    if(!frame_count)
+      return;
+
+    File index_file(filename, OpenMode::write);
+
+    if(!index_file.is_open())
+      return;
+
+    packed_mp3_index header{{'B', 'M', 'P', 'I'}, file.get_length(), data_offset, frame_count, uint32_t(seek_index.size())};
+
+    index_file.write(0, sizeof(header), (const char *)&header);
+    index_file.write(sizeof(header), seek_index.size() * sizeof(SeekPoint), (const char *)seek_index.data());
+  }
+
+  // refills the buffer starting at `offset` in the file
+  void MP3Stream::read_from(uint32_t offset) {
+    file_offset = offset;
     file_buffer_filled = 0;
     read(0);
-
-    int len_ms = (static_cast<uint64_t>(samples) * 1000) / info.hz;
-    return len_ms;
   }
 
   void MP3Stream::read(int32_t len) {
@@ -232,4 +501,35 @@ namespace blit {
     file_buffer_filled += read;
     file_offset += read;
   }
+
+#ifdef BLIT_MP3_DECODE_THREAD
+  void MP3Stream::start_thread() {
+    quit = false;
+    thread = std::thread(&MP3Stream::decode_thread, this);
+  }
+
+  void MP3Stream::stop_thread() {
+    if(!thread.joinable())
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
+
+    wake.notify_one();
+    thread.join();
+  }
+
+  void MP3Stream::decode_thread() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while(!quit && !ended) {
+      fill();
+
+      // the audio callback doesn't signal when it reads, so check again shortly
+      wake.wait_for(lock, std::chrono::milliseconds(5));
+    }
+  }
+#endif
 }
\ No newline at end of file
@@ -1,17 +1,31 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
+#include "audio/audio.hpp"
+#include "audio/resampler.hpp"
 #include "engine/file.hpp"
 
+// decode on a thread where there are threads, otherwise update() does it
+#if !defined(TARGET_32BLIT_HW) && !defined(__EMSCRIPTEN__)
+#define BLIT_MP3_DECODE_THREAD
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
 namespace blit {
   class MP3Stream final
   {
   public:
-    MP3Stream();
+    MP3Stream(uint32_t buffer_size = default_buffer_size);
     ~MP3Stream();
 
-    bool load(std::string filename, bool do_duration_calc = false);
+    static const uint32_t default_buffer_size = 1152 * 8;
+
+    bool load(std::string filename, bool do_duration_calc = false, bool cache_index = false);
+    bool seek(uint32_t ms);
 
     void play(int channel);
     void pause();
@@ -22,15 +36,20 @@ namespace blit {
 
     unsigned int get_current_sample() const;
     int get_duration_ms() const;
+    uint32_t get_underruns() const;
 
   private:
-    void decode(int buf_index);
-    int calc_duration();
+    void fill();
+    bool decode_frame();
 
-    void read(int32_t len);
+    bool find_first_frame();
+    void parse_vbr_header();
+    bool build_index();
+    bool load_index(const std::string &filename);
+    void save_index(const std::string &filename);
 
-    static void static_callback(void *arg);
-    void callback();
+    void read(int32_t len);
+    void read_from(uint32_t offset);
 
     // file io
     blit::File file;
@@ -44,15 +63,38 @@ namespace blit {
 
     // decoding
     void *mp3dec = nullptr;
-    bool need_convert = false;
+    bool started = false, ended = false;
 
-    static const int audio_buf_size = 1152 * 4;
-    int16_t audio_buf[2][audio_buf_size];
-    int16_t *current_sample = nullptr, *end_sample = nullptr;
-    int data_size[2]{};
-    int cur_audio_buf = 0;
+    // decoded (mono) audio, played by the channel
+    int16_t *audio_buf;
+    SampleStream stream;
+    Resampler resampler;
 
-    unsigned int buffered_samples = 0;
     int duration_ms = 0;
+
+    // seeking
+    struct SeekPoint {
+      uint32_t frame;
+      uint32_t offset;
+    };
+
+    static const int index_interval = 32; // frames between seek points when scanning
+
+    std::vector<SeekPoint> seek_index;
+    bool index_exact = false; // seek points are at frame boundaries (not from a Xing TOC)
+    uint32_t data_offset = 0; // first audio frame
+    uint32_t frame_count = 0, frame_samples = 0, frame_hz = 0;
+    uint32_t seek_sample = 0; // output samples before the start of the stream
+
+#ifdef BLIT_MP3_DECODE_THREAD
+    void start_thread();
+    void stop_thread();
+    void decode_thread();
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool quit = false;
+#endif
   };
 }
\ No newline at end of file
@@ -0,0 +1,259 @@
+/*! \file resampler.cpp
+    \brief Sample rate conversion
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "resampler.hpp"
+#include "math/constants.hpp"
+
+namespace blit {
+  // zeroth order modified Bessel function, for the Kaiser window
+  static float bessel_i0(float x) {
+    float sum = 1.0f, term = 1.0f;
+
+    for(int k = 1; k < 20; k++) {
+      term *= (x / (2.0f * k)) * (x / (2.0f * k));
+      sum += term;
+    }
+
+    return sum;
+  }
+
+  static uint32_t gcd(uint32_t a, uint32_t b) {
+    while(b) {
+      uint32_t t = a % b;
+      a = b;
+      b = t;
+    }
+    return a;
+  }
+
+  Resampler::Resampler() = default;
+
+  /**
+   * \param in_rate Sample rate of the input
+   * \param out_rate Sample rate of the output, defaults to the engine's rate
+   */
+  Resampler::Resampler(uint32_t in_rate, uint32_t out_rate) {
+    set_rates(in_rate, out_rate);
+  }
+
+  Resampler::~Resampler() {
+    delete[] coefs;
+    delete[] history;
+  }
+
+  /**
+   * Set the input and output rates and build the filter for them. Also resets the filter state.
+   *
+   * \param in_rate Sample rate of the input
+   * \param out_rate Sample rate of the output, defaults to the engine's rate
+   */
+  void Resampler::set_rates(uint32_t in_rate, uint32_t out_rate) {
+    delete[] coefs;
+    delete[] history;
+    coefs = nullptr;
+    history = nullptr;
+
+    passthrough = !in_rate || !out_rate || in_rate == out_rate;
+
+    uint32_t div = passthrough ? 1 : gcd(in_rate, out_rate);
+    this->in_rate = in_rate / div;
+    this->out_rate = out_rate / div;
+
+    if(passthrough)
+      return;
+
+    float ratio = float(in_rate) / out_rate;
+
+    // the filter covers the same time at the output rate however much the input is decimated
+    taps = std::min(std::max(int(ceilf(24.0f * std::max(ratio, 1.0f) / 2.0f)) * 2, 24), max_taps);
+
+    // cut off a little below whichever Nyquist frequency is lower, in cycles per input sample
+    float cutoff = 0.45f * std::min(1.0f / ratio, 1.0f);
+
+    const float beta = 6.0f; // ~60dB stopband
+    float window_scale = 1.0f / bessel_i0(beta);
+    float half_width = taps / 2.0f;
+
+    coefs = new int16_t[(phases + 1) * taps];
+
+    for(int p = 0; p <= phases; p++) {
+      float row[max_taps];
+      float sum = 0.0f;
+
+      for(int j = 0; j < taps; j++) {
+        // distance of this tap from the output sample, which is `p / phases` after
+        // the sample in the middle of the window
+        float t = j - (taps / 2 - 1) - float(p) / phases;
+
+        float x = 2.0f * cutoff * t;
+        float sinc = t == 0.0f ? 1.0f : sinf(pi * x) / (pi * x);
+
+        float w = t / half_width;
+        float window = std::abs(w) >= 1.0f ? 0.0f : bessel_i0(beta * sqrtf(1.0f - w * w)) * window_scale;
+
+        row[j] = sinc * window;
+        sum += row[j];
+      }
+
+      // normalise so each phase has exactly unity gain at DC
+      int total = 0, largest = 0;
+      int16_t *out = coefs + p * taps;
+
+      for(int j = 0; j < taps; j++) {
+        out[j] = int16_t(lroundf(row[j] / sum * (1 << coef_bits)));
+        total += out[j];
+
+        if(out[j] > out[largest])
+          largest = j;
+      }
+
+      out[largest] += (1 << coef_bits) - total;
+    }
+
+    history = new int16_t[taps * 2];
+
+    reset();
+  }
+
+  /**
+   * Clear the filter state, for example after seeking the input.
+   */
+  void Resampler::reset() {
+    if(history)
+      memset(history, 0, taps * 2 * sizeof(int16_t));
+
+    history_pos = 0;
+    phase_acc = 0;
+
+    // start with the first input sample in the middle of the window
+    need = taps / 2 + 1;
+  }
+
+  /**
+   * Convert a block of samples. Stops when either all of the input has been used or
+   * the output is full. Some input may be used without producing any output yet.
+   *
+   * \param in Input samples
+   * \param in_count Number of input samples
+   * \param in_used Set to the number of input samples used
+   * \param out Buffer for the output
+   * \param out_count Size of the output buffer in samples
+   *
+   * \return Number of samples output
+   */
+  uint32_t Resampler::process(const int16_t *in, uint32_t in_count, uint32_t &in_used, int16_t *out, uint32_t out_count) {
+    if(passthrough) {
+      uint32_t count = std::min(in_count, out_count);
+      memcpy(out, in, count * sizeof(int16_t));
+      in_used = count;
+      return count;
+    }
+
+    uint32_t out_pos = 0;
+    in_used = 0;
+
+    while(out_pos < out_count) {
+      for(; need; need--) {
+        if(in_used == in_count)
+          return out_pos;
+
+        push(in[in_used++]);
+      }
+
+      out[out_pos++] = filter();
+
+      phase_acc += in_rate;
+      need = phase_acc / out_rate;
+      phase_acc %= out_rate;
+    }
+
+    return out_pos;
+  }
+
+  /**
+   * Convert samples and write them to a stream, as much as the stream has space for.
+   *
+   * \param stream Stream to write to, must be PCM16
+   * \param in Input samples
+   * \param in_count Number of input samples
+   *
+   * \return Number of input samples used
+   */
+  uint32_t Resampler::write(SampleStream &stream, const int16_t *in, uint32_t in_count) {
+    int16_t buf[256];
+    uint32_t total_used = 0;
+
+    while(total_used < in_count) {
+      uint32_t space = std::min(stream.get_free(), uint32_t(256));
+      if(!space)
+        break;
+
+      uint32_t used;
+      uint32_t count = process(in + total_used, in_count - total_used, used, buf, space);
+
+      stream.write(buf, count);
+      total_used += used;
+    }
+
+    return total_used;
+  }
+
+  /**
+   * \param in_count Number of input samples
+   *
+   * \return Maximum number of samples `process` can output for the input
+   */
+  uint32_t Resampler::get_max_output(uint32_t in_count) const {
+    if(passthrough)
+      return in_count;
+
+    return uint64_t(in_count) * out_rate / in_rate + 2;
+  }
+
+  /** \returns Input rate, reduced by the greatest common divisor of the two rates */
+  uint32_t Resampler::get_in_rate() const {
+    return in_rate;
+  }
+
+  /** \returns Output rate, reduced by the greatest common divisor of the two rates */
+  uint32_t Resampler::get_out_rate() const {
+    return out_rate;
+  }
+
+  /** \returns Length of the filter in input samples, 0 if not converting */
+  int Resampler::get_taps() const {
+    return passthrough ? 0 : taps;
+  }
+
+  void Resampler::push(int16_t sample) {
+    history[history_pos] = history[history_pos + taps] = sample;
+
+    if(++history_pos == taps)
+      history_pos = 0;
+  }
+
+  // calculates the output sample at the current phase
+  int16_t Resampler::filter() const {
+    const int16_t *window = history + history_pos;
+
+    // position between the two nearest filter phases (Q16)
+    uint32_t pos = (uint64_t(phase_acc) * phases << 16) / out_rate;
+    const int16_t *coefs0 = coefs + (pos >> 16) * taps;
+    const int16_t *coefs1 = coefs0 + taps;
+
+    int32_t acc0 = 0, acc1 = 0;
+    for(int j = 0; j < taps; j++) {
+      acc0 += window[j] * coefs0[j];
+      acc1 += window[j] * coefs1[j];
+    }
+
+    int32_t acc = acc0 + int32_t((int64_t(acc1 - acc0) * (pos & 0xffff)) >> 16);
+    acc = (acc + (1 << (coef_bits - 1))) >> coef_bits;
+
+    return std::min(std::max(acc, int32_t(-0x8000)), int32_t(0x7fff));
+  }
+}
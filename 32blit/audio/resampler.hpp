@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#include "audio/audio.hpp"
+
+namespace blit {
+  /**
+   * Converts a stream of mono 16-bit samples between sample rates, for example to play a
+   * 44.1kHz or 48kHz source at the engine's rate. Uses a polyphase windowed-sinc filter
+   * (interpolating between phases), so it can convert between any two rates and removes
+   * frequencies above the output's Nyquist limit instead of aliasing them.
+   *
+   * Input can be passed in blocks of any size, the filter state is kept between calls.
+   */
+  class Resampler final
+  {
+  public:
+    Resampler();
+    Resampler(uint32_t in_rate, uint32_t out_rate = sample_rate);
+    ~Resampler();
+
+    Resampler(const Resampler &) = delete;
+    Resampler &operator=(const Resampler &) = delete;
+
+    void set_rates(uint32_t in_rate, uint32_t out_rate = sample_rate);
+    void reset();
+
+    uint32_t process(const int16_t *in, uint32_t in_count, uint32_t &in_used, int16_t *out, uint32_t out_count);
+    uint32_t write(SampleStream &stream, const int16_t *in, uint32_t in_count);
+
+    uint32_t get_max_output(uint32_t in_count) const;
+    uint32_t get_in_rate() const;
+    uint32_t get_out_rate() const;
+    int get_taps() const;
+
+    static constexpr int max_taps = 96;
+
+  private:
+    static constexpr int phases = 32;    // filter phases between two input samples
+    static constexpr int coef_bits = 14; // coefficients are Q14
+
+    void push(int16_t sample);
+    int16_t filter() const;
+
+    uint32_t in_rate = 0, out_rate = 0; // reduced ratio
+    bool passthrough = true;
+
+    int taps = 0;
+    int16_t *coefs = nullptr;   // (phases + 1) rows of `taps` coefficients
+
+    // last `taps` input samples, stored twice so the window is always contiguous
+    int16_t *history = nullptr;
+    int history_pos = 0;
+
+    uint32_t need = 0;          // input samples to read before the next output
+    uint32_t phase_acc = 0;     // position between input samples, in 1/out_rate units
+  };
+}
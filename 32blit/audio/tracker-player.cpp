@@ -0,0 +1,802 @@
+/*! \file tracker-player.cpp
+    \brief Tracker module player
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "tracker-player.hpp"
+
+#include "engine/file.hpp"
+
+namespace blit {
+  // half the PAL Amiga clock, divided by the period to get the sample rate
+  static const uint32_t amiga_clock = 3546895;
+
+  static const uint16_t min_period = 113, max_period = 856;
+
+  // periods of the three octaves of notes at finetune 0
+  static const uint16_t base_periods[36] = {
+    856, 808, 762, 720, 678, 640, 604, 570, 538, 508, 480, 453,
+    428, 404, 381, 360, 339, 320, 302, 285, 269, 254, 240, 226,
+    214, 202, 190, 180, 170, 160, 151, 143, 135, 127, 120, 113
+  };
+
+  static const uint8_t vibrato_sine[32] = {
+    0, 24, 49, 74, 97, 120, 141, 161, 180, 197, 212, 224, 235, 244, 250, 253,
+    255, 253, 250, 244, 235, 224, 212, 197, 180, 161, 141, 120, 97, 74, 49, 24
+  };
+
+  // periods for every finetune (-8 to 7, indexed by the low nibble), built on the first load
+  static uint16_t period_table[16][36];
+  static bool period_table_built = false;
+
+  static void build_period_table() {
+    for(int ft = 0; ft < 16; ft++) {
+      int finetune = ft < 8 ? ft : ft - 16;
+      float scale = powf(2.0f, -finetune / 96.0f); // finetune steps are 1/8th of a semitone
+
+      for(int n = 0; n < 36; n++)
+        period_table[ft][n] = ft == 0 ? base_periods[n] : uint16_t(base_periods[n] * scale + 0.5f);
+    }
+
+    period_table_built = true;
+  }
+
+  static uint16_t read_be16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+  }
+
+  // returns the channel count for a format tag, or 0 if unknown
+  static int channels_for_tag(const char *tag) {
+    if(!memcmp(tag, "M.K.", 4) || !memcmp(tag, "M!K!", 4) || !memcmp(tag, "M&K!", 4) || !memcmp(tag, "FLT4", 4) || !memcmp(tag, "N.T.", 4))
+      return 4;
+
+    if(!memcmp(tag, "FLT8", 4) || !memcmp(tag, "OCTA", 4) || !memcmp(tag, "OKTA", 4) || !memcmp(tag, "CD81", 4))
+      return 8;
+
+    auto is_digit = [](char c) {return c >= '0' && c <= '9';};
+
+    // xCHN
+    if(is_digit(tag[0]) && !memcmp(tag + 1, "CHN", 3))
+      return tag[0] - '0';
+
+    // xxCH/xxCN
+    if(is_digit(tag[0]) && is_digit(tag[1]) && tag[2] == 'C' && (tag[3] == 'H' || tag[3] == 'N'))
+      return (tag[0] - '0') * 10 + (tag[1] - '0');
+
+    return 0;
+  }
+
+  TrackerPlayer::TrackerPlayer() {
+    if(!period_table_built)
+      build_period_table();
+  }
+
+  TrackerPlayer::~TrackerPlayer() {
+    stop();
+    unload();
+  }
+
+  /**
+   * Load a module. Files that are already in memory (like assets added with
+   * `File::add_buffer_file`) are played from there, others are read into memory.
+   *
+   * \param filename File to load
+   *
+   * \return `true` if the file is a supported module
+   */
+  bool TrackerPlayer::load(std::string filename) {
+    stop();
+    unload();
+
+    File file;
+    if(!file.open(filename))
+      return false;
+
+    data_length = file.get_length();
+
+    if(file.get_ptr())
+      data = file.get_ptr();
+    else {
+      data_buf = new uint8_t[data_length];
+
+      if(file.read(0, data_length, (char *)data_buf) != int32_t(data_length)) {
+        unload();
+        return false;
+      }
+
+      data = data_buf;
+    }
+
+    // 31 sample modules have a tag after the order list, 15 sample ones don't
+    uint32_t header_size = 1084;
+    num_channels = data_length >= header_size ? channels_for_tag((const char *)data + 1080) : 0;
+    num_samples = max_samples;
+
+    if(!num_channels) {
+      header_size = 600;
+      num_channels = 4;
+      num_samples = 15;
+    }
+
+    if(data_length < header_size || num_channels > max_channels) {
+      unload();
+      return false;
+    }
+
+    memcpy(title, data, 20);
+    title[20] = 0;
+
+    const uint8_t *song = data + 20 + num_samples * 30;
+    song_length = song[0];
+    restart_order = num_samples == 15 ? 0 : song[1]; // the old format has the tempo here
+    orders = song + 2;
+
+    if(song_length < 1 || song_length > 128) {
+      unload();
+      return false;
+    }
+
+    // patterns that aren't played are still stored
+    int num_patterns = 0;
+    for(int i = 0; i < (num_samples == 15 ? song_length : 128); i++)
+      num_patterns = std::max(num_patterns, orders[i] + 1);
+
+    patterns = data + header_size;
+    uint32_t pattern_bytes = num_patterns * rows_per_pattern * num_channels * 4;
+
+    if(header_size + pattern_bytes > data_length) {
+      unload();
+      return false;
+    }
+
+    // samples follow the patterns, the last one may be truncated
+    uint32_t offset = header_size + pattern_bytes;
+
+    for(int i = 0; i < max_samples; i++) {
+      auto &sample = samples[i];
+      sample = {};
+
+      if(i >= num_samples)
+        continue;
+
+      const uint8_t *info = data + 20 + i * 30;
+      uint32_t length = read_be16(info + 22) * 2;
+      uint32_t loop_start = read_be16(info + 26) * 2;
+      uint32_t loop_length = read_be16(info + 28) * 2;
+
+      sample.data = (const int8_t *)data + offset;
+      sample.length = std::min(length, data_length - std::min(offset, data_length));
+      sample.finetune = int8_t(info[24] << 4) >> 4;
+      sample.volume = std::min(info[25], uint8_t(64));
+
+      if(loop_length > 2 && loop_start < sample.length) {
+        sample.loop_start = loop_start;
+        sample.loop_end = std::min(loop_start + loop_length, sample.length);
+      }
+
+      offset += length;
+    }
+
+    set_volume(volume);
+
+    return true;
+  }
+
+  /**
+   * Start playing the module from the beginning.
+   *
+   * \param first_channel First of the channels to play the module with, the module uses one per track
+   *
+   * \return `true` if playback started, `false` if nothing is loaded or there aren't enough channels
+   */
+  bool TrackerPlayer::play(int first_channel) {
+    stop();
+
+    if(!data || first_channel < 0 || first_channel + num_channels > CHANNEL_COUNT || !audio_commands)
+      return false;
+
+    end_render();
+
+    out_channels = &channels[first_channel];
+    init_channels(out_channels);
+    reset();
+
+    playing = true;
+    set_audio_sequencer(sequencer_callback, this);
+
+    return true;
+  }
+
+  /**
+   * Stop playback and silence the module's channels.
+   */
+  void TrackerPlayer::stop() {
+    if(!playing)
+      return;
+
+    playing = false;
+
+    // also waits for a tick running on the audio thread, so the module can be freed after this
+    if(audio_commands && audio_commands->sequencer_arg.load() == this)
+      set_audio_sequencer(nullptr, nullptr);
+
+    for(int c = 0; c < num_channels; c++)
+      out_channels[c].off();
+  }
+
+  /** \returns `true` if the module is playing */
+  bool TrackerPlayer::get_playing() const {
+    return playing;
+  }
+
+  /**
+   * Set if the module should restart after the end of the song (the default) or stop.
+   *
+   * \param loop Enable looping
+   */
+  void TrackerPlayer::set_loop(bool loop) {
+    this->loop = loop;
+  }
+
+  /**
+   * Set the volume of the module. At full volume a sample played at full volume
+   * on half of the channels reaches full scale.
+   *
+   * \param volume Volume, 0-0xffff
+   */
+  void TrackerPlayer::set_volume(uint16_t volume) {
+    this->volume = volume;
+    channel_gain = num_channels ? std::min(volume * 2 / num_channels, 0xffff) : 0;
+  }
+
+  /**
+   * Render the module without playing it, for example to save it to a file. The first
+   * call starts from the beginning. The module can't be played while rendering.
+   *
+   * \param buffer Buffer for the signed 16-bit samples
+   * \param count Number of samples to render
+   *
+   * \return Number of samples rendered, less than `count` at the end of the song if not looping
+   */
+  uint32_t TrackerPlayer::render(int16_t *buffer, uint32_t count) {
+    if(!data || playing)
+      return 0;
+
+    if(!render_queue) {
+      render_channels = new AudioChannel[num_channels];
+      render_queue = new AudioCommandQueue;
+      render_pos = 0;
+
+      out_channels = render_channels;
+      init_channels(out_channels);
+      reset();
+
+      set_audio_sequencer(sequencer_callback, this, render_queue);
+    }
+
+    mix_audio_frames(render_channels, num_channels, render_queue, buffer, count);
+
+    // the sequencer finishes at the end of the song
+    if(render_queue->sequencer_finished) {
+      // the next call starts again
+      count = end_time - render_pos;
+      end_render();
+      return count;
+    }
+
+    render_pos += count;
+    return count;
+  }
+
+  /** \returns title of the module */
+  std::string TrackerPlayer::get_title() const {
+    return title;
+  }
+
+  /** \returns number of tracks in the module, the number of channels it plays on */
+  int TrackerPlayer::get_channel_count() const {
+    return num_channels;
+  }
+
+  /** \returns number of entries in the module's order list */
+  int TrackerPlayer::get_song_length() const {
+    return song_length;
+  }
+
+  /** \returns position in the order list of the pattern being played */
+  int TrackerPlayer::get_order() const {
+    return order;
+  }
+
+  /** \returns row of the pattern being played */
+  int TrackerPlayer::get_row() const {
+    return row;
+  }
+
+  /** \returns number of times the song has looped */
+  uint32_t TrackerPlayer::get_loop_count() const {
+    return loop_count;
+  }
+
+  uint32_t TrackerPlayer::sequencer_callback(void *arg) {
+    return static_cast<TrackerPlayer *>(arg)->tick();
+  }
+
+  // processes one tick of the song and returns its length in samples
+  uint32_t TrackerPlayer::tick() {
+    if(!playing && !render_queue)
+      return 0;
+
+    if(ended) {
+      for(int c = 0; c < num_channels; c++)
+        out_channels[c].off();
+
+      if(render_queue)
+        end_time = render_queue->time.load(std::memory_order_relaxed);
+
+      playing = false;
+      return 0;
+    }
+
+    if(tick_count == 0 && !in_pattern_delay)
+      process_row();
+    else {
+      for(int c = 0; c < num_channels; c++)
+        process_effects(chans[c], false);
+    }
+
+    output_channels();
+
+    if(++tick_count >= speed) {
+      tick_count = 0;
+
+      // repeat the row without its notes
+      in_pattern_delay = pattern_delay > 0;
+      if(in_pattern_delay)
+        pattern_delay--;
+      else
+        next_row();
+    }
+
+    // a tick is 2.5ms at 100 BPM
+    uint32_t samples = sample_rate * 5 + tick_remainder;
+    uint32_t divisor = tempo * 2;
+    tick_remainder = samples % divisor;
+
+    return samples / divisor;
+  }
+
+  void TrackerPlayer::reset() {
+    memset(chans, 0, sizeof(chans));
+
+    speed = 6;
+    tempo = 125;
+    tick_count = 0;
+    tick_remainder = 0;
+    pattern_delay = 0;
+    in_pattern_delay = false;
+    jump_order = jump_row = loop_jump_row = -1;
+
+    memset(visited_orders, 0, sizeof(visited_orders));
+    enter_order(0);
+
+    order = 0;
+    row = 0;
+    loop_count = 0;
+    ended = false;
+  }
+
+  // reads the notes of the current row and processes the first tick of its effects
+  void TrackerPlayer::process_row() {
+    int pattern = orders[order];
+    const uint8_t *cell = patterns + (pattern * rows_per_pattern + row) * num_channels * 4;
+
+    for(int c = 0; c < num_channels; c++, cell += 4) {
+      auto &chan = chans[c];
+
+      uint8_t sample = (cell[0] & 0xf0) | (cell[2] >> 4);
+      uint16_t period = ((cell[0] & 0xf) << 8) | cell[1];
+      chan.effect = cell[2] & 0xf;
+      chan.param = cell[3];
+
+      bool delay = chan.effect == 0xe && (chan.param >> 4) == 0xd && (chan.param & 0xf);
+
+      // a sample number without a note only resets the volume
+      if(sample && sample <= num_samples && !(delay && period)) {
+        chan.sample = sample;
+        chan.volume = samples[sample - 1].volume;
+        chan.finetune = samples[sample - 1].finetune;
+      }
+
+      // set finetune applies to the note on the same row
+      if(chan.effect == 0xe && (chan.param >> 4) == 0x5)
+        chan.finetune = int8_t(chan.param << 4) >> 4;
+
+      if(period) {
+        if(delay) {
+          chan.delayed_period = period;
+          chan.delayed_sample = sample <= num_samples ? sample : 0;
+        } else if(chan.effect == 0x3 || chan.effect == 0x5) {
+          int note = find_note(period);
+          chan.target_period = note < 0 ? period : note_period(note, chan.finetune);
+        } else
+          trigger_note(chan, period, 0);
+      }
+
+      process_effects(chan, true);
+    }
+  }
+
+  void TrackerPlayer::trigger_note(Channel &chan, uint16_t period, uint8_t sample) {
+    if(sample) {
+      chan.sample = sample;
+      chan.volume = samples[sample - 1].volume;
+      chan.finetune = samples[sample - 1].finetune;
+    }
+
+    int note = find_note(period);
+    chan.period = note < 0 ? period : note_period(note, chan.finetune);
+
+    chan.trigger = true;
+    chan.trigger_offset = 0;
+
+    if(chan.vibrato_wave < 4)
+      chan.vibrato_pos = 0;
+    if(chan.tremolo_wave < 4)
+      chan.tremolo_pos = 0;
+  }
+
+  static int waveform_value(uint8_t wave, uint8_t pos) {
+    switch(wave & 3) {
+      case 1: { // ramp down
+        int value = (pos & 31) * 8;
+        return pos & 32 ? 255 - value : value;
+      }
+      case 2: // square
+        return 255;
+      default: // sine (and random, which isn't random in ProTracker either)
+        return vibrato_sine[pos & 31];
+    }
+  }
+
+  static void volume_slide(uint8_t &volume, uint8_t param) {
+    if(param >> 4)
+      volume = std::min(volume + (param >> 4), 64);
+    else
+      volume = std::max(volume - (param & 0xf), 0);
+  }
+
+  // applies the current effect of a channel for this tick and sets its output
+  void TrackerPlayer::process_effects(Channel &chan, bool first_tick) {
+    int x = chan.param >> 4, y = chan.param & 0xf;
+    int period_offset = 0, volume_offset = 0;
+    int arpeggio_note = -1;
+
+    auto tone_portamento = [this, &chan]() {
+      if(chan.period < chan.target_period)
+        chan.period = std::min(chan.period + chan.porta_speed, int(chan.target_period));
+      else if(chan.period > chan.target_period && chan.target_period)
+        chan.period = std::max(chan.period - chan.porta_speed, int(chan.target_period));
+    };
+
+    auto vibrato = [&chan, &period_offset]() {
+      int delta = (waveform_value(chan.vibrato_wave, chan.vibrato_pos) * chan.vibrato_depth) >> 7;
+      period_offset = chan.vibrato_pos & 32 ? -delta : delta;
+      chan.vibrato_pos = (chan.vibrato_pos + chan.vibrato_speed) & 63;
+    };
+
+    switch(chan.effect) {
+      case 0x0: // arpeggio
+        if(chan.param && tick_count % 3) {
+          int note = find_note(chan.period);
+          if(note >= 0)
+            arpeggio_note = std::min(note + (tick_count % 3 == 1 ? x : y), 35);
+        }
+        break;
+
+      case 0x1: // portamento up
+        if(!first_tick)
+          chan.period = std::max(chan.period - chan.param, int(min_period));
+        break;
+
+      case 0x2: // portamento down
+        if(!first_tick)
+          chan.period = std::min(chan.period + chan.param, int(max_period));
+        break;
+
+      case 0x3: // tone portamento
+        if(first_tick) {
+          if(chan.param)
+            chan.porta_speed = chan.param;
+        } else
+          tone_portamento();
+        break;
+
+      case 0x4: // vibrato
+        if(first_tick) {
+          if(x)
+            chan.vibrato_speed = x;
+          if(y)
+            chan.vibrato_depth = y;
+        } else
+          vibrato();
+        break;
+
+      case 0x5: // tone portamento + volume slide
+        if(!first_tick) {
+          tone_portamento();
+          volume_slide(chan.volume, chan.param);
+        }
+        break;
+
+      case 0x6: // vibrato + volume slide
+        if(!first_tick) {
+          vibrato();
+          volume_slide(chan.volume, chan.param);
+        }
+        break;
+
+      case 0x7: // tremolo
+        if(first_tick) {
+          if(x)
+            chan.tremolo_speed = x;
+          if(y)
+            chan.tremolo_depth = y;
+        } else {
+          int delta = (waveform_value(chan.tremolo_wave, chan.tremolo_pos) * chan.tremolo_depth) >> 6;
+          volume_offset = chan.tremolo_pos & 32 ? -delta : delta;
+          chan.tremolo_pos = (chan.tremolo_pos + chan.tremolo_speed) & 63;
+        }
+        break;
+
+      case 0x9: // sample offset
+        if(first_tick) {
+          if(chan.param)
+            chan.sample_offset = chan.param;
+          if(chan.trigger)
+            chan.trigger_offset = chan.sample_offset * 256;
+        }
+        break;
+
+      case 0xa: // volume slide
+        if(!first_tick)
+          volume_slide(chan.volume, chan.param);
+        break;
+
+      case 0xb: // position jump
+        if(first_tick) {
+          jump_order = chan.param;
+          if(jump_row < 0)
+            jump_row = 0;
+        }
+        break;
+
+      case 0xc: // set volume
+        if(first_tick)
+          chan.volume = std::min(chan.param, uint8_t(64));
+        break;
+
+      case 0xd: // pattern break (the row is in decimal)
+        if(first_tick) {
+          if(jump_order < 0)
+            jump_order = order + 1;
+          jump_row = x * 10 + y;
+          if(jump_row >= rows_per_pattern)
+            jump_row = 0;
+        }
+        break;
+
+      case 0xe:
+        switch(x) {
+          case 0x1: // fine portamento up
+            if(first_tick)
+              chan.period = std::max(chan.period - y, int(min_period));
+            break;
+          case 0x2: // fine portamento down
+            if(first_tick)
+              chan.period = std::min(chan.period + y, int(max_period));
+            break;
+          case 0x3: // glissando
+            if(first_tick)
+              chan.glissando = y != 0;
+            break;
+          case 0x4: // vibrato waveform
+            if(first_tick)
+              chan.vibrato_wave = y;
+            break;
+          case 0x6: // pattern loop
+            if(first_tick) {
+              if(!y)
+                chan.loop_row = row;
+              else if(!chan.loop_count) {
+                chan.loop_count = y;
+                loop_jump_row = chan.loop_row;
+              } else if(--chan.loop_count)
+                loop_jump_row = chan.loop_row;
+            }
+            break;
+          case 0x7: // tremolo waveform
+            if(first_tick)
+              chan.tremolo_wave = y;
+            break;
+          case 0x9: // retrigger
+            if(y && tick_count % y == 0 && !(first_tick && chan.trigger)) {
+              chan.trigger = true;
+              chan.trigger_offset = 0;
+            }
+            break;
+          case 0xa: // fine volume slide up
+            if(first_tick)
+              chan.volume = std::min(chan.volume + y, 64);
+            break;
+          case 0xb: // fine volume slide down
+            if(first_tick)
+              chan.volume = std::max(chan.volume - y, 0);
+            break;
+          case 0xc: // note cut
+            if(tick_count == y)
+              chan.volume = 0;
+            break;
+          case 0xd: // note delay
+            if(!first_tick && tick_count == y && chan.delayed_period) {
+              trigger_note(chan, chan.delayed_period, chan.delayed_sample);
+              chan.delayed_period = 0;
+            }
+            break;
+          case 0xe: // pattern delay
+            if(first_tick && !in_pattern_delay && !pattern_delay)
+              pattern_delay = y;
+            break;
+        }
+        break;
+
+      case 0xf: // set speed/tempo
+        if(first_tick && chan.param) {
+          if(chan.param < 32)
+            speed = chan.param;
+          else
+            tempo = chan.param;
+        }
+        break;
+    }
+
+    // final pitch and volume for this tick
+    if(arpeggio_note >= 0)
+      chan.out_period = note_period(arpeggio_note, chan.finetune);
+    else if(chan.glissando && (chan.effect == 0x3 || chan.effect == 0x5)) {
+      int note = find_note(chan.period);
+      chan.out_period = note < 0 ? chan.period : note_period(note, chan.finetune);
+    } else
+      chan.out_period = chan.period ? std::max(chan.period + period_offset, 1) : 0;
+
+    chan.out_volume = std::min(std::max(chan.volume + volume_offset, 0), 64);
+  }
+
+  void TrackerPlayer::next_row() {
+    int new_order = order, new_row = row + 1;
+
+    if(loop_jump_row >= 0)
+      new_row = loop_jump_row;
+    else if(jump_order >= 0) {
+      new_order = jump_order;
+      new_row = jump_row;
+    }
+
+    jump_order = jump_row = loop_jump_row = -1;
+
+    if(new_row >= rows_per_pattern) {
+      new_row = 0;
+      new_order++;
+    }
+
+    if(new_order != order) {
+      if(new_order >= song_length)
+        new_order = restart_order < song_length ? restart_order : 0;
+
+      // returning to a pattern that has been played means the song has looped
+      if(enter_order(new_order)) {
+        loop_count++;
+
+        if(!loop)
+          ended = true;
+      }
+    }
+
+    order = new_order;
+    row = new_row;
+  }
+
+  // marks an order as visited, returns `true` if it already was
+  bool TrackerPlayer::enter_order(int order) {
+    uint32_t bit = 1 << (order % 32);
+    bool visited = visited_orders[order / 32] & bit;
+
+    if(visited)
+      memset(visited_orders, 0, sizeof(visited_orders));
+
+    visited_orders[order / 32] |= bit;
+
+    return visited;
+  }
+
+  // copies the output of each channel of the module to its audio channel
+  void TrackerPlayer::output_channels() {
+    for(int c = 0; c < num_channels; c++) {
+      auto &chan = chans[c];
+      auto &out = out_channels[c];
+
+      if(chan.trigger) {
+        chan.trigger = false;
+
+        if(!chan.sample || samples[chan.sample - 1].length < 2) {
+          out.off();
+          continue;
+        }
+
+        auto &sample = samples[chan.sample - 1];
+        out.set_sample(sample.data, sample.length, SampleFormat::PCM8);
+        out.set_sample_loop(sample.loop_start, sample.loop_end);
+        out.sample_pos = std::min(chan.trigger_offset, sample.length);
+        out.trigger_attack();
+      }
+
+      out.volume = chan.out_volume * channel_gain / 64;
+
+      if(chan.out_period)
+        out.sample_step = (uint64_t(amiga_clock) << 16) / (uint64_t(chan.out_period) * sample_rate);
+    }
+  }
+
+  uint16_t TrackerPlayer::note_period(int note, int finetune) const {
+    return period_table[finetune & 0xf][note];
+  }
+
+  // finds the note closest to a period at finetune 0, -1 if out of range
+  int TrackerPlayer::find_note(uint16_t period) const {
+    if(period < min_period - 7 || period > max_period + 53)
+      return -1;
+
+    int best = 0;
+    for(int n = 1; n < 36; n++) {
+      if(std::abs(base_periods[n] - period) < std::abs(base_periods[best] - period))
+        best = n;
+    }
+
+    return best;
+  }
+
+  // sets up channels for playing samples
+  void TrackerPlayer::init_channels(AudioChannel *out) {
+    for(int c = 0; c < num_channels; c++) {
+      out[c].off();
+      out[c].waveforms = Waveform::SAMPLE;
+      out[c].attack_ms = 0;
+      out[c].decay_ms = 0;
+      out[c].sustain = 0xffff;
+      out[c].release_ms = 0;
+      out[c].filter_enable = false;
+      out[c].sample_data = nullptr;
+      out[c].sample_stream = nullptr;
+    }
+  }
+
+  void TrackerPlayer::end_render() {
+    delete[] render_channels;
+    delete render_queue;
+    render_channels = nullptr;
+    render_queue = nullptr;
+  }
+
+  void TrackerPlayer::unload() {
+    end_render();
+
+    delete[] data_buf;
+    data_buf = nullptr;
+    data = nullptr;
+    data_length = 0;
+    num_channels = 0;
+  }
+}
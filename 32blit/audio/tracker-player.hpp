@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "audio/audio.hpp"
+
+namespace blit {
+  /**
+   * Plays tracker modules (ProTracker-style MOD files, 4-32 channels) using the SAMPLE waveform
+   * of a range of channels. Rows and effects are processed by an audio sequencer, so timing is
+   * sample-accurate and doesn't depend on `update`.
+   */
+  class TrackerPlayer final
+  {
+  public:
+    TrackerPlayer();
+    ~TrackerPlayer();
+
+    bool load(std::string filename);
+
+    bool play(int first_channel = 0);
+    void stop();
+
+    bool get_playing() const;
+
+    void set_loop(bool loop);
+    void set_volume(uint16_t volume);
+
+    uint32_t render(int16_t *buffer, uint32_t count);
+
+    std::string get_title() const;
+    int get_channel_count() const;
+    int get_song_length() const;
+
+    int get_order() const;
+    int get_row() const;
+    uint32_t get_loop_count() const;
+
+  private:
+    struct Sample {
+      const int8_t *data;
+      uint32_t length;
+      uint32_t loop_start, loop_end; // loop_end is 0 if not looping
+      int8_t finetune;
+      uint8_t volume;
+    };
+
+    // state of a channel of the module, updated every tick
+    struct Channel {
+      uint8_t sample;         // current sample (1-based, 0 for none)
+      uint8_t volume;         // 0-64
+      int8_t finetune;
+      uint16_t period;
+      uint16_t target_period; // tone portamento target
+
+      uint8_t effect, param;  // effect of the current row
+
+      uint8_t porta_speed;
+      uint8_t vibrato_speed, vibrato_depth, vibrato_pos, vibrato_wave;
+      uint8_t tremolo_speed, tremolo_depth, tremolo_pos, tremolo_wave;
+      bool glissando;
+      uint8_t sample_offset;
+      uint8_t loop_row, loop_count;
+
+      uint16_t delayed_period; // note waiting for a note delay effect
+      uint8_t delayed_sample;
+
+      // output for this tick
+      bool trigger;
+      uint32_t trigger_offset;
+      uint16_t out_period;
+      uint8_t out_volume;
+    };
+
+    static const int max_channels = 32;
+    static const int max_samples = 31;
+    static const int rows_per_pattern = 64;
+
+    static uint32_t sequencer_callback(void *arg);
+    uint32_t tick();
+
+    void reset();
+    void process_row();
+    void process_effects(Channel &chan, bool first_tick);
+    void trigger_note(Channel &chan, uint16_t period, uint8_t sample);
+    void next_row();
+    bool enter_order(int order);
+    void output_channels();
+
+    uint16_t note_period(int note, int finetune) const;
+    int find_note(uint16_t period) const;
+
+    void init_channels(AudioChannel *out);
+    void end_render();
+    void unload();
+
+    // module data
+    const uint8_t *data = nullptr;
+    uint8_t *data_buf = nullptr; // copy of the file if it isn't in memory
+    uint32_t data_length = 0;
+
+    char title[21] = {0};
+    int num_channels = 0;
+    int num_samples = 0;
+    int song_length = 0;
+    int restart_order = 0;
+    const uint8_t *orders = nullptr;
+    const uint8_t *patterns = nullptr;
+    Sample samples[max_samples];
+
+    // playback
+    AudioChannel *out_channels = nullptr;
+    std::atomic<bool> playing{false};
+    bool loop = true;
+    uint16_t volume = 0xffff;
+    int32_t channel_gain = 0;
+
+    Channel chans[max_channels];
+
+    int speed = 6, tempo = 125;
+    int tick_count = 0;
+    uint32_t tick_remainder = 0; // fraction of a sample carried between ticks
+    int pattern_delay = 0;
+    bool in_pattern_delay = false;
+    int jump_order = -1, jump_row = -1;
+    int loop_jump_row = -1;
+    uint32_t visited_orders[128 / 32];
+
+    std::atomic<int> order{0}, row{0};
+    std::atomic<uint32_t> loop_count{0};
+    bool ended = false;
+
+    // offline rendering
+    AudioChannel *render_channels = nullptr;
+    AudioCommandQueue *render_queue = nullptr;
+    uint32_t render_pos = 0, end_time = 0;
+  };
+}
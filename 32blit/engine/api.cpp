@@ -25,4 +25,5 @@ namespace blit {
   Pen &LED = api.LED;
 
   AudioChannel *&channels = api.channels;
+  AudioCommandQueue *&audio_commands = api.audio_commands;
 }
\ No newline at end of file
@@ -4,7 +4,9 @@
 #include <vector>
 
 #include "engine.hpp"
+#include "engine_stats.hpp"
 #include "file.hpp"
+#include "jobs.hpp"
 #include "../audio/audio.hpp"
 #include "../engine/input.hpp"
 #include "../graphics/jpeg.hpp"
@@ -16,7 +18,14 @@ namespace blit {
 
   using AllocateCallback = uint8_t *(*)(size_t);
 
-  constexpr uint32_t api_version = 0;
+  // bumped when fields are added, new fields only go at the end so that older games still work
+  constexpr uint32_t api_version = 4;
+
+  // games built before this use an older AudioChannel layout, so the firmware won't start them
+  constexpr uint32_t api_min_game_version = 4;
+
+  // marks the api_version after a game's header (see startup_user.cpp), older games don't have it
+  constexpr uint32_t api_game_magic = 0x49504142; // "BAPI"
 
   #pragma pack(push, 4)
   struct API {
@@ -68,6 +77,22 @@ namespace blit {
     // launcher APIs - only intended for use by launchers and only available on device
     bool (*launch)(const char *filename);
     void (*erase_game)(uint32_t offset);
+
+    // audio commands/sequencer (api_version 1)
+    AudioCommandQueue *audio_commands;
+
+    // jobs, only set if there are worker threads (api_version 2)
+    void (*submit_job)(jobs::JobFunc func, void *data);
+    void (*help_jobs)(); // runs a waiting job on the calling thread, or yields if there are none
+    uint32_t (*get_job_worker_count)();
+
+    // frame timing, owned by the firmware/SDL runtime (api_version 3)
+    EngineStats *engine_stats;
+
+    // audio build options the firmware/SDL runtime was built with (api_version 4)
+    uint32_t audio_channel_count;
+    uint32_t audio_sample_rate;
+    uint32_t audio_channel_size; // sizeof(AudioChannel)
   };
   #pragma pack(pop)
 
@@ -1,9 +1,12 @@
 /*! \file engine.cpp
 */
+#include <algorithm>
 #include <cstdarg>
 
 #include "engine.hpp"
 #include "api_private.hpp"
+#include "engine_stats.hpp"
+#include "task.hpp"
 #include "timer.hpp"
 #include "tweening.hpp"
 
@@ -27,6 +30,26 @@ namespace blit {
     return api.now();
   }
 
+  /** \returns Time from the microsecond timer, or 0 if there isn't one */
+  uint32_t now_us() {
+    return api.get_us_timer ? api.get_us_timer() : 0;
+  }
+
+  /**
+   * Get the time between two readings of `now_us`, allowing for the timer wrapping.
+   *
+   * \param from Earlier time, in microseconds.
+   * \param to Later time, in microseconds.
+   *
+   * \returns Microseconds from `from` to `to`
+   */
+  uint32_t us_diff(uint32_t from, uint32_t to) {
+    if(to >= from || !api.get_max_us_timer)
+      return to - from;
+
+    return (api.get_max_us_timer() - from) + to;
+  }
+
   uint32_t random() {
     return api.random();
   }
@@ -60,29 +83,134 @@ namespace blit {
   uint32_t update_rate_ms = 10;
   uint32_t pending_update_time = 0;
 
-  uint32_t render_rate_ms = 20;
-  uint32_t pending_render_time = 0;
+  uint32_t max_catch_up = 10;
+  uint32_t frame_budget_us = 20000;
 
   uint32_t last_tick_time = 0;
+  uint32_t last_tick_us = 0;
+
+  FrameStats frame_stats;
+
+  /**
+   * Set how often `update` is called. The default is every 10ms.
+   *
+   * \param rate_ms Time between updates, in milliseconds.
+   */
+  void set_update_rate(uint32_t rate_ms) {
+    update_rate_ms = rate_ms ? rate_ms : 1;
+  }
+
+  /** \returns Time between updates, in milliseconds */
+  uint32_t get_update_rate() {
+    return update_rate_ms;
+  }
+
+  /**
+   * Limit how many updates a single tick runs to catch up after a slow frame. Any time beyond
+   * that is dropped, so the game slows down instead of falling further behind each frame.
+   * The default is 10.
+   *
+   * \param max_updates Maximum updates per tick, 0 for no limit.
+   */
+  void set_max_catch_up(uint32_t max_updates) {
+    max_catch_up = max_updates;
+  }
+
+  /**
+   * Set the time a frame is expected to take, frames longer than this are counted as overruns
+   * in the `FrameStats`. The default is 20ms.
+   *
+   * \param budget_us Frame time budget, in microseconds.
+   */
+  void set_frame_budget(uint32_t budget_us) {
+    frame_budget_us = budget_us;
+  }
+
+  /**
+   * Get how far the current time is between the last update and the next one, for smoothing
+   * motion in `render` when the update rate is lower than the frame rate.
+   * Draw at `previous + (current - previous) * get_interpolation()`.
+   *
+   * \returns Fraction of an update since the last one, from 0 to 1.
+   */
+  float get_interpolation() {
+    return float(pending_update_time) / update_rate_ms;
+  }
+
+  /** \returns Timing statistics since the last reset */
+  const FrameStats &get_frame_stats() {
+    return frame_stats;
+  }
+
+  /**
+   * Clear the statistics returned by `get_frame_stats`.
+   */
+  void reset_frame_stats() {
+    frame_stats = FrameStats();
+  }
 
   bool tick(uint32_t time) {
+    uint32_t tick_us = now_us();
+
     if (last_tick_time == 0) {
       last_tick_time = time;
+    } else {
+      frame_stats.frame_us = us_diff(last_tick_us, tick_us);
+      frame_stats.max_frame_us = std::max(frame_stats.max_frame_us, frame_stats.frame_us);
+
+      if (frame_stats.frame_us > frame_budget_us)
+        frame_stats.overruns++;
     }
 
+    last_tick_us = tick_us;
+    frame_stats.frames++;
+
     // update timers
-    update_timers(time);
-    update_tweens(time);
+    {
+      PhaseTimer phase_timer(EnginePhase::TIMERS);
+      update_timers(time);
+      update_tweens(time);
+    }
 
     // catch up on updates if any pending
     pending_update_time += (time - last_tick_time);
+
+    uint32_t updates = 0;
+    uint32_t update_start_us = now_us();
     while (pending_update_time >= update_rate_ms) {
+      if (max_catch_up && updates == max_catch_up) {
+        // too far behind, skip the rest and keep the part of an update that is left
+        frame_stats.catch_up_limited++;
+        frame_stats.dropped_updates += pending_update_time / update_rate_ms;
+        pending_update_time %= update_rate_ms;
+        break;
+      }
+
       update(time - pending_update_time); // create fake timestamp that would have been accurate for the update event
       pending_update_time -= update_rate_ms;
+      updates++;
 
       api.buttons.pressed = api.buttons.released = 0;
     }
 
+    if(updates) {
+      add_phase_time(EnginePhase::UPDATE, us_diff(update_start_us, now_us()));
+      add_update_count(updates);
+    }
+
+    frame_stats.updates += updates;
+    frame_stats.update_us = us_diff(tick_us, now_us());
+    frame_stats.max_update_us = std::max(frame_stats.max_update_us, frame_stats.update_us);
+
+    if (frame_stats.update_us > frame_budget_us)
+      frame_stats.update_overruns++;
+
+    // spend some of the rest of the frame on long running tasks
+    {
+      PhaseTimer phase_timer(EnginePhase::TASKS);
+      update_tasks();
+    }
+
     last_tick_time = time;
 
     return true;
@@ -19,6 +19,8 @@ namespace blit {
   void set_screen_palette(const Pen *colours, int num_cols);
 
   uint32_t now();
+  uint32_t now_us();
+  uint32_t us_diff(uint32_t from, uint32_t to);
   uint32_t random();
 
   void debug(std::string message);
@@ -27,6 +29,35 @@ namespace blit {
   bool tick(uint32_t time);
   void fast_tick(uint32_t time);
 
+  /**
+   * Timing of the main loop, collected by `tick`. Times are in microseconds.
+   */
+  struct FrameStats {
+    uint32_t frames = 0;            // calls to tick
+    uint32_t updates = 0;           // calls to update
+
+    uint32_t frame_us = 0;          // time between the last two ticks
+    uint32_t max_frame_us = 0;
+    uint32_t update_us = 0;         // time spent updating timers, tweens and the game in the last tick
+    uint32_t max_update_us = 0;
+
+    uint32_t overruns = 0;          // frames longer than the budget
+    uint32_t update_overruns = 0;   // ticks where updating alone took longer than the budget
+
+    uint32_t catch_up_limited = 0;  // ticks that reached the catch-up limit
+    uint32_t dropped_updates = 0;   // updates skipped because of the limit
+  };
+
+  void set_update_rate(uint32_t rate_ms);
+  uint32_t get_update_rate();
+  void set_max_catch_up(uint32_t max_updates);
+  void set_frame_budget(uint32_t budget_us);
+
+  float get_interpolation();
+
+  const FrameStats &get_frame_stats();
+  void reset_frame_stats();
+
   // hal methods: read_file, reset
 
 }
@@ -0,0 +1,208 @@
+/*! \file engine_stats.cpp
+    \brief Automatic timing of the engine's phases
+*/
+#include <algorithm>
+#include <cstdio>
+
+#include "engine_stats.hpp"
+#include "api_private.hpp"
+#include "../graphics/font.hpp"
+#include "../graphics/surface.hpp"
+
+namespace blit {
+
+  static const char *phase_names[engine_stats_phases] {
+    "timers",
+    "update",
+    "tasks",
+    "render",
+    "flip",
+    "audio",
+    "file"
+  };
+
+  static const Pen phase_colours[engine_stats_phases] {
+    {255, 255,   0},
+    {  0, 200, 255},
+    {  0, 100, 255},
+    {  0, 255,  80},
+    {255, 150,   0},
+    {255,  60, 200},
+    {200, 200, 200}
+  };
+
+  // stats shared by the firmware, only used if it is the same version
+  static EngineStats *stats() {
+    auto stats = api.engine_stats;
+    return stats && stats->version == engine_stats_version && api.get_us_timer ? stats : nullptr;
+  }
+
+  /** \returns The shared stats, or `nullptr` if the firmware/SDL runtime does not provide them */
+  EngineStats *get_engine_stats() {
+    return stats();
+  }
+
+  /**
+   * Get the stats for a completed frame.
+   *
+   * \param frames_ago 0 for the latest frame, up to `engine_stats_frames - 1`.
+   *
+   * \returns The frame's stats, or `nullptr` if there is no such frame
+   */
+  const EngineFrameStats *get_engine_frame_stats(uint32_t frames_ago) {
+    auto s = stats();
+    if(!s || frames_ago >= std::min(s->frame_count, engine_stats_frames))
+      return nullptr;
+
+    return &s->history[(s->frame_count - 1 - frames_ago) % engine_stats_frames];
+  }
+
+  /**
+   * Add time to a phase of the current frame. This is safe to call from any thread or interrupt.
+   *
+   * \param phase Phase to add to.
+   * \param us Time taken, in microseconds.
+   */
+  void add_phase_time(EnginePhase phase, uint32_t us) {
+    if(auto s = stats())
+      s->current_us[int(phase)].fetch_add(us, std::memory_order_relaxed);
+  }
+
+  /**
+   * Add to the number of update calls in the current frame.
+   *
+   * \param updates Number of updates.
+   */
+  void add_update_count(uint32_t updates) {
+    if(auto s = stats())
+      s->current_updates.fetch_add(updates, std::memory_order_relaxed);
+  }
+
+  /**
+   * Store the current frame in the history and start a new one. Called by the firmware/SDL
+   * runtime once per displayed frame.
+   */
+  void end_stats_frame() {
+    auto s = stats();
+    if(!s)
+      return;
+
+    uint32_t end_us = now_us();
+
+    auto &frame = s->history[s->frame_count % engine_stats_frames];
+    frame.frame_us = s->frame_count ? us_diff(s->frame_start_us, end_us) : 0;
+    frame.updates = s->current_updates.exchange(0, std::memory_order_relaxed);
+
+    for(uint32_t i = 0; i < engine_stats_phases; i++)
+      frame.phase_us[i] = s->current_us[i].exchange(0, std::memory_order_relaxed);
+
+    s->frame_start_us = end_us;
+    s->frame_count++;
+  }
+
+  /**
+   * Show or hide the frame timing overlay. It is drawn by the firmware/SDL runtime after `render`.
+   *
+   * \param show true to show the overlay.
+   */
+  void set_stats_overlay(bool show) {
+    if(auto s = stats())
+      s->show_overlay = show;
+  }
+
+  /** \returns true if the frame timing overlay is shown */
+  bool get_stats_overlay() {
+    auto s = stats();
+    return s && s->show_overlay;
+  }
+
+  /** \returns Short name of the phase */
+  const char *get_phase_name(EnginePhase phase) {
+    return phase < EnginePhase::COUNT ? phase_names[int(phase)] : "";
+  }
+
+  /**
+   * Draw a graph of the recent frames, stacked by phase, with the average time of each phase.
+   * Paletted surfaces are skipped as there are no colours to draw with.
+   *
+   * \param dest Surface to draw to, usually `screen`.
+   */
+  void render_stats_overlay(Surface &dest) {
+    auto s = stats();
+    if(!s || dest.format == PixelFormat::P)
+      return;
+
+    const int line_h = minimal_font.char_h;
+    const int graph_w = engine_stats_frames, graph_h = line_h * (engine_stats_phases + 1);
+    const uint32_t graph_scale_us = 40000; // full height, the line is the default 20ms frame budget
+
+    Rect panel(0, dest.bounds.h - graph_h - 4, graph_w + 74, graph_h + 4);
+    Point graph_pos(panel.x + 2, panel.y + 2);
+
+    auto old_pen = dest.pen;
+    auto old_alpha = dest.alpha;
+    dest.alpha = 255;
+
+    dest.pen = Pen(0, 0, 0, 180);
+    dest.rectangle(panel);
+
+    uint32_t frames = std::min(s->frame_count, engine_stats_frames);
+    uint32_t total_us[engine_stats_phases] = {};
+    uint32_t total_frame_us = 0;
+
+    // oldest frame on the left
+    for(uint32_t i = 0; i < frames; i++) {
+      auto &frame = s->history[(s->frame_count - frames + i) % engine_stats_frames];
+      int x = graph_pos.x + graph_w - frames + i;
+      int y = graph_pos.y + graph_h;
+
+      for(uint32_t phase = 0; phase < engine_stats_phases; phase++) {
+        total_us[phase] += frame.phase_us[phase];
+
+        int h = std::min(int(uint64_t(frame.phase_us[phase]) * graph_h / graph_scale_us), y - graph_pos.y);
+        if(h > 0) {
+          y -= h;
+          dest.pen = phase_colours[phase];
+          dest.v_span(Point(x, y), h);
+        }
+      }
+
+      total_frame_us += frame.frame_us;
+    }
+
+    dest.pen = Pen(255, 0, 0);
+    dest.h_span(Point(graph_pos.x, graph_pos.y + graph_h / 2), graph_w);
+
+    // averages, in ms
+    char buf[32];
+    Point text_pos(graph_pos.x + graph_w + 4, graph_pos.y);
+
+    snprintf(buf, sizeof(buf), "frame %.1f", frames ? total_frame_us / 1000.0f / frames : 0.0f);
+    dest.pen = Pen(255, 255, 255);
+    dest.text(buf, minimal_font, text_pos + Point(6, 0));
+
+    for(uint32_t phase = 0; phase < engine_stats_phases; phase++) {
+      text_pos.y += line_h;
+
+      dest.pen = phase_colours[phase];
+      dest.rectangle(Rect(text_pos + Point(0, 2), Size(4, 4)));
+
+      snprintf(buf, sizeof(buf), "%s %.2f", phase_names[phase], frames ? total_us[phase] / 1000.0f / frames : 0.0f);
+      dest.pen = Pen(255, 255, 255);
+      dest.text(buf, minimal_font, text_pos + Point(6, 0));
+    }
+
+    dest.pen = old_pen;
+    dest.alpha = old_alpha;
+  }
+
+  PhaseTimer::PhaseTimer(EnginePhase phase) : phase(phase), start_us(0), active(stats() != nullptr) {
+    if(active)
+      start_us = now_us();
+  }
+
+  PhaseTimer::~PhaseTimer() {
+    if(active)
+      add_phase_time(phase, us_diff(start_us, now_us()));
+  }
+}
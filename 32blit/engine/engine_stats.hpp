@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace blit {
+
+  struct Surface;
+
+  /**
+   * Parts of a frame that the engine and firmware time automatically.
+   */
+  enum class EnginePhase : uint8_t {
+    TIMERS,  // timers and tweens
+    UPDATE,  // all of the update calls in a tick
+    TASKS,   // cooperative tasks
+    RENDER,
+    FLIP,    // copying the framebuffer to the display (device) or texture (SDL)
+    AUDIO,   // audio callbacks, these run on another thread (SDL) or in an interrupt (device)
+    FILE_IO, // waiting for File to open, read, write or close
+    COUNT
+  };
+
+  constexpr uint32_t engine_stats_version = 1;
+  constexpr uint32_t engine_stats_phases = uint32_t(EnginePhase::COUNT);
+  constexpr uint32_t engine_stats_frames = 64;
+
+  #pragma pack(push, 4)
+  struct EngineFrameStats {
+    uint32_t frame_us; // time since the previous frame
+    uint32_t updates;  // number of update calls
+    uint32_t phase_us[engine_stats_phases];
+  };
+
+  /**
+   * Timing of the last `engine_stats_frames` frames, shared through the API table so that the
+   * firmware and the game both add to it. Check `version` before using the other fields.
+   */
+  struct EngineStats {
+    uint32_t version = engine_stats_version;
+    uint32_t num_phases = engine_stats_phases;
+    uint32_t num_frames = engine_stats_frames;
+
+    uint32_t frame_count = 0; // frames so far, the latest is history[(frame_count - 1) % num_frames]
+    uint32_t show_overlay = 0;
+
+    EngineFrameStats history[engine_stats_frames] = {};
+
+    // totals for the frame in progress, added to from any thread or interrupt
+    std::atomic<uint32_t> current_us[engine_stats_phases] = {};
+    std::atomic<uint32_t> current_updates{0};
+
+    uint32_t frame_start_us = 0;
+  };
+  #pragma pack(pop)
+
+  static_assert(sizeof(std::atomic<uint32_t>) == 4 && std::atomic<uint32_t>::is_always_lock_free,
+                "EngineStats is shared between binaries and interrupts");
+
+  EngineStats *get_engine_stats();
+  const EngineFrameStats *get_engine_frame_stats(uint32_t frames_ago = 0);
+
+  void add_phase_time(EnginePhase phase, uint32_t us);
+  void add_update_count(uint32_t updates);
+  void end_stats_frame();
+
+  void set_stats_overlay(bool show);
+  bool get_stats_overlay();
+  void render_stats_overlay(Surface &dest);
+
+  const char *get_phase_name(EnginePhase phase);
+
+  /**
+   * Adds the time until it is destroyed to a phase of the current frame.
+   */
+  class PhaseTimer final {
+  public:
+    explicit PhaseTimer(EnginePhase phase);
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+  private:
+    EnginePhase phase;
+    uint32_t start_us;
+    bool active;
+  };
+}
@@ -4,6 +4,7 @@
 
 #include "file.hpp"
 #include "api_private.hpp"
+#include "engine_stats.hpp"
 
 namespace blit {
   struct BufferFile {
@@ -148,6 +149,7 @@ namespace blit {
       return true;
     }
 
+    PhaseTimer phase_timer(EnginePhase::FILE_IO);
     fh = api.open_file(file, mode);
     return fh != nullptr;
   }
@@ -169,6 +171,7 @@ namespace blit {
       return len;
     }
 
+    PhaseTimer phase_timer(EnginePhase::FILE_IO);
     return api.read_file(fh, offset, length, buffer);
   }
 
@@ -182,6 +185,7 @@ namespace blit {
    * \return Number of bytes written successfully or -1 if an error occurred.
    */
   int32_t File::write(uint32_t offset, uint32_t length, const char *buffer) {
+    PhaseTimer phase_timer(EnginePhase::FILE_IO);
     return api.write_file(fh, offset, length, buffer);
   }
 
@@ -194,6 +198,7 @@ namespace blit {
     if(!fh)
       return;
 
+    PhaseTimer phase_timer(EnginePhase::FILE_IO);
     api.close_file(fh);
     fh = nullptr;
   }
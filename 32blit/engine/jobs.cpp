@@ -0,0 +1,113 @@
+/*! \file jobs.cpp
+    \brief Running work on multiple threads where available
+*/
+#include <algorithm>
+
+#include "jobs.hpp"
+#include "api_private.hpp"
+
+namespace blit {
+  namespace jobs {
+    struct Job {
+      std::function<void()> func;
+      std::atomic<uint32_t> *pending;
+    };
+
+    static void run_job(void *data) {
+      auto job = static_cast<Job *>(data);
+      job->func();
+
+      auto pending = job->pending;
+      delete job;
+
+      // last, as the group may be destroyed as soon as this reaches 0
+      pending->fetch_sub(1, std::memory_order_release);
+    }
+
+    // the device only has one core, so jobs always run immediately there
+    static bool has_workers() {
+#ifdef TARGET_32BLIT_HW
+      return false;
+#else
+      return api.submit_job != nullptr;
+#endif
+    }
+
+    /**
+     * @return Number of threads that can run jobs at the same time, including the calling thread
+     */
+    uint32_t get_worker_count() {
+      return has_workers() ? api.get_job_worker_count() + 1 : 1;
+    }
+
+    Group::~Group() {
+      wait();
+    }
+
+    /**
+     * Add a job to the group.
+     *
+     * @param func Function to run
+     */
+    void Group::run(std::function<void()> func) {
+      if(!has_workers()) {
+        func();
+        return;
+      }
+
+      pending.fetch_add(1, std::memory_order_relaxed);
+      api.submit_job(run_job, new Job{std::move(func), &pending});
+    }
+
+    /**
+     * Wait for all of the group's jobs to finish. The calling thread runs other jobs while
+     * waiting.
+     */
+    void Group::wait() {
+      while(pending.load(std::memory_order_acquire))
+        api.help_jobs();
+    }
+
+    /**
+     * Split a range into parts and call a function for each of them, in parallel if possible.
+     * Returns when all parts are done.
+     *
+     * @param begin Start of the range
+     * @param end End of the range (exclusive)
+     * @param func Function to call for each part, with the start and end of the part
+     * @param grain Smallest number of items to put in a part
+     */
+    void parallel_for(uint32_t begin, uint32_t end, const std::function<void(uint32_t begin, uint32_t end)> &func, uint32_t grain) {
+      if(end <= begin)
+        return;
+
+      uint32_t count = end - begin;
+      grain = std::max(grain, uint32_t(1));
+
+      // a few parts per thread, so faster threads can take more of them
+      uint32_t parts = std::min(get_worker_count() * 4, (count + grain - 1) / grain);
+
+      if(parts <= 1) {
+        func(begin, end);
+        return;
+      }
+
+      Group group;
+      uint32_t part_begin = begin;
+
+      for(uint32_t i = 0; i < parts; i++) {
+        uint32_t part_end = begin + uint64_t(count) * (i + 1) / parts;
+
+        // the last part runs on this thread
+        if(i == parts - 1)
+          func(part_begin, part_end);
+        else
+          group.run([&func, part_begin, part_end]() {func(part_begin, part_end);});
+
+        part_begin = part_end;
+      }
+
+      group.wait();
+    }
+  }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+namespace blit {
+  namespace jobs {
+    // a job and the data it was given, run by a worker
+    using JobFunc = void (*)(void *data);
+
+    uint32_t get_worker_count();
+
+    /**
+     * A set of jobs that can be waited for together. Jobs added with `run` may run on other
+     * threads, or immediately on the calling thread if there are no workers (on the device).
+     * Jobs can add more jobs to a new group and wait for them.
+     */
+    class Group final {
+    public:
+      Group() = default;
+      ~Group();
+
+      Group(const Group &) = delete;
+      Group &operator=(const Group &) = delete;
+
+      void run(std::function<void()> func);
+      void wait();
+
+    private:
+      std::atomic<uint32_t> pending{0};
+    };
+
+    void parallel_for(uint32_t begin, uint32_t end, const std::function<void(uint32_t begin, uint32_t end)> &func, uint32_t grain = 1);
+  }
+}
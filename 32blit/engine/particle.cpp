@@ -1,11 +1,209 @@
 /*! \file particle.cpp
     \brief Particle system
 */
+#include <algorithm>
+#include <cmath>
+
 #include "particle.hpp"
 #include "engine.hpp"
 
 namespace blit {
 
+  /**
+   * Create a new particle emitter.
+   *
+   * \param capacity Maximum number of live particles.
+   * \param lifetime_ms Particle lifetime in milliseconds.
+   */
+  ParticleEmitter::ParticleEmitter(uint32_t capacity, uint32_t lifetime_ms) : lifetime_ms(lifetime_ms), capacity(capacity) {
+    // one block for all of the arrays
+    data = new float[capacity * 5];
+
+    pos_x = data;
+    pos_y = pos_x + capacity;
+    vel_x = pos_y + capacity;
+    vel_y = vel_x + capacity;
+    age = vel_y + capacity;
+  }
+
+  ParticleEmitter::~ParticleEmitter() {
+    delete[] data;
+  }
+
+  /**
+   * Move and age the particles by the time since the last update, then generate new ones.
+   *
+   * \param time_ms Current time, in milliseconds.
+   */
+  void ParticleEmitter::update(uint32_t time_ms) {
+    if(!started) {
+      started = true;
+      last_time_ms = time_ms;
+    }
+
+    uint32_t elapsed_ms = time_ms - last_time_ms;
+    last_time_ms = time_ms;
+
+    float td = elapsed_ms / 1000.0f;
+    float fx = force.x * td, fy = force.y * td;
+    float damping = std::max(1.0f - drag * td, 0.0f);
+    float age_step = lifetime_ms ? float(elapsed_ms) / lifetime_ms : 1.0f;
+
+    // no dependencies between particles, so this can be vectorised
+    float *__restrict px = pos_x, *__restrict py = pos_y;
+    float *__restrict vx = vel_x, *__restrict vy = vel_y;
+    float *__restrict a = age;
+
+    for(uint32_t i = 0; i < count; i++) {
+      vx[i] = (vx[i] + fx) * damping;
+      vy[i] = (vy[i] + fy) * damping;
+      px[i] += vx[i] * td;
+      py[i] += vy[i] * td;
+      a[i] += age_step;
+    }
+
+    // remove expired particles by moving the last one into their place
+    for(uint32_t i = 0; i < count;) {
+      if(a[i] < 1.0f) {
+        i++;
+        continue;
+      }
+
+      count--;
+      px[i] = px[count];
+      py[i] = py[count];
+      vx[i] = vx[count];
+      vy[i] = vy[count];
+      a[i] = a[count];
+    }
+
+    pending += rate * td;
+
+    if(pending >= 1.0f) {
+      uint32_t new_count = uint32_t(pending);
+      pending -= new_count;
+      burst(new_count);
+    }
+  }
+
+  /**
+   * Draw all of the particles.
+   *
+   * \param dest Surface to draw to.
+   * \param offset Position of the emitter's origin on the surface.
+   * \param style Shape, colours and size or sprites to draw particles with.
+   */
+  void ParticleEmitter::render(Surface &dest, const Point &offset, const ParticleStyle &style) const {
+    Pen old_pen = dest.pen;
+
+    // index into a table spread over the lifetime
+    auto by_age = [](float age, int count) {
+      return std::min(std::max(int(age * count), 0), count - 1);
+    };
+
+    int colour = -1;
+
+    for(uint32_t i = 0; i < count; i++) {
+      int x = int(floorf(pos_x[i])) + offset.x;
+      int y = int(floorf(pos_y[i])) + offset.y;
+
+      if(style.colour_count) {
+        int c = by_age(age[i], style.colour_count);
+        if(c != colour) {
+          colour = c;
+          dest.pen = style.colours[c];
+        }
+      }
+
+      switch(style.shape) {
+        case ParticleShape::PIXEL:
+          // skip the Point construction and call in Surface::pixel
+          if(x >= dest.clip.x && y >= dest.clip.y && x < dest.clip.x + dest.clip.w && y < dest.clip.y + dest.clip.h)
+            dest.pbf(&dest.pen, &dest, dest.offset(x, y), 1);
+          break;
+
+        case ParticleShape::RECT: {
+          float t = std::min(std::max(age[i], 0.0f), 1.0f);
+          int size = style.size_start + int((style.size_end - style.size_start) * t);
+          dest.rectangle(Rect(x - size / 2, y - size / 2, size, size));
+          break;
+        }
+
+        case ParticleShape::SPRITE:
+          if(style.sprite_count) {
+            auto &sprite = style.sprites[by_age(age[i], style.sprite_count)];
+            dest.sprite(sprite, Point(x, y), Point(sprite.w * 4, sprite.h * 4));
+          }
+          break;
+      }
+    }
+
+    dest.pen = old_pen;
+  }
+
+  /**
+   * Add a particle, if there is space for it.
+   *
+   * \param pos Initial position.
+   * \param vel Initial velocity, in pixels per second.
+   * \param age Initial age, from 0 to 1. Starting particles older makes them expire sooner.
+   *
+   * \return true if the particle was added.
+   */
+  bool ParticleEmitter::emit(const Vec2 &pos, const Vec2 &vel, float age) {
+    if(count == capacity)
+      return false;
+
+    pos_x[count] = pos.x;
+    pos_y[count] = pos.y;
+    vel_x[count] = vel.x;
+    vel_y[count] = vel.y;
+    this->age[count] = age;
+    count++;
+
+    return true;
+  }
+
+  /**
+   * Add a number of particles using `generate`.
+   *
+   * \param count Number of particles to add.
+   *
+   * \return Number of particles added, which may be less if the emitter is full.
+   */
+  uint32_t ParticleEmitter::burst(uint32_t count) {
+    if(!generate)
+      return 0;
+
+    count = std::min(count, capacity - this->count);
+
+    for(uint32_t i = 0; i < count; i++) {
+      Vec2 pos, vel;
+      generate(pos, vel);
+      emit(pos, vel);
+    }
+
+    return count;
+  }
+
+  /**
+   * Remove all particles.
+   */
+  void ParticleEmitter::clear() {
+    count = 0;
+    pending = 0.0f;
+  }
+
+  /** \returns Number of live particles */
+  uint32_t ParticleEmitter::get_count() const {
+    return count;
+  }
+
+  /** \returns Maximum number of particles */
+  uint32_t ParticleEmitter::get_capacity() const {
+    return capacity;
+  }
+
   /**
    * Create a new particle generator.
    *
@@ -28,7 +226,11 @@ namespace blit {
    * \param time_ms Particle system age, in milliseconds.
    */
   void ParticleGenerator::update(uint32_t time_ms) {
-    static uint32_t last_time_ms = time_ms;
+    if (!started) {
+      started = true;
+      last_time_ms = time_ms;
+    }
+
     uint32_t elapsed_ms = time_ms - last_time_ms;
 
     // delete expired particles
@@ -58,4 +260,4 @@ namespace blit {
 
     last_time_ms = time_ms;
   }
-}
\ No newline at end of file
+}
@@ -4,8 +4,82 @@
 #include <functional>
 #include <cstdint>
 #include "../types/vec2.hpp"
+#include "../types/rect.hpp"
+#include "../graphics/surface.hpp"
 
 namespace blit {
+  enum class ParticleShape {
+    PIXEL,  // single pixel
+    RECT,   // square, sized by age
+    SPRITE  // sprite from the destination's sprite sheet, chosen by age
+  };
+
+  /**
+   * How `ParticleEmitter::render` draws particles. Colours and sprites are spread evenly over
+   * each particle's lifetime.
+   */
+  struct ParticleStyle {
+    ParticleShape shape = ParticleShape::PIXEL;
+
+    const Pen *colours = nullptr; // colours from birth to death, uses the surface's pen if not set
+    int colour_count = 0;
+
+    int size_start = 1, size_end = 1; // size of RECT particles at birth and death
+
+    const Rect *sprites = nullptr; // SPRITE frames, in sprite sheet units
+    int sprite_count = 0;
+  };
+
+  /**
+   * A fixed size pool of particles that share a lifetime and a force. Nothing is allocated after
+   * construction, each particle is a few floats in separate position, velocity and age arrays.
+   *
+   * Particles are created at `rate` per second using `generate`, or by calling `emit` directly.
+   * The emitter keeps its own clock, starting with the first call to `update`.
+   */
+  class ParticleEmitter final {
+  public:
+    ParticleEmitter(uint32_t capacity, uint32_t lifetime_ms);
+    ~ParticleEmitter();
+
+    ParticleEmitter(const ParticleEmitter &) = delete;
+    ParticleEmitter &operator=(const ParticleEmitter &) = delete;
+
+    void update(uint32_t time_ms);
+    void render(Surface &dest, const Point &offset, const ParticleStyle &style) const;
+
+    bool emit(const Vec2 &pos, const Vec2 &vel, float age = 0.0f);
+    uint32_t burst(uint32_t count);
+    void clear();
+
+    uint32_t get_count() const;
+    uint32_t get_capacity() const;
+
+    uint32_t lifetime_ms;
+    float rate = 0.0f;  // particles generated per second
+    Vec2 force;         // acceleration applied to every particle
+    float drag = 0.0f;  // fraction of velocity lost per second
+
+    // sets the initial position and velocity of a new particle
+    std::function<void(Vec2 &pos, Vec2 &vel)> generate;
+
+    // particle state, from 0 to `get_count() - 1`. age goes from 0 to 1 over the lifetime.
+    // the order changes as particles expire.
+    float *pos_x, *pos_y;
+    float *vel_x, *vel_y;
+    float *age;
+
+  private:
+    uint32_t capacity;
+    uint32_t count = 0;
+
+    float *data;
+
+    bool started = false;
+    uint32_t last_time_ms = 0;
+    float pending = 0.0f; // fraction of a particle left to generate
+  };
+
   struct Particle {
     blit::Vec2 pos;
     blit::Vec2 vel;
@@ -16,6 +90,10 @@ namespace blit {
     Particle(blit::Vec2 pos, blit::Vec2 vel) : pos(pos), vel(vel) {};
   };
 
+  /**
+   * Original particle system, allocating each particle separately. New code should use
+   * `ParticleEmitter` instead.
+   */
   struct ParticleGenerator {
     uint32_t count;
     uint32_t lifetime_ms;
@@ -31,5 +109,9 @@ namespace blit {
     ~ParticleGenerator();
 
     void update(uint32_t time_ms);
+
+  private:
+    bool started = false;
+    uint32_t last_time_ms = 0;
   };
-}
\ No newline at end of file
+}
@@ -3,6 +3,7 @@
 #include "profiler.hpp"
 #include "engine/api_private.hpp"
 #include "engine/engine.hpp"
+#include "engine/trace.hpp"
 #include "graphics/color.hpp"
 #include "graphics/font.hpp"
 
@@ -11,6 +12,8 @@ namespace blit
 
 void ProfilerProbe::start()
 {
+	// probes also appear in the trace, if one is being recorded
+	trace_recorder.begin(m_pszName);
 	m_uStartUs = api.get_us_timer();
 }
 
@@ -18,6 +21,8 @@ uint32_t ProfilerProbe::store_elapsed_us(bool bRestart)
 {
 	if(m_uStartUs)
 	{
+		trace_recorder.end(m_pszName);
+
 		uint32_t uCurrentUs = api.get_us_timer();
 		if(uCurrentUs >= m_uStartUs)
 			m_metrics.uElapsedUs = uCurrentUs - m_uStartUs;
@@ -30,7 +35,7 @@ uint32_t ProfilerProbe::store_elapsed_us(bool bRestart)
 		{
 			if(m_uRunningAverageSpanIndex == 0)
 			{
-				m_pRunningAverage->add((float)m_metrics.uElapsedUs);
+				m_pRunningAverage->add(m_metrics.uElapsedUs);
 				m_metrics.uAvgElapsedUs = m_pRunningAverage->average();
 				m_uRunningAverageSpanIndex = m_uRunningAverageSpan-1;
 			}
@@ -42,7 +47,10 @@ uint32_t ProfilerProbe::store_elapsed_us(bool bRestart)
 	}
 
 	if(bRestart)
-	m_uStartUs = api.get_us_timer();
+	{
+		trace_recorder.begin(m_pszName);
+		m_uStartUs = api.get_us_timer();
+	}
 
 	return m_metrics.uElapsedUs;
 }
@@ -264,7 +272,7 @@ void Profiler::display_probe_overlay(uint8_t uPage)
 				{
 					screen.pen = Pen(0, 255, 0, m_uAlpha);
 
-					const RunningAverage<float> *pRunningAverage = pProbe->get_running_average();
+					const RunningAverage<uint32_t> *pRunningAverage = pProbe->get_running_average();
 					if(pRunningAverage)
 					{
 						const std::size_t uDataPoints = pRunningAverage->count();
@@ -67,7 +67,7 @@ public:
 	{
 		if(uRunningAverageSize)
 		{
-			m_pRunningAverage = new RunningAverage<float>(uRunningAverageSize);
+			m_pRunningAverage = new RunningAverage<uint32_t>(uRunningAverageSize);
 			if(uRunningAverageSpan == 0)
 				m_uRunningAverageSpan = 1;
 			else
@@ -81,7 +81,8 @@ public:
 
 	void clear()
 	{
-    	m_pRunningAverage->reset();
+		if(m_pRunningAverage)
+			m_pRunningAverage->reset();
 		m_metrics.clear();
 		m_uStartUs = 0;
 	}
@@ -98,7 +99,7 @@ public:
 		return m_pszName;
 	}
 
-	const RunningAverage<float> *get_running_average()
+	const RunningAverage<uint32_t> *get_running_average()
 	{
 		return m_pRunningAverage;
 	}
@@ -122,7 +123,7 @@ private:
 	const char 						*m_pszName;
 	uint32_t							m_uStartUs;
 	Metrics								m_metrics;
-	RunningAverage<float> *m_pRunningAverage;
+	RunningAverage<uint32_t> *m_pRunningAverage;
 	uint32_t							m_uRunningAverageSpan;
 	uint32_t							m_uRunningAverageSpanIndex;
 	uint32_t							m_uGraphTimeUs;
@@ -1,74 +1,176 @@
 #pragma once
 
-#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
 
 namespace blit
 {
-template<typename T>
+// Average, minimum and maximum of the last uSize values added, all in constant time.
+//
+// The values are kept in a ring buffer that is allocated once, or is part of the object if the
+// size is given as the second template argument (RunningAverage<float, 8>).
+//
+// The sum is kept exactly for integer types. For floating point types it is recalculated
+// each time the buffer wraps around, so rounding errors can't build up.
+//
+// Minimum and maximum use monotonic queues of buffer positions, the values in the minimum
+// queue only increase and the values in the maximum queue only decrease.
+template<typename T, std::size_t N = 0>
 class RunningAverage
 {
 public:
-	typedef std::vector<T> Data;
-	RunningAverage(std::size_t uSize) : m_uSize(uSize), m_uIndex(0), m_average(0), m_bFull(false) {};
+	typedef typename std::conditional<std::is_floating_point<T>::value, double, int64_t>::type Sum;
 
+	explicit RunningAverage(std::size_t uSize = N) : m_uSize(N ? N : std::max(uSize, std::size_t(1)))
+	{
+		if(N)
+		{
+			m_pData    = m_fixedData;
+			m_pMinQueue = m_fixedMinQueue;
+			m_pMaxQueue = m_fixedMaxQueue;
+			m_pScratch = m_fixedScratch;
+		}
+		else
+		{
+			m_pData    = new T[m_uSize];
+			m_pMinQueue = new std::size_t[m_uSize];
+			m_pMaxQueue = new std::size_t[m_uSize];
+			m_pScratch = new T[m_uSize];
+		}
+
+		reset();
+	};
+
+	~RunningAverage()
+	{
+		if(!N)
+		{
+			delete[] m_pData;
+			delete[] m_pMinQueue;
+			delete[] m_pMaxQueue;
+			delete[] m_pScratch;
+		}
+	}
+
+	RunningAverage(const RunningAverage &) = delete;
+	RunningAverage &operator=(const RunningAverage &) = delete;
+
+	// 0 is the oldest value
 	const T &operator[] (std::size_t i) const
 	{
-		std::size_t actualIndex = 0;
+		std::size_t actualIndex = i;
 
 		if(m_bFull)
-			actualIndex = ((m_uIndex + i) % m_uSize);
-		else
-			actualIndex = i;
+		{
+			actualIndex += m_uIndex;
+			if(actualIndex >= m_uSize)
+				actualIndex -= m_uSize;
+		}
 
-		return m_data[actualIndex];
+		return m_pData[actualIndex];
 	}
 
 	void add(T value)
 	{
 		if(m_bFull)
 		{
-			T removed = m_data[m_uIndex];
-			m_data[m_uIndex] = value;
-			m_average = m_average - (removed / m_uSize) + (value / m_uSize);
-		}
-		else
-		{
-			m_data.push_back(value);
-			m_average = 0;
-			for(std::size_t iD = 0; iD <= m_uIndex; iD++)
-				m_average += m_data[iD]/(m_uIndex+1);
+			// the oldest value is about to be replaced, it can only be at the front of the queues
+			if(m_uMinCount && m_pMinQueue[m_uMinHead] == m_uIndex)
+				pop_front(m_uMinHead, m_uMinCount);
+
+			if(m_uMaxCount && m_pMaxQueue[m_uMaxHead] == m_uIndex)
+				pop_front(m_uMaxHead, m_uMaxCount);
+
+			m_sum -= m_pData[m_uIndex];
 		}
 
-		m_uIndex = (m_uIndex+1)%m_uSize;
-		if(!m_bFull)
-			m_bFull = m_data.size() == m_uSize;
+		m_pData[m_uIndex] = value;
+		m_sum += value;
 
+		// drop anything that can no longer be the minimum or maximum
+		while(m_uMinCount && !(m_pData[back(m_pMinQueue, m_uMinHead, m_uMinCount)] < value))
+			m_uMinCount--;
+		push_back(m_pMinQueue, m_uMinHead, m_uMinCount, m_uIndex);
+
+		while(m_uMaxCount && !(value < m_pData[back(m_pMaxQueue, m_uMaxHead, m_uMaxCount)]))
+			m_uMaxCount--;
+		push_back(m_pMaxQueue, m_uMaxHead, m_uMaxCount, m_uIndex);
+
+		if(++m_uIndex == m_uSize)
+		{
+			m_uIndex = 0;
+			m_bFull = true;
+
+			if(std::is_floating_point<T>::value)
+			{
+				m_sum = 0;
+				for(std::size_t i = 0; i < m_uSize; i++)
+					m_sum += m_pData[i];
+			}
+		}
 	}
 
 	void add_all(T value)
 	{
 		reset();
-	  while(m_uIndex < m_uSize)
-			m_data[m_uIndex++] = value;
+		for(std::size_t i = 0; i < m_uSize; i++)
+			add(value);
 	}
 
 	void reset()
 	{
 		m_uIndex 	= 0;
-		m_average = 0;
-    	m_bFull   = false;
-		m_data.clear();
+		m_sum     = 0;
+		m_bFull   = false;
+		m_uMinHead = m_uMinCount = 0;
+		m_uMaxHead = m_uMaxCount = 0;
+	}
 
+	T average() const
+	{
+		std::size_t uCount = count();
+		return uCount ? T(m_sum / Sum(uCount)) : T(0);
 	}
 
-	T average()
+	Sum sum() const
 	{
-		return m_average;
+		return m_sum;
+	}
+
+	// smallest value in the buffer
+	T min() const
+	{
+		return m_uMinCount ? m_pData[m_pMinQueue[m_uMinHead]] : T(0);
+	}
+
+	// largest value in the buffer
+	T max() const
+	{
+		return m_uMaxCount ? m_pData[m_pMaxQueue[m_uMaxHead]] : T(0);
+	}
+
+	// value that fPercent percent of the values are below, this is O(n) so best used
+	// occasionally, for example when displaying results
+	T percentile(float fPercent) const
+	{
+		std::size_t uCount = count();
+		if(!uCount)
+			return T(0);
+
+		for(std::size_t i = 0; i < uCount; i++)
+			m_pScratch[i] = m_pData[i];
+
+		std::size_t uNth = std::min(std::size_t(fPercent / 100.0f * (uCount - 1) + 0.5f), uCount - 1);
+		std::nth_element(m_pScratch, m_pScratch + uNth, m_pScratch + uCount);
+
+		return m_pScratch[uNth];
 	}
 
-	std::size_t data_count()
+	std::size_t data_count() const
 	{
-		return m_data.size();
+		return count();
 	}
 
 	std::size_t count() const
@@ -90,11 +192,44 @@ public:
 
 
 private:
-	Data 				m_data;
+	std::size_t back(const std::size_t *pQueue, std::size_t uHead, std::size_t uCount) const
+	{
+		std::size_t i = uHead + uCount - 1;
+		return pQueue[i >= m_uSize ? i - m_uSize : i];
+	}
+
+	void push_back(std::size_t *pQueue, std::size_t uHead, std::size_t &uCount, std::size_t uValue)
+	{
+		std::size_t i = uHead + uCount++;
+		pQueue[i >= m_uSize ? i - m_uSize : i] = uValue;
+	}
+
+	void pop_front(std::size_t &uHead, std::size_t &uCount)
+	{
+		if(++uHead == m_uSize)
+			uHead = 0;
+		uCount--;
+	}
+
+	static const std::size_t c_uFixedSize = N ? N : 1;
+
 	std::size_t m_uSize;
 	std::size_t m_uIndex;
-  T         	m_average;
-  bool				m_bFull;
+	Sum         m_sum;
+	bool				m_bFull;
+
+	T           *m_pData;
+	std::size_t *m_pMinQueue;
+	std::size_t *m_pMaxQueue;
+	T           *m_pScratch;
+
+	std::size_t m_uMinHead, m_uMinCount;
+	std::size_t m_uMaxHead, m_uMaxCount;
+
+	// storage when the size is fixed
+	T           m_fixedData[c_uFixedSize];
+	std::size_t m_fixedMinQueue[c_uFixedSize];
+	std::size_t m_fixedMaxQueue[c_uFixedSize];
+	T           m_fixedScratch[c_uFixedSize];
 };
 } // namespace
-
@@ -0,0 +1,196 @@
+/*! \file task.cpp
+    \brief Cooperative tasks, for spreading long jobs over many frames
+*/
+#include <algorithm>
+#include <deque>
+
+#include "task.hpp"
+#include "api_private.hpp"
+
+namespace blit {
+
+  struct Task {
+    uint32_t id;
+    TaskStep step;
+    TaskCallback on_complete;
+    bool cancelled = false;
+  };
+
+  static const int num_priorities = int(TaskPriority::HIGH) + 1;
+
+  // a queue for each priority, tasks go to the back after each step so equal priority
+  // tasks take turns. Never freed, as global objects may still add or cancel tasks at exit
+  static std::deque<Task *> *task_queues = new std::deque<Task *>[num_priorities];
+
+  static uint32_t next_task_id = 1;
+  static Task *current_task = nullptr;
+
+  static uint32_t task_budget_us = 2000;
+
+  static Task *find_task(uint32_t id) {
+    if(current_task && current_task->id == id)
+      return current_task;
+
+    for(int p = 0; p < num_priorities; p++) {
+      for(auto task : task_queues[p]) {
+        if(task->id == id)
+          return task;
+      }
+    }
+
+    return nullptr;
+  }
+
+  /**
+   * Add a task, which is run a step at a time from `tick` until it is finished.
+   *
+   * Steps should be short compared to the budget, a step is never interrupted so one that
+   * takes too long will still delay the frame. Higher priority tasks always run first, tasks
+   * with the same priority take turns.
+   *
+   * @param step Function to run each step, returns true when the task is finished
+   * @param priority Priority of the task
+   * @param on_complete Optional function to call when the task has finished
+   *
+   * @return Id of the new task
+   */
+  uint32_t add_task(TaskStep step, TaskPriority priority, TaskCallback on_complete) {
+    auto task = new Task{next_task_id++, std::move(step), std::move(on_complete)};
+
+    // zero is never a valid id
+    if(!next_task_id)
+      next_task_id = 1;
+
+    task_queues[int(priority)].push_back(task);
+
+    return task->id;
+  }
+
+  /**
+   * Remove a task before it finishes. The completion callback is not called.
+   * A task may cancel itself from its step.
+   *
+   * @param id Id of the task
+   *
+   * @return true if the task was found
+   */
+  bool cancel_task(uint32_t id) {
+    if(current_task && current_task->id == id) {
+      // removed once the step returns
+      current_task->cancelled = true;
+      return true;
+    }
+
+    for(int p = 0; p < num_priorities; p++) {
+      auto &queue = task_queues[p];
+      auto it = std::find_if(queue.begin(), queue.end(), [id](Task *task) {return task->id == id;});
+
+      if(it != queue.end()) {
+        delete *it;
+        queue.erase(it);
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * @param id Id of the task
+   *
+   * @return true if the task has not finished or been cancelled
+   */
+  bool is_task_running(uint32_t id) {
+    auto task = find_task(id);
+    return task && !task->cancelled;
+  }
+
+  /**
+   * @return Number of unfinished tasks
+   */
+  uint32_t get_task_count() {
+    uint32_t count = 0;
+
+    for(int p = 0; p < num_priorities; p++)
+      count += task_queues[p].size();
+
+    if(current_task && !current_task->cancelled)
+      count++;
+
+    return count;
+  }
+
+  /**
+   * Set how long tasks can run for each frame. The default is 2ms.
+   *
+   * @param budget_us Time per frame, in microseconds
+   */
+  void set_task_budget(uint32_t budget_us) {
+    task_budget_us = budget_us;
+  }
+
+  /**
+   * @return Time tasks can run for each frame, in microseconds
+   */
+  uint32_t get_task_budget() {
+    return task_budget_us;
+  }
+
+  /**
+   * Run task steps until the budget is used or there are no tasks left. At least one step is
+   * run if there are any tasks. This is called by `tick`, but can also be called directly,
+   * for example to load faster while a loading screen is shown.
+   *
+   * @param budget_us Time to run tasks for, in microseconds
+   *
+   * @return Number of steps run
+   */
+  uint32_t run_tasks(uint32_t budget_us) {
+    // tasks can't run from inside another task
+    if(current_task)
+      return 0;
+
+    uint32_t start_us = now_us();
+    uint32_t steps = 0;
+
+    do {
+      // highest priority first
+      int p = num_priorities - 1;
+      while(p >= 0 && task_queues[p].empty())
+        p--;
+
+      if(p < 0)
+        break;
+
+      auto task = task_queues[p].front();
+      task_queues[p].pop_front();
+
+      current_task = task;
+      bool finished = task->step();
+      current_task = nullptr;
+
+      steps++;
+
+      if(task->cancelled) {
+        delete task;
+      } else if(finished) {
+        if(task->on_complete)
+          task->on_complete();
+
+        delete task;
+      } else
+        task_queues[p].push_back(task);
+
+    // without a timer there's no way to tell how long the steps took, so only run one
+    } while(api.get_us_timer && us_diff(start_us, now_us()) < budget_us);
+
+    return steps;
+  }
+
+  /**
+   * Run tasks for this frame's budget.
+   */
+  void update_tasks() {
+    run_tasks(task_budget_us);
+  }
+}
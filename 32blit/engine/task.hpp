@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+namespace blit {
+
+  enum class TaskPriority {
+    LOW,
+    NORMAL,
+    HIGH
+  };
+
+  // does a small part of the work, returns true when the task is finished
+  using TaskStep = std::function<bool()>;
+  using TaskCallback = std::function<void()>;
+
+  uint32_t add_task(TaskStep step, TaskPriority priority = TaskPriority::NORMAL, TaskCallback on_complete = nullptr);
+  bool cancel_task(uint32_t id);
+  bool is_task_running(uint32_t id);
+  uint32_t get_task_count();
+
+  void set_task_budget(uint32_t budget_us);
+  uint32_t get_task_budget();
+
+  uint32_t run_tasks(uint32_t budget_us);
+
+  extern void update_tasks();
+}
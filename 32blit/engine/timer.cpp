@@ -4,10 +4,113 @@
 #include "timer.hpp"
 
 namespace blit {
-  std::vector<Timer *> timers;
+  // running timers, as a binary min-heap ordered by deadline. Each timer knows its
+  // position so it can be removed when it is stopped or destroyed.
+  // Never freed, as global timers may be destroyed after it at exit
+  static std::vector<Timer *> &timer_heap = *new std::vector<Timer *>;
+
+  // compares times that may have wrapped around
+  static bool is_before(uint32_t a, uint32_t b) {
+    return int32_t(a - b) < 0;
+  }
+
+  static void heap_set(uint32_t index, Timer *timer) {
+    timer_heap[index] = timer;
+    timer->heap_index = index;
+  }
+
+  static void sift_up(uint32_t index) {
+    Timer *timer = timer_heap[index];
+
+    while(index > 0) {
+      uint32_t parent = (index - 1) / 2;
+      if(!is_before(timer->deadline, timer_heap[parent]->deadline))
+        break;
+
+      heap_set(index, timer_heap[parent]);
+      index = parent;
+    }
+
+    heap_set(index, timer);
+  }
+
+  static void sift_down(uint32_t index) {
+    Timer *timer = timer_heap[index];
+    uint32_t size = timer_heap.size();
+
+    while(true) {
+      uint32_t child = index * 2 + 1;
+      if(child >= size)
+        break;
+
+      if(child + 1 < size && is_before(timer_heap[child + 1]->deadline, timer_heap[child]->deadline))
+        child++;
+
+      if(!is_before(timer_heap[child]->deadline, timer->deadline))
+        break;
+
+      heap_set(index, timer_heap[child]);
+      index = child;
+    }
+
+    heap_set(index, timer);
+  }
+
+  // adds a timer or moves it after its deadline changed
+  static void schedule(Timer *timer) {
+    if(timer->heap_index < 0) {
+      timer_heap.push_back(timer);
+      timer->heap_index = timer_heap.size() - 1;
+    }
+
+    sift_up(timer->heap_index);
+    sift_down(timer->heap_index);
+  }
+
+  static void unschedule(Timer *timer) {
+    if(timer->heap_index < 0)
+      return;
+
+    uint32_t index = timer->heap_index;
+    Timer *last = timer_heap.back();
+    timer_heap.pop_back();
+    timer->heap_index = -1;
+
+    // move the last timer into the gap
+    if(last != timer) {
+      timer_heap[index] = last;
+      last->heap_index = index;
+      sift_up(index);
+      sift_down(last->heap_index);
+    }
+  }
 
   Timer::Timer() = default;
 
+  /**
+   * Copies the settings of a timer. The copy is stopped.
+   */
+  Timer::Timer(const Timer &other) : callback(other.callback), duration(other.duration), loops(other.loops) {
+  }
+
+  Timer::~Timer() {
+    unschedule(this);
+  }
+
+  /**
+   * Copies the settings of a timer, stopping this one.
+   */
+  Timer &Timer::operator=(const Timer &other) {
+    if(this != &other) {
+      stop();
+      callback = other.callback;
+      duration = other.duration;
+      loops = other.loops;
+    }
+
+    return *this;
+  }
+
   /**
    * Initialize the timer.
    *
@@ -19,7 +122,6 @@ namespace blit {
     this->callback = callback;
     this->duration = duration;
     this->loops = loops;
-    timers.push_back(this);
   }
 
   /**
@@ -27,40 +129,62 @@ namespace blit {
    */
   void Timer::start() {
     this->started = blit::now();
+    this->deadline = this->started + (this->duration ? this->duration : 1);
     this->state = RUNNING;
+    schedule(this);
   }
 
   /**
-   * Stop the running timer.
+   * Stop the running timer. This also cancels it, a stopped timer can be destroyed safely.
    */
   void Timer::stop() {
     this->state = STOPPED;
+    unschedule(this);
   }
 
   /**
-   * Update all running timers, triggering any that have elapsed.
+   * Update all running timers, triggering any that have elapsed. Only the timers that
+   * are due are visited.
+   *
+   * Repeating timers are re-armed from when they were due rather than when they were
+   * updated, so they don't drift. If more than one period was missed the callback is
+   * only called once and the missed periods are skipped.
    *
    * @param time Time in milliseconds.
    */
   void update_timers(uint32_t time) {
-    for (auto t: timers) {
-      if (t->state == Timer::RUNNING){
-        if (time > (t->started + t->duration)) { // timer triggered
-          t->callback(*t);
-
-          if(t->loops == -1){
-            t->started = time; // reset the start time correcting for any error
-          }
-          else
-          {
-            t->loops--;
-            t->started = time;
-            if (t->loops == 0){
-              t->state = Timer::FINISHED;
-            }
-          }
+    while(!timer_heap.empty() && !is_before(time, timer_heap[0]->deadline)) {
+      Timer *t = timer_heap[0];
+
+      // reschedule before the callback, which may stop, restart or destroy the timer
+      if(t->loops != -1)
+        t->loops--;
+
+      if(t->loops == 0) {
+        t->state = Timer::FINISHED;
+        unschedule(t);
+      } else {
+        if(t->duration == 0)
+          t->started = time;
+        else {
+          uint32_t missed = (time - t->deadline) / t->duration;
+          t->started = t->deadline + missed * t->duration;
         }
+
+        // a zero duration timer is due once per update
+        t->deadline = t->started + (t->duration ? t->duration : 1);
+        schedule(t);
       }
+
+      if(t->callback)
+        t->callback(*t);
     }
   }
+
+  /**
+   * @return Number of running timers.
+   */
+  uint32_t get_scheduled_timer_count() {
+    return timer_heap.size();
+  }
 }
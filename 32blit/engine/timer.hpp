@@ -13,7 +13,8 @@ namespace blit {
     TimerCallback callback = nullptr;
    
     uint32_t duration = 0;                  // how many milliseconds between callbacks
-    uint32_t started = 0;                   // system time when timer started in milliseconds
+    uint32_t started = 0;                   // system time when the current period started in milliseconds
+    uint32_t deadline = 0;                  // system time of the next callback, valid while running
     int16_t loops = -1;                     // number of times to repeat timer (-1 == forever)
     enum state {                            // state of the timer 
       STOPPED, 
@@ -33,15 +34,20 @@ namespace blit {
     bool is_finished()  { return this->state == FINISHED; }
 
     Timer();
-  };
+    Timer(const Timer &other);
+    ~Timer();
+
+    Timer &operator=(const Timer &other);
 
-  extern std::vector<Timer *> timers;
+    int32_t heap_index = -1;                // position in the scheduler, -1 if not scheduled
+  };
 
   struct timer_event_t {
 
   };
 
   extern void update_timers(uint32_t time);
+  extern uint32_t get_scheduled_timer_count();
 
   //extern std::vector<timer *> timers;  
 
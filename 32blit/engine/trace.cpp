@@ -0,0 +1,186 @@
+/*! \file trace.cpp
+    \brief Event timeline recording
+*/
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include "trace.hpp"
+#include "api_private.hpp"
+#include "file.hpp"
+
+namespace blit {
+
+  TraceRecorder trace_recorder;
+
+  TraceRecorder::~TraceRecorder() {
+    delete[] events;
+  }
+
+  /**
+   * Start recording, clearing any previous events.
+   *
+   * \param capacity Number of events to keep.
+   */
+  void TraceRecorder::start(uint32_t capacity) {
+    if(capacity != this->capacity) {
+      delete[] events;
+      events = new TraceEvent[capacity];
+      this->capacity = capacity;
+    }
+
+    clear();
+
+    if(api.enable_us_timer)
+      api.enable_us_timer();
+
+    time_us = 0;
+    last_us = now_us();
+
+    recording = capacity != 0;
+  }
+
+  /**
+   * Stop recording. The events are kept until the next `start` or `clear`.
+   */
+  void TraceRecorder::stop() {
+    recording = false;
+  }
+
+  /**
+   * Remove all events.
+   */
+  void TraceRecorder::clear() {
+    head = count = overwritten = 0;
+  }
+
+  /** \returns Number of events in the buffer */
+  uint32_t TraceRecorder::get_count() const {
+    return count;
+  }
+
+  /** \returns Number of events lost because the buffer was full */
+  uint32_t TraceRecorder::get_overwritten() const {
+    return overwritten;
+  }
+
+  /**
+   * \param index Index of the event, 0 is the oldest.
+   *
+   * \returns The event
+   */
+  const TraceEvent &TraceRecorder::get_event(uint32_t index) const {
+    uint32_t i = head + capacity - count + index;
+    return events[i >= capacity ? i - capacity : i];
+  }
+
+  void TraceRecorder::record(TraceEvent::Type type, const char *name, int32_t value) {
+    uint32_t us = now_us();
+    time_us += us_diff(last_us, us);
+    last_us = us;
+
+    auto &event = events[head];
+    event.time_us = time_us;
+    event.name = name;
+    event.value = value;
+    event.type = type;
+
+    if(++head == capacity)
+      head = 0;
+
+    if(count < capacity)
+      count++;
+    else
+      overwritten++;
+  }
+
+  /**
+   * Write the events in the Chrome trace JSON format. The text is passed to `write` in
+   * pieces, each one null terminated.
+   *
+   * \param write Function to call with each piece of the text.
+   */
+  void TraceRecorder::write_json(std::function<void(const char *text, uint32_t length)> write) const {
+    const int buf_size = 1024;
+    char buf[buf_size];
+    int len = 0;
+
+    // appends to the buffer, passing it on first if it's too full
+    auto append = [&](const char *text, int text_len) {
+      if(len + text_len >= buf_size) {
+        write(buf, len);
+        len = 0;
+      }
+
+      memcpy(buf + len, text, text_len);
+      len += text_len;
+      buf[len] = 0;
+    };
+
+    append("{\"traceEvents\":[\n", 17);
+
+    static const char phases[] = {'B', 'E', 'C', 'i'};
+
+    for(uint32_t i = 0; i < count; i++) {
+      auto &event = get_event(i);
+
+      // copy the name, dropping anything that would need escaping
+      char name[64];
+      int name_len = 0;
+      for(auto c = event.name; *c && name_len < 63; c++) {
+        if(*c != '"' && *c != '\\' && *c >= ' ')
+          name[name_len++] = *c;
+      }
+      name[name_len] = 0;
+
+      char line[160];
+      int line_len = snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRIu64 ",\"pid\":0,\"tid\":0",
+                              i ? ",\n" : "", name, phases[event.type], event.time_us);
+
+      if(event.type == TraceEvent::COUNTER)
+        line_len += snprintf(line + line_len, sizeof(line) - line_len, ",\"args\":{\"value\":%" PRIi32 "}}", event.value);
+      else if(event.type == TraceEvent::INSTANT)
+        line_len += snprintf(line + line_len, sizeof(line) - line_len, ",\"s\":\"g\"}");
+      else
+        line_len += snprintf(line + line_len, sizeof(line) - line_len, "}");
+
+      append(line, line_len);
+    }
+
+    append("\n]}\n", 4);
+    write(buf, len);
+  }
+
+  /**
+   * Save the events to a file in the Chrome trace JSON format.
+   *
+   * \param filename Name of the file.
+   *
+   * \returns true if the file was written
+   */
+  bool TraceRecorder::save_json(const std::string &filename) const {
+    File file;
+    if(!file.open(filename, OpenMode::write))
+      return false;
+
+    uint32_t offset = 0;
+    bool ok = true;
+
+    write_json([&](const char *text, uint32_t length) {
+      ok = ok && file.write(offset, length, text) == int32_t(length);
+      offset += length;
+    });
+
+    return ok;
+  }
+
+  /**
+   * Send the events in the Chrome trace JSON format to the debug output, which is the
+   * USB serial port on the device.
+   */
+  void TraceRecorder::debug_json() const {
+    write_json([](const char *text, uint32_t) {
+      api.debug(text);
+    });
+  }
+}
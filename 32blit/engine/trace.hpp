@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace blit {
+
+  struct TraceEvent {
+    enum Type : uint8_t {
+      BEGIN,
+      END,
+      COUNTER,
+      INSTANT
+    };
+
+    uint64_t time_us;
+    const char *name;
+    int32_t value;
+    Type type;
+  };
+
+  /**
+   * Records a timeline of events into a fixed size ring buffer, overwriting the oldest events
+   * when full. The timeline can be saved in the Chrome trace format, which can be opened in
+   * chrome://tracing or Perfetto.
+   *
+   * Event names are not copied, so they must stay valid until the trace is written (string
+   * literals are best). Events should only be recorded from the engine's thread.
+   */
+  class TraceRecorder final {
+  public:
+    TraceRecorder() = default;
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder &) = delete;
+    TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+    void start(uint32_t capacity = 8192);
+    void stop();
+    void clear();
+
+    bool is_recording() const {
+      return recording;
+    }
+
+    void begin(const char *name) {
+      if(recording)
+        record(TraceEvent::BEGIN, name, 0);
+    }
+
+    void end(const char *name) {
+      if(recording)
+        record(TraceEvent::END, name, 0);
+    }
+
+    void counter(const char *name, int32_t value) {
+      if(recording)
+        record(TraceEvent::COUNTER, name, value);
+    }
+
+    void instant(const char *name) {
+      if(recording)
+        record(TraceEvent::INSTANT, name, 0);
+    }
+
+    uint32_t get_count() const;
+    uint32_t get_overwritten() const;
+    const TraceEvent &get_event(uint32_t index) const;
+
+    void write_json(std::function<void(const char *text, uint32_t length)> write) const;
+    bool save_json(const std::string &filename) const;
+    void debug_json() const;
+
+  private:
+    void record(TraceEvent::Type type, const char *name, int32_t value);
+
+    TraceEvent *events = nullptr;
+    uint32_t capacity = 0;
+    uint32_t head = 0;       // where the next event goes
+    uint32_t count = 0;
+    uint32_t overwritten = 0;
+
+    bool recording = false;
+
+    // the us timer is extended to 64 bits, as it wraps every few seconds on the device
+    uint64_t time_us = 0;
+    uint32_t last_us = 0;
+  };
+
+  extern TraceRecorder trace_recorder;
+
+  /**
+   * Records a begin event when created and an end event when destroyed.
+   */
+  class ScopedTrace final {
+  public:
+    explicit ScopedTrace(const char *name) : name(name) {
+      trace_recorder.begin(name);
+    }
+
+    ~ScopedTrace() {
+      trace_recorder.end(name);
+    }
+
+    ScopedTrace(const ScopedTrace &) = delete;
+    ScopedTrace &operator=(const ScopedTrace &) = delete;
+
+  private:
+    const char *name;
+  };
+}
+
+#define BLIT_TRACE_CONCAT2(a, b) a##b
+#define BLIT_TRACE_CONCAT(a, b) BLIT_TRACE_CONCAT2(a, b)
+
+// traces the rest of the enclosing scope
+#define BLIT_TRACE_SCOPE(name) blit::ScopedTrace BLIT_TRACE_CONCAT(blit_trace_, __LINE__)(name)
+#define BLIT_TRACE_COUNTER(name, value) blit::trace_recorder.counter(name, value)
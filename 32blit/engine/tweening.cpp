@@ -8,7 +8,8 @@
 #include "../math/constants.hpp"
 
 namespace blit {
-  std::vector<Tween *> tweens;
+  // never freed, as global tweens may be destroyed after it at exit
+  std::vector<Tween *> &tweens = *new std::vector<Tween *>;
 
   /**
    * Initialize the tween.
@@ -26,7 +27,13 @@ namespace blit {
     this->to = to;
     this->duration = duration;
     this->loop_count = 0;
-    tweens.push_back(this);
+
+    if(std::find(tweens.begin(), tweens.end(), this) == tweens.end())
+      tweens.push_back(this);
+  }
+
+  Tween::~Tween() {
+    tweens.erase(std::remove(tweens.begin(), tweens.end(), this), tweens.end());
   }
 
   /**
@@ -72,11 +79,13 @@ namespace blit {
   }
 
   /**
-   * Update tweens.
+   * Update tweens, including `tween_group`.
    *
    * @param time in milliseconds.
    */
   void update_tweens(uint32_t time) {
+    tween_group.update(time);
+
     for (auto tween : tweens) {
       if (tween->state == Tween::RUNNING){
         uint32_t elapsed = blit::now() - tween->started;
@@ -98,4 +107,483 @@ namespace blit {
       }
     }
   }
+
+  /**
+   * Evaluate an easing curve exactly. `TweenGroup` uses tables of these.
+   *
+   * @param easing Curve to evaluate.
+   * @param t Position from 0 to 1.
+   * @return Eased position, 0 at the start and 1 at the end (the back/elastic curves overshoot).
+   */
+  float ease(Easing easing, float t) {
+    const float back = 1.70158f, back_in_out = back * 1.525f;
+
+    switch(easing) {
+      case Easing::LINEAR:
+        return t;
+
+      case Easing::IN_QUAD:
+        return t * t;
+      case Easing::OUT_QUAD:
+        return t * (2.0f - t);
+      case Easing::IN_OUT_QUAD:
+        return t < 0.5f ? 2.0f * t * t : 1.0f - 2.0f * (1.0f - t) * (1.0f - t);
+
+      case Easing::IN_CUBIC:
+        return t * t * t;
+      case Easing::OUT_CUBIC:
+        return 1.0f - (1.0f - t) * (1.0f - t) * (1.0f - t);
+      case Easing::IN_OUT_CUBIC:
+        return t < 0.5f ? 4.0f * t * t * t : 1.0f - 4.0f * (1.0f - t) * (1.0f - t) * (1.0f - t);
+
+      case Easing::IN_SINE:
+        return 1.0f - cosf(t * pi / 2.0f);
+      case Easing::OUT_SINE:
+        return sinf(t * pi / 2.0f);
+      case Easing::IN_OUT_SINE:
+        return (1.0f - cosf(t * pi)) / 2.0f;
+
+      case Easing::IN_EXPO:
+        return t <= 0.0f ? 0.0f : powf(2.0f, 10.0f * t - 10.0f);
+      case Easing::OUT_EXPO:
+        return t >= 1.0f ? 1.0f : 1.0f - powf(2.0f, -10.0f * t);
+      case Easing::IN_OUT_EXPO:
+        if(t <= 0.0f || t >= 1.0f)
+          return t <= 0.0f ? 0.0f : 1.0f;
+        return t < 0.5f ? powf(2.0f, 20.0f * t - 10.0f) / 2.0f : 1.0f - powf(2.0f, -20.0f * t + 10.0f) / 2.0f;
+
+      case Easing::IN_BACK:
+        return t * t * ((back + 1.0f) * t - back);
+      case Easing::OUT_BACK:
+        t = 1.0f - t;
+        return 1.0f - t * t * ((back + 1.0f) * t - back);
+      case Easing::IN_OUT_BACK:
+        if(t < 0.5f)
+          return 2.0f * t * t * ((back_in_out + 1.0f) * 2.0f * t - back_in_out);
+        t = 2.0f * t - 2.0f;
+        return (t * t * ((back_in_out + 1.0f) * t + back_in_out) + 2.0f) / 2.0f;
+
+      case Easing::OUT_ELASTIC:
+        if(t <= 0.0f || t >= 1.0f)
+          return t <= 0.0f ? 0.0f : 1.0f;
+        return powf(2.0f, -10.0f * t) * sinf((t * 10.0f - 0.75f) * (2.0f * pi / 3.0f)) + 1.0f;
+
+      case Easing::OUT_BOUNCE:
+        if(t < 1.0f / 2.75f)
+          return 7.5625f * t * t;
+        if(t < 2.0f / 2.75f) {
+          t -= 1.5f / 2.75f;
+          return 7.5625f * t * t + 0.75f;
+        }
+        if(t < 2.5f / 2.75f) {
+          t -= 2.25f / 2.75f;
+          return 7.5625f * t * t + 0.9375f;
+        }
+        t -= 2.625f / 2.75f;
+        return 7.5625f * t * t + 0.984375f;
+
+      default:
+        return t;
+    }
+  }
+
+  // easing curves sampled at 256 points (+1 for interpolating the last), built when first used
+  static const int easing_table_size = 256;
+  static float *easing_tables[int(Easing::COUNT)] = {nullptr};
+
+  static const float *get_easing_table(Easing easing) {
+    auto &table = easing_tables[int(easing)];
+
+    if(!table) {
+      table = new float[easing_table_size + 1];
+      for(int i = 0; i <= easing_table_size; i++)
+        table[i] = ease(easing, float(i) / easing_table_size);
+    }
+
+    return table;
+  }
+
+  // compares times that may have wrapped around
+  static bool is_before(uint32_t a, uint32_t b) {
+    return int32_t(a - b) < 0;
+  }
+
+  TweenGroup tween_group;
+
+  TweenGroup::TweenGroup() = default;
+
+  /**
+   * Add a tween. It starts immediately, or after `delay`.
+   *
+   * @param target Float to write the value to each update, can be `nullptr` (see `get_value`).
+   * @param from Value at the start.
+   * @param to Value at the end.
+   * @param duration Duration of the tween in milliseconds.
+   * @param easing Easing curve.
+   * @param delay Time to wait before starting in milliseconds. The target is not written until then.
+   * @return Handle to the tween, invalid if there are too many tweens.
+   */
+  TweenHandle TweenGroup::add(float *target, float from, float to, uint32_t duration, Easing easing, uint32_t delay) {
+    auto handle = create(target, from, to, duration, easing, blit::now() + delay, 0);
+
+    if(handle.id && !delay) {
+      auto index = find(handle);
+      activate(index);
+
+      if(target)
+        *target = from;
+    }
+
+    return handle;
+  }
+
+  /**
+   * Add a tween that starts when another finishes, after any others already following it.
+   * The start time is exactly when the previous tween ended, so sequences don't drift.
+   *
+   * @param previous Tween to follow. If it is not valid the new tween starts immediately.
+   * @param target Float to write the value to each update, can be `nullptr`.
+   * @param from Value at the start.
+   * @param to Value at the end.
+   * @param duration Duration of the tween in milliseconds.
+   * @param easing Easing curve.
+   * @param delay Time to wait after the previous tween has finished, in milliseconds.
+   * @return Handle to the tween, invalid if there are too many tweens.
+   */
+  TweenHandle TweenGroup::then(TweenHandle previous, float *target, float from, float to, uint32_t duration, Easing easing, uint32_t delay) {
+    auto index = find(previous);
+    if(index == no_slot)
+      return add(target, from, to, duration, easing, delay);
+
+    // append to the end of the sequence
+    uint32_t prev_slot = slot[index];
+    while(find(TweenHandle{slots[prev_slot].next}) != no_slot)
+      prev_slot = slots[prev_slot].next & 0xFFFF;
+
+    auto handle = create(target, from, to, duration, easing, delay, flag_waiting);
+    if(handle.id)
+      slots[prev_slot].next = handle.id;
+
+    return handle;
+  }
+
+  /**
+   * Set how many times a tween plays.
+   *
+   * @param handle Tween to change.
+   * @param loops Number of times to play, -1 = forever.
+   * @param yoyo Play every other loop backwards.
+   */
+  void TweenGroup::set_loops(TweenHandle handle, int32_t loops, bool yoyo) {
+    auto index = find(handle);
+    if(index == no_slot)
+      return;
+
+    this->loops[index] = loops < 0 ? -1 : std::max(loops, int32_t(1));
+
+    if(yoyo)
+      flags[index] |= flag_yoyo;
+    else
+      flags[index] &= ~flag_yoyo;
+  }
+
+  /**
+   * Set a function to call when a tween finishes. It is not called if the tween is removed.
+   * The callback can add and remove tweens.
+   *
+   * @param handle Tween to change.
+   * @param callback Function to call.
+   * @param arg Passed to the function.
+   */
+  void TweenGroup::set_callback(TweenHandle handle, TweenCallback callback, void *arg) {
+    auto index = find(handle);
+    if(index == no_slot)
+      return;
+
+    auto &s = slots[slot[index]];
+    s.callback = callback;
+    s.callback_arg = arg;
+  }
+
+  /**
+   * Remove a tween, and any tweens waiting for it to finish. The target keeps its current value.
+   *
+   * @param handle Tween to remove.
+   * @return `true` if the tween was removed, `false` if it had already finished or been removed.
+   */
+  bool TweenGroup::remove(TweenHandle handle) {
+    auto index = find(handle);
+    if(index == no_slot)
+      return false;
+
+    while(index != no_slot) {
+      TweenHandle next{slots[slot[index]].next};
+      destroy(index);
+      index = find(next);
+    }
+
+    return true;
+  }
+
+  /**
+   * Remove all tweens.
+   */
+  void TweenGroup::clear() {
+    while(!slot.empty())
+      destroy(slot.size() - 1);
+  }
+
+  /**
+   * @param handle Tween to check.
+   * @return `true` if the tween is playing or waiting to start.
+   */
+  bool TweenGroup::is_active(TweenHandle handle) const {
+    return find(handle) != no_slot;
+  }
+
+  /**
+   * @param handle Tween to get the value of.
+   * @return The value from the last update, or 0 if the tween is not active.
+   */
+  float TweenGroup::get_value(TweenHandle handle) const {
+    auto index = find(handle);
+    return index == no_slot ? 0.0f : values[index];
+  }
+
+  /**
+   * @return Number of tweens playing or waiting to start.
+   */
+  uint32_t TweenGroup::get_count() const {
+    return slot.size();
+  }
+
+  /**
+   * Update all of the tweens in the group, writing the new values to their targets.
+   *
+   * @param time Time in milliseconds, from `now`.
+   */
+  void TweenGroup::update(uint32_t time) {
+    // start any tweens that were delayed
+    for(uint32_t i = active_count; i < slot.size(); i++) {
+      if(!(flags[i] & flag_waiting) && !is_before(time, start[i]))
+        activate(i);
+    }
+
+    finished.clear();
+    evaluate(0, active_count, time);
+
+    for(auto id : finished) {
+      auto index = find(TweenHandle{id});
+      if(index != no_slot && index < active_count)
+        finish(index, time);
+    }
+
+    // start the tweens that followed the finished ones, if they are already due
+    uint32_t first_started = active_count;
+
+    for(uint32_t i = active_count; i < slot.size(); i++) {
+      if(!(flags[i] & flag_waiting) && !is_before(time, start[i]))
+        activate(i);
+    }
+
+    // anything that finishes immediately is handled next update
+    evaluate(first_started, active_count, time);
+    finished.clear();
+  }
+
+  // returns the array index of a tween, or no_slot if the handle isn't valid
+  uint32_t TweenGroup::find(TweenHandle handle) const {
+    uint32_t s = handle.id & 0xFFFF;
+
+    if(!handle.id || s >= slots.size() || slots[s].generation != handle.id >> 16 || slots[s].index >= slot.size() || slot[slots[s].index] != s)
+      return no_slot;
+
+    return slots[s].index;
+  }
+
+  // adds a tween that hasn't started yet
+  TweenHandle TweenGroup::create(float *target, float from, float to, uint32_t duration, Easing easing, uint32_t start, uint8_t flags) {
+    uint32_t s;
+
+    if(free_slot != no_slot) {
+      s = free_slot;
+      free_slot = slots[s].index;
+    } else {
+      if(slots.size() >= 0xFFFF)
+        return TweenHandle();
+
+      s = slots.size();
+      slots.emplace_back();
+    }
+
+    if(easing >= Easing::COUNT)
+      easing = Easing::LINEAR;
+
+    // build the table now rather than in update
+    if(easing != Easing::LINEAR)
+      get_easing_table(easing);
+
+    duration = std::max(duration, uint32_t(1));
+
+    slots[s].index = slot.size();
+    slots[s].next = 0;
+    slots[s].callback = nullptr;
+    slots[s].callback_arg = nullptr;
+
+    targets.push_back(target);
+    this->from.push_back(from);
+    delta.push_back(to - from);
+    values.push_back(from);
+    inv_duration.push_back(1.0f / duration);
+    this->start.push_back(start);
+    this->duration.push_back(duration);
+    loops.push_back(1);
+    this->easing.push_back(easing);
+    this->flags.push_back(flags);
+    slot.push_back(s);
+
+    return TweenHandle{uint32_t(slots[s].generation) << 16 | s};
+  }
+
+  // removes a tween from the arrays and frees its handle
+  void TweenGroup::destroy(uint32_t index) {
+    // keep the running tweens together
+    if(index < active_count) {
+      swap(index, active_count - 1);
+      index = --active_count;
+    }
+
+    uint32_t last = slot.size() - 1;
+    swap(index, last);
+
+    uint32_t s = slot[last];
+    auto &freed = slots[s];
+    freed.generation = freed.generation == 0xFFFF ? 1 : freed.generation + 1;
+    freed.index = free_slot;
+    freed.next = 0;
+    freed.callback = nullptr;
+    free_slot = s;
+
+    targets.pop_back();
+    from.pop_back();
+    delta.pop_back();
+    values.pop_back();
+    inv_duration.pop_back();
+    start.pop_back();
+    duration.pop_back();
+    loops.pop_back();
+    easing.pop_back();
+    flags.pop_back();
+    slot.pop_back();
+  }
+
+  void TweenGroup::swap(uint32_t a, uint32_t b) {
+    if(a == b)
+      return;
+
+    std::swap(targets[a], targets[b]);
+    std::swap(from[a], from[b]);
+    std::swap(delta[a], delta[b]);
+    std::swap(values[a], values[b]);
+    std::swap(inv_duration[a], inv_duration[b]);
+    std::swap(start[a], start[b]);
+    std::swap(duration[a], duration[b]);
+    std::swap(loops[a], loops[b]);
+    std::swap(easing[a], easing[b]);
+    std::swap(flags[a], flags[b]);
+    std::swap(slot[a], slot[b]);
+
+    slots[slot[a]].index = a;
+    slots[slot[b]].index = b;
+  }
+
+  // moves a waiting tween to the running ones
+  void TweenGroup::activate(uint32_t index) {
+    swap(index, active_count);
+    active_count++;
+  }
+
+  // calculates the values of a range of running tweens, and notes any that have finished
+  void TweenGroup::evaluate(uint32_t begin, uint32_t end, uint32_t time) {
+    if(progress.size() < end)
+      progress.resize(slot.capacity());
+
+    // position in each tween, this part vectorises
+    for(uint32_t i = begin; i < end; i++) {
+      float t = int32_t(time - start[i]) * inv_duration[i];
+      progress[i] = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+    }
+
+    for(uint32_t i = begin; i < end; i++) {
+      float t = progress[i];
+
+      if(easing[i] != Easing::LINEAR) {
+        const float *table = easing_tables[int(easing[i])];
+        float pos = t * easing_table_size;
+        int j = std::min(int(pos), easing_table_size - 1);
+        t = table[j] + (table[j + 1] - table[j]) * (pos - j);
+      }
+
+      float value = from[i] + delta[i] * t;
+      values[i] = value;
+
+      if(targets[i])
+        *targets[i] = value;
+
+      if(int32_t(time - start[i]) >= int32_t(duration[i]))
+        finished.push_back(uint32_t(slots[slot[i]].generation) << 16 | slot[i]);
+    }
+  }
+
+  // handles a tween reaching the end, looping it or removing it and starting the next
+  void TweenGroup::finish(uint32_t index, uint32_t time) {
+    uint32_t periods = (time - start[index]) / duration[index];
+
+    bool reverse = flags[index] & flag_yoyo;
+
+    if(loops[index] == -1 || uint32_t(loops[index]) > periods) {
+      // loop, skipping any periods that were missed
+      if(loops[index] != -1)
+        loops[index] -= periods;
+
+      start[index] += periods * duration[index];
+
+      if(reverse && (periods & 1)) {
+        from[index] += delta[index];
+        delta[index] = -delta[index];
+      }
+
+      evaluate(index, index + 1, time);
+      return;
+    }
+
+    // finished, end on the right value after any missed periods
+    uint32_t end_time = start[index] + loops[index] * duration[index];
+
+    if(reverse && !(loops[index] & 1)) {
+      from[index] += delta[index];
+      delta[index] = -delta[index];
+    }
+
+    float value = from[index] + delta[index];
+    if(targets[index])
+      *targets[index] = value;
+
+    auto &s = slots[slot[index]];
+    TweenHandle handle{uint32_t(s.generation) << 16 | slot[index]};
+    TweenHandle next{s.next};
+    auto callback = s.callback;
+    auto callback_arg = s.callback_arg;
+
+    destroy(index);
+
+    auto next_index = find(next);
+    if(next_index != no_slot) {
+      start[next_index] += end_time; // holds the delay until now
+      flags[next_index] &= ~flag_waiting;
+    }
+
+    if(callback)
+      callback(handle, callback_arg);
+  }
 }
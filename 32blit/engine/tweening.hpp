@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace blit {
   const uint32_t LINEAR = 1UL << 0;
@@ -35,9 +36,121 @@ namespace blit {
     bool is_paused()    { return this->state == PAUSED; }
     bool is_stopped()   { return this->state == STOPPED; }
     bool is_finished()  { return this->state == FINISHED; }
+
+    ~Tween();
+  };
+
+  extern std::vector<Tween *> &tweens;
+
+  enum class Easing : uint8_t {
+    LINEAR,
+    IN_QUAD,
+    OUT_QUAD,
+    IN_OUT_QUAD,
+    IN_CUBIC,
+    OUT_CUBIC,
+    IN_OUT_CUBIC,
+    IN_SINE,
+    OUT_SINE,
+    IN_OUT_SINE,
+    IN_EXPO,
+    OUT_EXPO,
+    IN_OUT_EXPO,
+    IN_BACK,    // overshoots below the start
+    OUT_BACK,   // overshoots past the end
+    IN_OUT_BACK,
+    OUT_ELASTIC,
+    OUT_BOUNCE,
+
+    COUNT
+  };
+
+  float ease(Easing easing, float t);
+
+  // refers to a tween in a TweenGroup. Becomes invalid when the tween finishes or is removed,
+  // after which it is safe to use but does nothing
+  struct TweenHandle {
+    uint32_t id = 0; // 0 is never a valid tween
+
+    bool operator==(const TweenHandle &other) const { return id == other.id; }
+    bool operator!=(const TweenHandle &other) const { return id != other.id; }
+  };
+
+  using TweenCallback = void (*)(TweenHandle handle, void *arg);
+
+  /**
+   * A set of tweens updated together. The tweens are stored as arrays of each value
+   * so they are all updated in one pass, with the easing curves read from tables.
+   * Each tween can write its value to a float, and can be followed by another tween.
+   *
+   * `tween_group` is updated automatically, other groups need `update` to be called.
+   */
+  class TweenGroup final {
+  public:
+    TweenGroup();
+    TweenGroup(const TweenGroup &) = delete;
+    TweenGroup &operator=(const TweenGroup &) = delete;
+
+    TweenHandle add(float *target, float from, float to, uint32_t duration, Easing easing = Easing::LINEAR, uint32_t delay = 0);
+    TweenHandle then(TweenHandle previous, float *target, float from, float to, uint32_t duration, Easing easing = Easing::LINEAR, uint32_t delay = 0);
+
+    void set_loops(TweenHandle handle, int32_t loops, bool yoyo = false);
+    void set_callback(TweenHandle handle, TweenCallback callback, void *arg = nullptr);
+
+    bool remove(TweenHandle handle);
+    void clear();
+
+    bool is_active(TweenHandle handle) const;
+    float get_value(TweenHandle handle) const;
+    uint32_t get_count() const;
+
+    void update(uint32_t time);
+
+  private:
+    static const uint32_t no_slot = ~0u;
+
+    // flags
+    static const uint8_t flag_yoyo = 1 << 0;
+    static const uint8_t flag_waiting = 1 << 1; // for the previous tween to finish
+
+    // handles refer to slots, which don't move. The tweens in the arrays do
+    struct Slot {
+      uint16_t generation = 1;
+      uint32_t index = no_slot;           // in the arrays, or the next free slot
+      uint32_t next = 0;                  // handle of the tween to start after this one
+      TweenCallback callback = nullptr;
+      void *callback_arg = nullptr;
+    };
+
+    uint32_t find(TweenHandle handle) const;
+    TweenHandle create(float *target, float from, float to, uint32_t duration, Easing easing, uint32_t start, uint8_t flags);
+    void destroy(uint32_t index);
+    void swap(uint32_t a, uint32_t b);
+    void activate(uint32_t index);
+    void evaluate(uint32_t begin, uint32_t end, uint32_t time);
+    void finish(uint32_t index, uint32_t time);
+
+    std::vector<Slot> slots;
+    uint32_t free_slot = no_slot;
+
+    // running tweens are at the start of the arrays, then the ones waiting to start
+    uint32_t active_count = 0;
+
+    std::vector<float *> targets;
+    std::vector<float> from, delta, values;
+    std::vector<float> inv_duration;
+    std::vector<uint32_t> start, duration;
+    std::vector<int32_t> loops;     // remaining, -1 for forever
+    std::vector<Easing> easing;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> slot;     // back to the handle's slot
+
+    // scratch for update
+    std::vector<float> progress;
+    std::vector<uint32_t> finished;
   };
 
-  extern std::vector<Tween *> tweens;
+  extern TweenGroup tween_group;
 
   void update_tweens(uint32_t time);
 
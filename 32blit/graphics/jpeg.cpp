@@ -1,8 +1,1095 @@
+/*! \file jpeg.cpp
+    \brief JPEG decoding
+*/
+#include <algorithm>
+#include <cstring>
+
 #include "jpeg.hpp"
+#include "surface.hpp"
 #include "../engine/api_private.hpp"
+#include "../engine/file.hpp"
+#include "../engine/jobs.hpp"
 
 namespace blit {
 
+  // maps zig-zag coefficient order to natural order
+  static const uint8_t jpeg_zigzag[64 + 16] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+    // padding so that corrupt run lengths can't index past the end
+    63, 63, 63, 63, 63, 63, 63, 63,
+    63, 63, 63, 63, 63, 63, 63, 63
+  };
+
+  static const int jpeg_huff_fast_bits = 9;
+
+  // 8-bit samples give coefficients of 11 bits and a sign, larger values are from corrupt data
+  // and could overflow the IDCT
+  static inline int32_t jpeg_clamp_coef(int32_t v) {
+    return v < -2048 ? -2048 : (v > 2047 ? 2047 : v);
+  }
+  static const int jpeg_input_buffer_size = 512;
+
+  struct JPEGHuffman {
+    uint8_t values[256];
+    uint16_t fast[1 << jpeg_huff_fast_bits]; // (length << 8) | value, 0 if not a short code
+    int32_t max_code[18];                      // largest code of each length, -1 if none
+    int32_t val_offset[17];                    // index of the first value of each length minus its first code
+    bool defined = false;                      // set by a DHT
+  };
+
+  struct JPEGComponent {
+    uint8_t id;
+    uint8_t h, v;           // sampling factors
+    uint8_t quant;          // quantisation table index
+    uint8_t dc_table, ac_table;
+    int32_t dc_pred;
+    uint8_t pixels[4 * 64]; // decoded MCU for this component at output scale
+  };
+
+  /**
+   * Decoder state: headers, tables and input/bit reader.
+   */
+  struct JPEGDecodeState {
+    // input
+    const uint8_t *in = nullptr, *in_end = nullptr;
+    File file;              // streamed input, if not in memory
+    uint32_t file_offset = 0;
+    uint8_t in_buf[jpeg_input_buffer_size];
+
+    // bit reader
+    uint32_t bit_buf = 0;   // left aligned
+    int bit_count = 0;
+    uint8_t marker = 0;     // marker found in the scan data
+
+    // tables
+    uint16_t quant[4][64];
+    JPEGHuffman huff_dc[4], huff_ac[4];
+
+    // frame
+    JPEGComponent comps[3];
+    int num_comps = 0;
+    int h_max = 1, v_max = 1;
+    int mcus_x = 0, mcus_y = 0;
+    uint16_t restart_interval = 0;
+
+    // incremental decode
+    bool started = false;
+    int mcu_row = 0;
+    int restarts_left = 0;
+    int block_size = 8;
+    Rect out_rect;          // output pixels still to decode
+    uint8_t *out = nullptr; // top-left of out_rect, or nullptr to use the row buffer
+    int pixel_stride = 3, row_stride = 0;
+    std::unique_ptr<uint8_t[]> row_buf; // one MCU row of RGB when decoding to a callback
+    std::unique_ptr<int32_t[]> row_coefs; // one MCU row of coefficients, only used with job workers
+    JPEGRowCallback callback;
+
+    bool fill_input() {
+      // memory input is complete, nothing more to read
+      if(!file.is_open())
+        return false;
+
+      auto read = file.read(file_offset, jpeg_input_buffer_size, (char *)in_buf);
+      if(read <= 0)
+        return false;
+
+      file_offset += read;
+      in = in_buf;
+      in_end = in_buf + read;
+      return true;
+    }
+
+    bool read_byte(uint8_t &b) {
+      if(in == in_end && !fill_input())
+        return false;
+
+      b = *in++;
+      return true;
+    }
+
+    bool read_u16(uint16_t &v) {
+      uint8_t hi, lo;
+      if(!read_byte(hi) || !read_byte(lo))
+        return false;
+
+      v = (hi << 8) | lo;
+      return true;
+    }
+
+    bool skip(uint32_t len) {
+      uint8_t b;
+      while(len--) {
+        if(!read_byte(b))
+          return false;
+      }
+      return true;
+    }
+
+    // finds the next marker, returns 0 at the end of the data
+    uint8_t next_marker() {
+      if(marker) {
+        uint8_t ret = marker;
+        marker = 0;
+        return ret;
+      }
+
+      uint8_t b = 0;
+      while(true) {
+        while(b != 0xFF) {
+          if(!read_byte(b))
+            return 0;
+        }
+
+        // skip fill bytes
+        do {
+          if(!read_byte(b))
+            return 0;
+        } while(b == 0xFF);
+
+        // not a marker if stuffed
+        if(b)
+          return b;
+      }
+    }
+
+    void fill_bits() {
+      while(bit_count <= 24) {
+        uint8_t b = 0;
+
+        if(!marker && read_byte(b) && b == 0xFF) {
+          uint8_t next = 0;
+          read_byte(next);
+
+          if(next != 0) {
+            // marker, stop reading and feed zeros
+            marker = next;
+            b = 0;
+          }
+        }
+
+        bit_buf |= uint32_t(b) << (24 - bit_count);
+        bit_count += 8;
+      }
+    }
+
+    int get_bits(int count) {
+      if(bit_count < count)
+        fill_bits();
+
+      int ret = bit_buf >> (32 - count);
+      bit_buf <<= count;
+      bit_count -= count;
+      return ret;
+    }
+
+    // reads `count` bits and sign extends them as a coefficient
+    int get_coef(int count) {
+      if(!count)
+        return 0;
+
+      int v = get_bits(count);
+      return v < (1 << (count - 1)) ? v - (1 << count) + 1 : v;
+    }
+
+    // returns the decoded value, or -1 if the data doesn't match a code
+    int decode_huffman(const JPEGHuffman &h) {
+      if(bit_count < 16)
+        fill_bits();
+
+      auto fast = h.fast[bit_buf >> (32 - jpeg_huff_fast_bits)];
+      if(fast) {
+        int len = fast >> 8;
+        bit_buf <<= len;
+        bit_count -= len;
+        return fast & 0xFF;
+      }
+
+      // long code
+      uint32_t code = bit_buf >> 16;
+      int len = jpeg_huff_fast_bits + 1;
+      while(len <= 16 && int32_t(code >> (16 - len)) > h.max_code[len])
+        len++;
+
+      if(len > 16) {
+        // corrupt data
+        bit_count = 0;
+        return -1;
+      }
+
+      bit_buf <<= len;
+      bit_count -= len;
+      return h.values[(code >> (16 - len)) + h.val_offset[len]];
+    }
+
+    void reset_bits() {
+      bit_buf = 0;
+      bit_count = 0;
+    }
+
+    bool build_huffman(JPEGHuffman &h, const uint8_t *counts) {
+      int code = 0, k = 0;
+
+      h.defined = false;
+      memset(h.fast, 0, sizeof(h.fast));
+
+      for(int len = 1; len <= 16; len++) {
+        // too many codes for this length, or more values than the table holds
+        if(code + counts[len - 1] > (1 << len) || k + counts[len - 1] > 256)
+          return false;
+
+        h.val_offset[len] = k - code;
+
+        for(int i = 0; i < counts[len - 1]; i++, k++, code++) {
+          if(len <= jpeg_huff_fast_bits) {
+            // fill all the entries starting with this code
+            int shift = jpeg_huff_fast_bits - len;
+            for(int j = 0; j < (1 << shift); j++)
+              h.fast[(code << shift) + j] = (len << 8) | h.values[k];
+          }
+        }
+
+        h.max_code[len] = counts[len - 1] ? code - 1 : -1;
+
+        code <<= 1;
+      }
+
+      h.max_code[17] = INT32_MAX;
+      h.defined = true;
+      return true;
+    }
+
+    bool read_dqt(uint16_t len) {
+      len -= 2;
+      while(len > 0) {
+        uint8_t pq_tq;
+        if(!read_byte(pq_tq))
+          return false;
+
+        int precision = pq_tq >> 4, table = pq_tq & 3;
+        for(int i = 0; i < 64; i++) {
+          uint8_t b;
+          uint16_t v;
+          if(precision) {
+            if(!read_u16(v))
+              return false;
+          } else {
+            if(!read_byte(b))
+              return false;
+            v = b;
+          }
+          quant[table][i] = v;
+        }
+
+        int table_len = 1 + 64 * (precision ? 2 : 1);
+        if(table_len > len)
+          return false;
+        len -= table_len;
+      }
+      return true;
+    }
+
+    bool read_dht(uint16_t len) {
+      len -= 2;
+      while(len > 0) {
+        uint8_t tc_th, counts[16];
+        if(!read_byte(tc_th))
+          return false;
+
+        int total = 0;
+        for(int i = 0; i < 16; i++) {
+          if(!read_byte(counts[i]))
+            return false;
+          total += counts[i];
+        }
+
+        if(total > 256 || 17 + total > len)
+          return false;
+
+        auto &h = (tc_th >> 4) ? huff_ac[tc_th & 3] : huff_dc[tc_th & 3];
+        for(int i = 0; i < total; i++) {
+          if(!read_byte(h.values[i]))
+            return false;
+        }
+
+        if(!build_huffman(h, counts))
+          return false;
+
+        len -= 17 + total;
+      }
+      return true;
+    }
+
+    bool read_sof(uint16_t len, Size &size) {
+      uint8_t precision, count;
+      uint16_t w, h;
+
+      if(!read_byte(precision) || !read_u16(h) || !read_u16(w) || !read_byte(count))
+        return false;
+
+      if(precision != 8 || (count != 1 && count != 3) || !w || !h || len != 8 + count * 3)
+        return false;
+
+      num_comps = count;
+      h_max = v_max = 1;
+
+      for(int i = 0; i < count; i++) {
+        auto &comp = comps[i];
+        uint8_t hv;
+        if(!read_byte(comp.id) || !read_byte(hv) || !read_byte(comp.quant))
+          return false;
+
+        comp.h = count == 1 ? 1 : hv >> 4;
+        comp.v = count == 1 ? 1 : hv & 0xF;
+        comp.quant &= 3;
+
+        if(comp.h < 1 || comp.h > 2 || comp.v < 1 || comp.v > 2)
+          return false;
+
+        h_max = std::max(h_max, int(comp.h));
+        v_max = std::max(v_max, int(comp.v));
+      }
+
+      size = Size(w, h);
+      mcus_x = (w + h_max * 8 - 1) / (h_max * 8);
+      mcus_y = (h + v_max * 8 - 1) / (v_max * 8);
+      return true;
+    }
+
+    bool read_sos(uint16_t len) {
+      uint8_t count;
+      if(!read_byte(count) || count != num_comps || len != 6 + count * 2)
+        return false;
+
+      for(int i = 0; i < count; i++) {
+        uint8_t id, tables;
+        if(!read_byte(id) || !read_byte(tables))
+          return false;
+
+        // components must be in frame order
+        if(comps[i].id != id)
+          return false;
+
+        comps[i].dc_table = (tables >> 4) & 3;
+        comps[i].ac_table = tables & 3;
+        comps[i].dc_pred = 0;
+
+        if(!huff_dc[comps[i].dc_table].defined || !huff_ac[comps[i].ac_table].defined)
+          return false;
+      }
+
+      // spectral selection/successive approximation, fixed for baseline
+      return skip(3);
+    }
+
+    // parses up to the start of the scan data
+    bool read_headers(Size &size) {
+      restart_interval = 0;
+      num_comps = 0;
+
+      uint8_t b0, b1;
+      if(!read_byte(b0) || !read_byte(b1) || b0 != 0xFF || b1 != 0xD8)
+        return false;
+
+      while(true) {
+        uint8_t marker = next_marker();
+        uint16_t len;
+
+        // no length
+        if((marker >= 0xD0 && marker <= 0xD7) || marker == 0x01)
+          continue;
+
+        if(!marker || marker == 0xD9 || !read_u16(len) || len < 2)
+          return false;
+
+        bool ok = true;
+        switch(marker) {
+          case 0xC0: // baseline
+          case 0xC1: // extended sequential, huffman
+            ok = read_sof(len, size);
+            break;
+
+          case 0xC4:
+            ok = read_dht(len);
+            break;
+
+          case 0xDB:
+            ok = read_dqt(len);
+            break;
+
+          case 0xDD:
+            ok = read_u16(restart_interval);
+            break;
+
+          case 0xDA:
+            ok = num_comps && read_sos(len);
+            if(ok) {
+              reset_bits();
+              this->marker = 0;
+            }
+            return ok;
+
+          default:
+            // progressive/arithmetic/lossless are not supported
+            if((marker >= 0xC2 && marker <= 0xCF) && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+              return false;
+
+            ok = skip(len - 2);
+            break;
+        }
+
+        if(!ok)
+          return false;
+      }
+    }
+
+    // handles a restart marker between MCUs
+    bool restart() {
+      reset_bits();
+
+      uint8_t marker = next_marker();
+      if(marker < 0xD0 || marker > 0xD7)
+        return false;
+
+      for(int c = 0; c < num_comps; c++)
+        comps[c].dc_pred = 0;
+
+      return true;
+    }
+
+    // decodes and dequantises one block of coefficients (natural order), returns false if the data is corrupt
+    bool decode_block(JPEGComponent &comp, int32_t *coefs) {
+      auto &q = quant[comp.quant];
+
+      memset(coefs, 0, 64 * sizeof(int32_t));
+
+      // DC differences are at most 11 bits for 8-bit samples
+      int t = decode_huffman(huff_dc[comp.dc_table]);
+      if(t < 0 || t > 11)
+        return false;
+
+      comp.dc_pred += get_coef(t);
+      coefs[0] = jpeg_clamp_coef(comp.dc_pred * q[0]);
+
+      auto &ac = huff_ac[comp.ac_table];
+      for(int k = 1; k < 64;) {
+        int rs = decode_huffman(ac);
+        if(rs < 0)
+          return false;
+
+        int run = rs >> 4, s = rs & 0xF;
+
+        if(!s) {
+          if(run != 15)
+            break; // end of block
+
+          k += 16;
+          continue;
+        }
+
+        k += run;
+        coefs[jpeg_zigzag[k]] = jpeg_clamp_coef(get_coef(s) * q[k & 63]);
+        k++;
+      }
+
+      return true;
+    }
+  };
+
+  static inline uint8_t jpeg_clamp(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+  }
+
+  /*
+   * 8x8 integer IDCT (Loeffler, Ligtenberg and Moschytz) with 12 bits of
+   * fixed point precision for the constants.
+   */
+  #define JPEG_FIX(x) int32_t((x) * 4096.0f + 0.5f)
+
+  #define JPEG_IDCT_1D(s0, s1, s2, s3, s4, s5, s6, s7) \
+    int32_t t0, t1, t2, t3, p1, p2, p3, p4, p5, x0, x1, x2, x3; \
+    p2 = s2; p3 = s6; \
+    p1 = (p2 + p3) * JPEG_FIX(0.5411961f); \
+    t2 = p1 + p3 * JPEG_FIX(-1.847759065f); \
+    t3 = p1 + p2 * JPEG_FIX(0.765366865f); \
+    p2 = s0; p3 = s4; \
+    t0 = (p2 + p3) * 4096; \
+    t1 = (p2 - p3) * 4096; \
+    x0 = t0 + t3; x3 = t0 - t3; \
+    x1 = t1 + t2; x2 = t1 - t2; \
+    t0 = s7; t1 = s5; t2 = s3; t3 = s1; \
+    p3 = t0 + t2; p4 = t1 + t3; \
+    p1 = t0 + t3; p2 = t1 + t2; \
+    p5 = (p3 + p4) * JPEG_FIX(1.175875602f); \
+    t0 = t0 * JPEG_FIX(0.298631336f); \
+    t1 = t1 * JPEG_FIX(2.053119869f); \
+    t2 = t2 * JPEG_FIX(3.072711026f); \
+    t3 = t3 * JPEG_FIX(1.501321110f); \
+    p1 = p5 + p1 * JPEG_FIX(-0.899976223f); \
+    p2 = p5 + p2 * JPEG_FIX(-2.562915447f); \
+    p3 = p3 * JPEG_FIX(-1.961570560f); \
+    p4 = p4 * JPEG_FIX(-0.390180644f); \
+    t3 += p1 + p4; t2 += p2 + p3; \
+    t1 += p2 + p4; t0 += p1 + p3;
+
+  static void jpeg_idct_8x8(const int32_t *in, uint8_t *out, int out_stride) {
+    int32_t tmp[64];
+
+    // columns
+    for(int i = 0; i < 8; i++) {
+      auto d = in + i;
+      auto v = tmp + i;
+
+      if(!d[8] && !d[16] && !d[24] && !d[32] && !d[40] && !d[48] && !d[56]) {
+        // DC only
+        int32_t dc = d[0] * 4;
+        v[0] = v[8] = v[16] = v[24] = v[32] = v[40] = v[48] = v[56] = dc;
+        continue;
+      }
+
+      JPEG_IDCT_1D(d[0], d[8], d[16], d[24], d[32], d[40], d[48], d[56])
+
+      // keep 2 extra bits
+      x0 += 512; x1 += 512; x2 += 512; x3 += 512;
+      v[0]  = (x0 + t3) >> 10;
+      v[56] = (x0 - t3) >> 10;
+      v[8]  = (x1 + t2) >> 10;
+      v[48] = (x1 - t2) >> 10;
+      v[16] = (x2 + t1) >> 10;
+      v[40] = (x2 - t1) >> 10;
+      v[24] = (x3 + t0) >> 10;
+      v[32] = (x3 - t0) >> 10;
+    }
+
+    // rows
+    for(int i = 0; i < 8; i++, out += out_stride) {
+      auto v = tmp + i * 8;
+
+      JPEG_IDCT_1D(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7])
+
+      // remove 12 bits of constants, 2 extra bits and 3 bits of scaling, round and level shift
+      const int32_t bias = 65536 + (128 << 17);
+      x0 += bias; x1 += bias; x2 += bias; x3 += bias;
+      out[0] = jpeg_clamp((x0 + t3) >> 17);
+      out[7] = jpeg_clamp((x0 - t3) >> 17);
+      out[1] = jpeg_clamp((x1 + t2) >> 17);
+      out[6] = jpeg_clamp((x1 - t2) >> 17);
+      out[2] = jpeg_clamp((x2 + t1) >> 17);
+      out[5] = jpeg_clamp((x2 - t1) >> 17);
+      out[3] = jpeg_clamp((x3 + t0) >> 17);
+      out[4] = jpeg_clamp((x3 - t0) >> 17);
+    }
+  }
+
+  #undef JPEG_IDCT_1D
+  #undef JPEG_FIX
+
+  /*
+   * Reduced size IDCT: an N-point IDCT of the top-left NxN coefficients
+   * produces the image downscaled by 8/N.
+   */
+  static void jpeg_idct_scaled(const int32_t *in, uint8_t *out, int out_stride, int n) {
+    // C(u) / 2 * cos((2x + 1) * u * pi / 2N) for 4 and 2 point outputs (Q11)
+    static const int16_t table[2][4][4] = {
+      {
+        {724,  946,  724,  392},
+        {724,  392, -724, -946},
+        {724, -392, -724,  946},
+        {724, -946,  724, -392}
+      },
+      {
+        {724,  724},
+        {724, -724}
+      }
+    };
+
+    if(n == 1) {
+      out[0] = jpeg_clamp(((in[0] + 4) >> 3) + 128);
+      return;
+    }
+
+    auto &t = table[n == 4 ? 0 : 1];
+    int32_t tmp[4][4];
+
+    // rows, keeping 3 extra bits
+    for(int v = 0; v < n; v++) {
+      for(int x = 0; x < n; x++) {
+        int32_t sum = 0;
+        for(int u = 0; u < n; u++)
+          sum += in[v * 8 + u] * t[x][u];
+
+        tmp[v][x] = (sum + (1 << 7)) >> 8;
+      }
+    }
+
+    // columns
+    for(int y = 0; y < n; y++, out += out_stride) {
+      for(int x = 0; x < n; x++) {
+        int32_t sum = 0;
+        for(int v = 0; v < n; v++)
+          sum += tmp[v][x] * t[y][v];
+
+        out[x] = jpeg_clamp(((sum + (1 << 13)) >> 14) + 128);
+      }
+    }
+  }
+
+  JPEGDecoder::JPEGDecoder() = default;
+  JPEGDecoder::~JPEGDecoder() = default;
+
+  /**
+   * Open a JPEG image in memory and read its headers. The data must remain valid while decoding.
+   *
+   * Only baseline (non-progressive) images with 1 or 3 components are supported.
+   *
+   * \param ptr Pointer to data
+   * \param len Length of data
+   *
+   * \return `true` if the image is supported
+   */
+  bool JPEGDecoder::open(const uint8_t *ptr, uint32_t len) {
+    close();
+
+    state.reset(new JPEGDecodeState);
+    state->in = ptr;
+    state->in_end = ptr + len;
+
+    if(!state->read_headers(size)) {
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * Open a JPEG image file and read its headers. The file is read in small chunks while decoding,
+   * so the compressed data is never fully loaded into memory.
+   *
+   * \param filename File to open
+   *
+   * \return `true` if the image is supported
+   */
+  bool JPEGDecoder::open(const std::string &filename) {
+    close();
+
+    state.reset(new JPEGDecodeState);
+
+    auto &file = state->file;
+    if(!file.open(filename)) {
+      close();
+      return false;
+    }
+
+    // in-memory files can be decoded in place
+    if(file.get_ptr()) {
+      state->in = file.get_ptr();
+      state->in_end = state->in + file.get_length();
+      file.close();
+    }
+
+    if(!state->read_headers(size)) {
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * Release the decoder state.
+   */
+  void JPEGDecoder::close() {
+    state.reset();
+    size = Size();
+  }
+
+  /**
+   * Calculate the size of the decoded output.
+   *
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   *
+   * \return Size of the output in pixels
+   */
+  Size JPEGDecoder::get_output_size(JPEGScale scale, Rect region) const {
+    auto r = output_rect(scale, region);
+    return Size(r.w, r.h);
+  }
+
+  /**
+   * Decode the image as RGB into caller-provided memory.
+   *
+   * The decoder can only decode once, re-open the image to decode again.
+   *
+   * \param out Output buffer, must have room for `get_output_size(scale, region).h` rows
+   * \param row_stride Size of an output row in bytes
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   *
+   * \return `true` if successful
+   */
+  bool JPEGDecoder::decode(uint8_t *out, uint32_t row_stride, JPEGScale scale, Rect region) {
+    return begin(out, row_stride, scale, region) && finish();
+  }
+
+  /**
+   * Decode the image directly into a `Surface`. The surface must be RGB or RGBA.
+   *
+   * \param dest Surface to decode into, output is clipped to the surface's clip rect
+   * \param p Position in the surface to place the top-left of the output
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   *
+   * \return `true` if successful
+   */
+  bool JPEGDecoder::decode(Surface &dest, const Point &p, JPEGScale scale, Rect region) {
+    return begin(dest, p, scale, region) && finish();
+  }
+
+  /**
+   * Decode the image, passing each decoded MCU row to a callback. Only one MCU row
+   * (at most 16 rows of pixels) of output is buffered at a time.
+   *
+   * \param callback Called with RGB data for each part of the output as it is decoded
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   *
+   * \return `true` if successful
+   */
+  bool JPEGDecoder::decode(JPEGRowCallback callback, JPEGScale scale, Rect region) {
+    return begin(callback, scale, region) && finish();
+  }
+
+  /**
+   * Start an incremental decode into caller-provided memory. Call `step` until it no longer
+   * returns `JPEGDecodeStatus::in_progress` to decode the image.
+   *
+   * \param out Output buffer, must have room for `get_output_size(scale, region).h` rows
+   * \param row_stride Size of an output row in bytes
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   *
+   * \return `true` if successful
+   */
+  bool JPEGDecoder::begin(uint8_t *out, uint32_t row_stride, JPEGScale scale, Rect region) {
+    return begin_rect(out, 3, row_stride, scale, output_rect(scale, region));
+  }
+
+  /**
+   * Start an incremental decode into a `Surface`. The surface must be RGB or RGBA.
+   *
+   * \param dest Surface to decode into, output is clipped to the surface's clip rect
+   * \param p Position in the surface to place the top-left of the output
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   *
+   * \return `true` if successful
+   */
+  bool JPEGDecoder::begin(Surface &dest, const Point &p, JPEGScale scale, Rect region) {
+    if(dest.format != PixelFormat::RGB && dest.format != PixelFormat::RGBA)
+      return false;
+
+    auto out_rect = output_rect(scale, region);
+
+    Rect dr = dest.clip.intersection(Rect(p.x, p.y, out_rect.w, out_rect.h));
+    if(dr.empty())
+      out_rect = Rect();
+    else
+      out_rect = Rect(out_rect.x + dr.x - p.x, out_rect.y + dr.y - p.y, dr.w, dr.h);
+
+    return begin_rect(dest.ptr(dr.x, dr.y), dest.pixel_stride, dest.row_stride, scale, out_rect);
+  }
+
+  /**
+   * Start an incremental decode to a callback. See `decode(JPEGRowCallback, ...)`.
+   *
+   * \param callback Called with RGB data for each part of the output as it is decoded
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   *
+   * \return `true` if successful
+   */
+  bool JPEGDecoder::begin(JPEGRowCallback callback, JPEGScale scale, Rect region) {
+    if(!callback || !begin_rect(nullptr, 3, 0, scale, output_rect(scale, region)))
+      return false;
+
+    auto &s = *state;
+    s.callback = callback;
+    s.row_stride = s.out_rect.w * 3;
+    s.row_buf.reset(new uint8_t[s.row_stride * s.v_max * s.block_size]);
+    return true;
+  }
+
+  /**
+   * Decode part of the image started by `begin`. At least one MCU row is decoded per call.
+   *
+   * \param time_budget_us Keep decoding MCU rows until this many microseconds have passed, 0 to decode one row
+   *
+   * \return Whether the decode is still in progress, finished or has failed
+   */
+  JPEGDecodeStatus JPEGDecoder::step(uint32_t time_budget_us) {
+    if(!state || !state->started)
+      return JPEGDecodeStatus::error;
+
+    auto &s = *state;
+
+    // without a timer only one row can be decoded
+    if(!api.get_us_timer)
+      time_budget_us = 0;
+
+    uint32_t start = 0;
+    if(time_budget_us) {
+      // the timer isn't running on the device until something enables it
+      if(api.enable_us_timer)
+        api.enable_us_timer();
+
+      start = now_us();
+    }
+
+    do {
+      // past the region, nothing more to do
+      if(s.out_rect.empty() || s.mcu_row == s.mcus_y) {
+        end_decode();
+        return JPEGDecodeStatus::done;
+      }
+
+      if(!decode_mcu_row()) {
+        end_decode();
+        return JPEGDecodeStatus::error;
+      }
+    } while(time_budget_us && us_diff(start, now_us()) < time_budget_us);
+
+    return JPEGDecodeStatus::in_progress;
+  }
+
+  /**
+   * Finish an incremental decode without a time limit.
+   *
+   * \return `true` if successful
+   */
+  bool JPEGDecoder::finish() {
+    JPEGDecodeStatus status;
+    while((status = step()) == JPEGDecodeStatus::in_progress);
+
+    return status == JPEGDecodeStatus::done;
+  }
+
+  // converts a region in full scale pixels to output pixels, clamped to the image
+  Rect JPEGDecoder::output_rect(JPEGScale scale, Rect region) const {
+    int shift = int(scale);
+    int round = (1 << shift) - 1;
+
+    Rect image(0, 0, size.w, size.h);
+    region = region.empty() ? image : image.intersection(region);
+
+    if(region.empty())
+      return Rect();
+
+    int x0 = region.x >> shift, y0 = region.y >> shift;
+    int x1 = (region.x + region.w + round) >> shift;
+    int y1 = (region.y + region.h + round) >> shift;
+
+    return Rect(x0, y0, x1 - x0, y1 - y0);
+  }
+
+  bool JPEGDecoder::begin_rect(uint8_t *out, int pixel_stride, int row_stride, JPEGScale scale, const Rect &out_rect) {
+    // the scan data can only be decoded once
+    if(!state || !state->num_comps || state->started)
+      return false;
+
+    auto &s = *state;
+
+    s.started = true;
+    s.mcu_row = 0;
+    s.restarts_left = s.restart_interval;
+    s.block_size = 8 >> int(scale);
+    s.out_rect = out_rect;
+    s.out = out;
+    s.pixel_stride = pixel_stride;
+    s.row_stride = row_stride;
+    s.row_coefs.reset(); // sized for the frame on first use
+
+    return true;
+  }
+
+  void JPEGDecoder::end_decode() {
+    auto &s = *state;
+
+    // headers have been consumed, the image needs re-opening to decode again
+    s.num_comps = 0;
+    s.started = false;
+    s.row_buf.reset();
+    s.row_coefs.reset();
+    s.callback = nullptr;
+    s.file.close();
+  }
+
+  // IDCT one block of a component into its MCU buffer
+  static void jpeg_idct_block(const JPEGComponent &comp, const int32_t *coefs, uint8_t *pixels, int bx, int by, int block_size) {
+    int comp_stride = comp.h * block_size;
+    auto block_out = pixels + by * block_size * comp_stride + bx * block_size;
+
+    if(block_size == 8)
+      jpeg_idct_8x8(coefs, block_out, comp_stride);
+    else
+      jpeg_idct_scaled(coefs, block_out, comp_stride, block_size);
+  }
+
+  // colour convert the visible part of an MCU from the per-component buffers
+  static void jpeg_output_mcu(const JPEGDecodeState &s, const uint8_t *const *pixels, int x0, int y0, int py0, int py1, uint8_t *row_out, int out_y0) {
+    auto &out_rect = s.out_rect;
+    int block_size = s.block_size;
+    int mcu_w = s.h_max * block_size;
+
+    int px0 = std::max(x0, out_rect.x), px1 = std::min(x0 + mcu_w, out_rect.x + out_rect.w);
+    int pixel_stride = s.pixel_stride;
+
+    for(int y = py0; y < py1; y++) {
+      auto dest = row_out + (y - out_y0) * s.row_stride + (px0 - out_rect.x) * pixel_stride;
+      int ly = y - y0;
+
+      if(s.num_comps == 1) {
+        auto src = pixels[0] + ly * mcu_w + (px0 - x0);
+        for(int x = px0; x < px1; x++, dest += pixel_stride) {
+          dest[0] = dest[1] = dest[2] = *src++;
+          if(pixel_stride == 4)
+            dest[3] = 255;
+        }
+        continue;
+      }
+
+      auto &cy = s.comps[0], &cb = s.comps[1], &cr = s.comps[2];
+      auto y_row  = pixels[0] + (ly * cy.v / s.v_max) * cy.h * block_size;
+      auto cb_row = pixels[1] + (ly * cb.v / s.v_max) * cb.h * block_size;
+      auto cr_row = pixels[2] + (ly * cr.v / s.v_max) * cr.h * block_size;
+
+      for(int x = px0; x < px1; x++, dest += pixel_stride) {
+        int lx = x - x0;
+        int lum = y_row[lx * cy.h / s.h_max] << 16;
+        int u = cb_row[lx * cb.h / s.h_max] - 128;
+        int v = cr_row[lx * cr.h / s.h_max] - 128;
+
+        // Q16 YCbCr -> RGB
+        dest[0] = jpeg_clamp((lum + 91881 * v + 32768) >> 16);
+        dest[1] = jpeg_clamp((lum - 22554 * u - 46802 * v + 32768) >> 16);
+        dest[2] = jpeg_clamp((lum + 116130 * u + 32768) >> 16);
+        if(pixel_stride == 4)
+          dest[3] = 255;
+      }
+    }
+  }
+
+  bool JPEGDecoder::decode_mcu_row() {
+    auto &s = *state;
+
+    int block_size = s.block_size;
+    int mcu_w = s.h_max * block_size, mcu_h = s.v_max * block_size;
+    int32_t coefs[64];
+
+    auto &out_rect = s.out_rect;
+
+    int y0 = s.mcu_row++ * mcu_h;
+
+    // rows of output in this MCU row
+    int py0 = std::max(y0, out_rect.y), py1 = std::min(y0 + mcu_h, out_rect.y + out_rect.h);
+    bool row_visible = py0 < py1;
+
+    // stop after the last row of the region
+    if(py1 == out_rect.y + out_rect.h)
+      s.mcu_row = s.mcus_y;
+
+    // output for the callback goes to the row buffer
+    auto row_out = s.out ? s.out : s.row_buf.get();
+    int out_y0 = s.out ? out_rect.y : py0;
+
+    // visible MCUs in this row
+    int mx_begin = out_rect.x / mcu_w, mx_end = (out_rect.x + out_rect.w + mcu_w - 1) / mcu_w;
+
+    // with job workers, entropy decode the whole row (which is serial) and then
+    // spread the IDCT and colour conversion of the visible MCUs over the workers
+    int blocks_per_mcu = 0;
+    for(int c = 0; c < s.num_comps; c++)
+      blocks_per_mcu += s.comps[c].h * s.comps[c].v;
+
+    bool parallel = row_visible && mx_end - mx_begin > 1 && jobs::get_worker_count() > 1;
+
+    if(parallel && !s.row_coefs)
+      s.row_coefs.reset(new int32_t[s.mcus_x * blocks_per_mcu * 64]);
+
+    uint8_t *pixels[3] = {s.comps[0].pixels, s.comps[1].pixels, s.comps[2].pixels};
+
+    for(int mx = 0; mx < s.mcus_x; mx++) {
+      if(s.restart_interval) {
+        if(!s.restarts_left) {
+          if(!s.restart())
+            return false;
+          s.restarts_left = s.restart_interval;
+        }
+        s.restarts_left--;
+      }
+
+      int x0 = mx * mcu_w;
+      bool visible = row_visible && mx >= mx_begin && mx < mx_end;
+
+      // entropy decode all blocks, only IDCT the ones that will be output
+      auto block_coefs = parallel ? s.row_coefs.get() + mx * blocks_per_mcu * 64 : coefs;
+
+      for(int c = 0; c < s.num_comps; c++) {
+        auto &comp = s.comps[c];
+
+        for(int by = 0; by < comp.v; by++) {
+          for(int bx = 0; bx < comp.h; bx++) {
+            if(!s.decode_block(comp, block_coefs))
+              return false;
+
+            if(parallel)
+              block_coefs += 64;
+            else if(visible)
+              jpeg_idct_block(comp, coefs, pixels[c], bx, by, block_size);
+          }
+        }
+      }
+
+      if(visible && !parallel)
+        jpeg_output_mcu(s, pixels, x0, y0, py0, py1, row_out, out_y0);
+    }
+
+    if(parallel) {
+      jobs::parallel_for(mx_begin, mx_end, [&s, blocks_per_mcu, mcu_w, y0, py0, py1, row_out, out_y0](uint32_t begin, uint32_t end) {
+        // the shared component buffers belong to the serial path
+        uint8_t pixels[3][4 * 64];
+        const uint8_t *const pixel_ptrs[3] = {pixels[0], pixels[1], pixels[2]};
+
+        for(auto mx = begin; mx < end; mx++) {
+          auto block_coefs = s.row_coefs.get() + mx * blocks_per_mcu * 64;
+
+          for(int c = 0; c < s.num_comps; c++) {
+            auto &comp = s.comps[c];
+
+            for(int by = 0; by < comp.v; by++) {
+              for(int bx = 0; bx < comp.h; bx++, block_coefs += 64)
+                jpeg_idct_block(comp, block_coefs, pixels[c], bx, by, s.block_size);
+            }
+          }
+
+          jpeg_output_mcu(s, pixel_ptrs, mx * mcu_w, y0, py0, py1, row_out, out_y0);
+        }
+      }, 4);
+    }
+
+    if(s.callback && row_visible)
+      s.callback(row_out, s.row_stride, Rect(0, py0 - out_rect.y, out_rect.w, py1 - py0));
+
+    return true;
+  }
+
   static uint8_t *alloc_func(size_t len) {
     return new uint8_t[len];
   }
@@ -10,7 +1097,7 @@ namespace blit {
   /**
    * Decode a JPEG image from memory. The resolution of the image should be kept low to avoid running out of memory.
    * May not support all JPEG files due to limitations of the hardware decoder.
-   * 
+   *
    * \param ptr Pointer to data
    * \param len Length of data
    *
@@ -22,7 +1109,7 @@ namespace blit {
 
   /**
    * Decode a JPEG image from a file. See ::decode_jpeg_buffer for limitations.
-   * 
+   *
    * \param filename File to decode
    *
    * \return Decoded image.
@@ -30,4 +1117,97 @@ namespace blit {
   JPEGImage decode_jpeg_file(const std::string &filename) {
     return api.decode_jpeg_file(filename, alloc_func);
   }
-}
\ No newline at end of file
+
+  // decodes an opened image to a buffer, allocating it if needed
+  static JPEGImage decode_jpeg_image(JPEGDecoder &decoder, JPEGScale scale, Rect region, uint8_t *buffer) {
+    auto size = decoder.get_output_size(scale, region);
+    bool allocated = buffer == nullptr;
+
+    if(allocated)
+      buffer = new uint8_t[size.area() * 3];
+
+    if(!decoder.decode(buffer, size.w * 3, scale, region)) {
+      if(allocated)
+        delete[] buffer;
+      return {};
+    }
+
+    return {size, buffer};
+  }
+
+  /**
+   * Decode a JPEG image from memory using the software decoder. Decoding at a reduced `scale`
+   * or only a `region` of the image is much faster than decoding the whole image.
+   *
+   * \param ptr Pointer to data
+   * \param len Length of data
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   * \param buffer Optional buffer to decode into, must be at least 3 * the output width * height bytes.
+   * If `nullptr` a buffer is allocated with `new[]`.
+   *
+   * \return Decoded image, `data` is `nullptr` if decoding failed.
+   */
+  JPEGImage decode_jpeg_buffer(const uint8_t *ptr, uint32_t len, JPEGScale scale, Rect region, uint8_t *buffer) {
+    JPEGDecoder decoder;
+
+    if(!decoder.open(ptr, len))
+      return {};
+
+    return decode_jpeg_image(decoder, scale, region, buffer);
+  }
+
+  /**
+   * Decode a JPEG image from a file using the software decoder. See the buffer version for details.
+   *
+   * The file is read in small chunks, only the output needs to fit in memory.
+   *
+   * \param filename File to decode
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   * \param buffer Optional buffer to decode into
+   *
+   * \return Decoded image, `data` is `nullptr` if decoding failed.
+   */
+  JPEGImage decode_jpeg_file(const std::string &filename, JPEGScale scale, Rect region, uint8_t *buffer) {
+    JPEGDecoder decoder;
+
+    if(!decoder.open(filename))
+      return {};
+
+    return decode_jpeg_image(decoder, scale, region, buffer);
+  }
+
+  /**
+   * Decode a JPEG image from memory directly into a `Surface` using the software decoder.
+   *
+   * \param ptr Pointer to data
+   * \param len Length of data
+   * \param dest RGB or RGBA surface to decode into
+   * \param p Position in the surface to place the image
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   *
+   * \return `true` if successful
+   */
+  bool decode_jpeg_buffer(const uint8_t *ptr, uint32_t len, Surface &dest, const Point &p, JPEGScale scale, Rect region) {
+    JPEGDecoder decoder;
+    return decoder.open(ptr, len) && decoder.decode(dest, p, scale, region);
+  }
+
+  /**
+   * Decode a JPEG image from a file directly into a `Surface` using the software decoder.
+   *
+   * \param filename File to decode
+   * \param dest RGB or RGBA surface to decode into
+   * \param p Position in the surface to place the image
+   * \param scale Output scale
+   * \param region Region of the image to decode, in full scale pixels. Empty for the whole image.
+   *
+   * \return `true` if successful
+   */
+  bool decode_jpeg_file(const std::string &filename, Surface &dest, const Point &p, JPEGScale scale, Rect region) {
+    JPEGDecoder decoder;
+    return decoder.open(filename) && decoder.decode(dest, p, scale, region);
+  }
+}
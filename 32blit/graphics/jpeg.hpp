@@ -1,17 +1,97 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 
+#include "../types/point.hpp"
+#include "../types/rect.hpp"
 #include "../types/size.hpp"
 
 namespace blit {
+  struct Surface;
+
   struct JPEGImage {
     blit::Size size;
     /// Raw RGB image data
     uint8_t *data;
   };
 
+  /// Output scale for software decoding, applied during the IDCT
+  enum class JPEGScale : uint8_t {
+    full    = 0,
+    half    = 1,
+    quarter = 2,
+    eighth  = 3
+  };
+
+  enum class JPEGDecodeStatus {
+    error,
+    in_progress,
+    done
+  };
+
+  /**
+   * Receives decoded RGB data from a `JPEGDecoder`.
+   *
+   * \param data Pointer to the first pixel of `rect`
+   * \param row_stride Size of a row of `data` in bytes
+   * \param rect Part of the output that was decoded
+   */
+  using JPEGRowCallback = std::function<void(const uint8_t *data, int row_stride, const Rect &rect)>;
+
+  struct JPEGDecodeState;
+
+  /**
+   * Software decoder for baseline JPEG images.
+   *
+   * Can decode at a reduced scale and/or only a region of the image, writing
+   * directly to caller-provided memory, a `Surface` or a callback.
+   *
+   * Files are streamed in small chunks and decoding can be split over multiple
+   * frames with `begin`/`step`, so memory use is bounded by the decoder state
+   * (about 13KB) plus the output.
+   */
+  class JPEGDecoder final {
+  public:
+    JPEGDecoder();
+    ~JPEGDecoder();
+
+    bool open(const uint8_t *ptr, uint32_t len);
+    bool open(const std::string &filename);
+    void close();
+
+    /** \returns size of the full image in pixels */
+    Size get_size() const {return size;}
+    Size get_output_size(JPEGScale scale = JPEGScale::full, Rect region = Rect()) const;
+
+    bool decode(uint8_t *out, uint32_t row_stride, JPEGScale scale = JPEGScale::full, Rect region = Rect());
+    bool decode(Surface &dest, const Point &p, JPEGScale scale = JPEGScale::full, Rect region = Rect());
+    bool decode(JPEGRowCallback callback, JPEGScale scale = JPEGScale::full, Rect region = Rect());
+
+    bool begin(uint8_t *out, uint32_t row_stride, JPEGScale scale = JPEGScale::full, Rect region = Rect());
+    bool begin(Surface &dest, const Point &p, JPEGScale scale = JPEGScale::full, Rect region = Rect());
+    bool begin(JPEGRowCallback callback, JPEGScale scale = JPEGScale::full, Rect region = Rect());
+    JPEGDecodeStatus step(uint32_t time_budget_us = 0);
+    bool finish();
+
+  private:
+    Rect output_rect(JPEGScale scale, Rect region) const;
+    bool begin_rect(uint8_t *out, int pixel_stride, int row_stride, JPEGScale scale, const Rect &out_rect);
+    void end_decode();
+    bool decode_mcu_row();
+
+    std::unique_ptr<JPEGDecodeState> state;
+    Size size;
+  };
+
   JPEGImage decode_jpeg_buffer(const uint8_t *ptr, uint32_t len);
   JPEGImage decode_jpeg_file(const std::string &filename);
-}
\ No newline at end of file
+
+  JPEGImage decode_jpeg_buffer(const uint8_t *ptr, uint32_t len, JPEGScale scale, Rect region = Rect(), uint8_t *buffer = nullptr);
+  JPEGImage decode_jpeg_file(const std::string &filename, JPEGScale scale, Rect region = Rect(), uint8_t *buffer = nullptr);
+
+  bool decode_jpeg_buffer(const uint8_t *ptr, uint32_t len, Surface &dest, const Point &p, JPEGScale scale = JPEGScale::full, Rect region = Rect());
+  bool decode_jpeg_file(const std::string &filename, Surface &dest, const Point &p, JPEGScale scale = JPEGScale::full, Rect region = Rect());
+}
@@ -6,6 +6,7 @@
 #include <cmath>
 #include <cfloat>
 
+#include "../engine/jobs.hpp"
 #include "../math/interpolation.hpp"
 #include "mode7.hpp"
 
@@ -105,18 +106,32 @@ namespace blit {
    * \param[in] viewport
    */
   void mode7(Surface *dest, Surface *sprites, MapLayer *layer, float fov, float angle, Vec2 pos, float near, float far, Rect viewport) {
-    for (int y = viewport.y; y < viewport.y + viewport.h; y++) {
-      Vec2 swc = screen_to_world(Vec2(viewport.x, y), fov, angle, pos, near, far, viewport);
-      Vec2 ewc = screen_to_world(Vec2(viewport.x + viewport.w, y), fov, angle, pos, near, far, viewport);
-
-      layer->mipmap_texture_span(
-        dest,
-        Point(viewport.x, y),
-        viewport.w,
-        sprites,
-        swc,
-        ewc);
-    }
+    // drawn in bands of rows which can be spread over the job workers, each with its own copy
+    // of the surface as drawing the spans changes its alpha
+    Surface base = *dest;
+    uint8_t end_alpha = dest->alpha;
+
+    jobs::parallel_for(viewport.y, viewport.y + viewport.h, [&](uint32_t y_begin, uint32_t y_end) {
+      Surface band = base;
+
+      for (int y = y_begin; y < int(y_end); y++) {
+        Vec2 swc = screen_to_world(Vec2(viewport.x, y), fov, angle, pos, near, far, viewport);
+        Vec2 ewc = screen_to_world(Vec2(viewport.x + viewport.w, y), fov, angle, pos, near, far, viewport);
+
+        layer->mipmap_texture_span(
+          &band,
+          Point(viewport.x, y),
+          viewport.w,
+          sprites,
+          swc,
+          ewc);
+      }
+
+      if (y_end == uint32_t(viewport.y + viewport.h))
+        end_alpha = band.alpha;
+    }, 8);
+
+    dest->alpha = end_alpha;
 
     Vec2 s = world_to_screen(Vec2(400, 400), fov, angle, pos, near, far, viewport);
     dest->pen = Pen(255, 0, 255);
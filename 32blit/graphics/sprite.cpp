@@ -1,7 +1,9 @@
 /*! \file sprite.cpp
     \brief Functions for drawing sprites.
 */
+#include <algorithm>
 #include <cstring>
+#include <vector>
 
 #include "surface.hpp"
 #include "sprite.hpp"
@@ -29,6 +31,243 @@ namespace blit {
     cols = bounds.w / 8;
   }
 
+  /**
+   * Pixel source and cell cache for a lazily decoded spritesheet.
+   *
+   * Cells are decoded from the packed/raw/RLE image on first use into a
+   * fixed number of cache slots. The least recently used slot is reused
+   * when the cache is full.
+   */
+  struct LazySpriteSource {
+    // run-length decoder state at the first pixel of each image row
+    struct RLERow {
+      uint32_t bit;       // bit offset of the next token
+      uint16_t run_left;  // pixels remaining in the current run
+      uint8_t run_col;    // colour of the current run
+    };
+
+    static constexpr uint16_t no_slot = 0xffff;
+
+    File file;
+    packed_image image;
+    uint32_t data_offset = 0;   // offset to the pixel data
+    uint8_t bit_depth = 0;
+    bool is_raw = false, is_rle = false;
+    Pen palette[256];
+
+    uint8_t cell_size = 8;
+    uint16_t cell_cols = 0, cell_rows = 0;
+    uint8_t pixel_stride = 1;
+    bool expand = false;        // expand palette indices to colours
+
+    uint8_t *cache = nullptr;
+    uint16_t cache_cells = 0;
+
+    std::vector<uint16_t> cell_slot;          // per cell, the slot holding it
+    std::vector<uint32_t> slot_cell;          // per slot, the cell it holds
+    std::vector<uint16_t> lru_prev, lru_next; // slot recency list
+    uint16_t lru_head = no_slot, lru_tail = no_slot;
+
+    std::vector<RLERow> rle_rows;
+
+    SpriteCacheStats stats;
+
+    // bit reader state (reads through a small window for non-memory files)
+    uint32_t bit = 0;
+    uint8_t window[64];
+    uint32_t window_start = 0, window_len = 0;
+
+    ~LazySpriteSource() {
+      delete[] cache;
+    }
+
+    uint8_t read_byte(uint32_t offset) {
+      if(file.get_ptr())
+        return file.get_ptr()[offset];
+
+      if(offset < window_start || offset >= window_start + window_len) {
+        window_start = offset;
+        auto read = file.read(offset, sizeof(window), (char *)window);
+        window_len = read < 0 ? 0 : read;
+
+        if(!window_len)
+          return 0;
+      }
+
+      return window[offset - window_start];
+    }
+
+    uint8_t read_bits(uint8_t count) {
+      uint8_t ret = 0;
+      while(count--) {
+        uint8_t b = read_byte(data_offset + (bit >> 3));
+        ret = (ret << 1) | ((b >> (7 - (bit & 7))) & 1);
+        bit++;
+      }
+      return ret;
+    }
+
+    // reads a run token, returns the number of pixels in the run
+    uint16_t read_run(uint8_t &col) {
+      uint16_t count = 0;
+      if(read_bits(1))
+        count = read_bits(8);
+
+      col = read_bits(bit_depth);
+      return count + 1;
+    }
+
+    void build_rle_index() {
+      rle_rows.resize(image.height);
+
+      uint32_t end_bit = (image.byte_count - data_offset) * 8;
+      uint32_t pixel = 0, row_pixel = 0;
+      uint16_t row = 0;
+
+      bit = 0;
+      while(row < image.height && bit < end_bit) {
+        uint8_t col;
+        uint16_t count = read_run(col);
+
+        // record every row that starts inside this run
+        while(row < image.height && row_pixel < pixel + count) {
+          rle_rows[row] = {bit, uint16_t(pixel + count - row_pixel), col};
+          row++;
+          row_pixel += image.width;
+        }
+
+        pixel += count;
+      }
+
+      // truncated data, remaining rows decode as zero
+      for(; row < image.height; row++)
+        rle_rows[row] = {end_bit, 0, 0};
+    }
+
+    void write_pixel(uint8_t *&dest, uint8_t col) {
+      if(expand)
+        memcpy(dest, &palette[col], pixel_stride);
+      else
+        *dest = col;
+
+      dest += pixel_stride;
+    }
+
+    void decode_cell(uint32_t cell, uint8_t *dest) {
+      int x0 = (cell % cell_cols) * cell_size;
+      int y0 = (cell / cell_cols) * cell_size;
+      int count = std::min(int(cell_size), image.width - x0);
+
+      memset(dest, 0, cell_size * cell_size * pixel_stride);
+
+      for(int y = y0; y < std::min(y0 + cell_size, int(image.height)); y++, dest += cell_size * pixel_stride) {
+        uint8_t *out = dest;
+
+        if(is_raw) {
+          file.read(data_offset + (y * image.width + x0) * pixel_stride, count * pixel_stride, (char *)out);
+        } else if(is_rle) {
+          auto &row = rle_rows[y];
+          bit = row.bit;
+
+          uint16_t run_left = row.run_left;
+          uint8_t col = row.run_col;
+
+          for(int x = 0; x < x0 + count; x++) {
+            if(!run_left)
+              run_left = read_run(col);
+
+            run_left--;
+
+            if(x >= x0)
+              write_pixel(out, col);
+          }
+        } else {
+          bit = (y * image.width + x0) * bit_depth;
+
+          for(int x = 0; x < count; x++)
+            write_pixel(out, read_bits(bit_depth));
+        }
+      }
+    }
+
+    void lru_unlink(uint16_t slot) {
+      if(lru_prev[slot] != no_slot)
+        lru_next[lru_prev[slot]] = lru_next[slot];
+      else
+        lru_head = lru_next[slot];
+
+      if(lru_next[slot] != no_slot)
+        lru_prev[lru_next[slot]] = lru_prev[slot];
+      else
+        lru_tail = lru_prev[slot];
+    }
+
+    void lru_push_front(uint16_t slot) {
+      lru_prev[slot] = no_slot;
+      lru_next[slot] = lru_head;
+
+      if(lru_head != no_slot)
+        lru_prev[lru_head] = slot;
+      else
+        lru_tail = slot;
+
+      lru_head = slot;
+    }
+
+    void flush() {
+      std::fill(cell_slot.begin(), cell_slot.end(), no_slot);
+      std::fill(slot_cell.begin(), slot_cell.end(), UINT32_MAX);
+
+      // all slots free, in order
+      lru_head = lru_tail = no_slot;
+      for(int slot = cache_cells - 1; slot >= 0; slot--)
+        lru_push_front(slot);
+    }
+
+    uint16_t lookup(uint32_t cell) {
+      uint16_t slot = cell_slot[cell];
+
+      if(slot != no_slot) {
+        stats.hits++;
+
+        if(slot != lru_head) {
+          lru_unlink(slot);
+          lru_push_front(slot);
+        }
+        return slot;
+      }
+
+      stats.misses++;
+
+      // reuse the least recently used slot
+      slot = lru_tail;
+      if(slot_cell[slot] != UINT32_MAX) {
+        cell_slot[slot_cell[slot]] = no_slot;
+        stats.evictions++;
+      }
+
+      decode_cell(cell, cache + slot * cell_size * cell_size * pixel_stride);
+
+      slot_cell[slot] = cell;
+      cell_slot[cell] = slot;
+
+      lru_unlink(slot);
+      lru_push_front(slot);
+
+      return slot;
+    }
+  };
+
+  SpriteSheet::SpriteSheet(uint8_t *cache, PixelFormat format, const Size &cache_bounds, std::unique_ptr<LazySpriteSource> source) : Surface(cache, format, cache_bounds), lazy(std::move(source)) {
+    rows = lazy->image.height / 8;
+    cols = lazy->image.width / 8;
+
+    if(format == PixelFormat::P)
+      palette = lazy->palette;
+  }
+
+  SpriteSheet::~SpriteSheet() = default;
+
   SpriteSheet *SpriteSheet::load(const uint8_t *data, uint8_t *buffer) {
     return load((packed_image *)data, buffer);
   }
@@ -63,6 +302,164 @@ namespace blit {
     return new SpriteSheet(buffer, (PixelFormat)image.format, file);
   }
 
+  /**
+   * Create a lazily decoded spritesheet from packaged data.
+   *
+   * Instead of decoding the whole image up front, cells of `cell_size` x `cell_size`
+   * pixels are decoded on first use into a cache of `cache_cells` cells. When the
+   * cache is full the least recently used cell is evicted.
+   *
+   * Lazy sheets can be drawn with the `Surface::sprite` functions, but not used as
+   * a texture for `TileMap` or `Map`.
+   *
+   * \param[in] data pointer to an image asset
+   * \param[in] cache_cells number of cells to keep decoded
+   * \param[in] cell_size width/height of a cell in pixels
+   * \return `SpriteSheet` or `nullptr` if the image was invalid
+   */
+  SpriteSheet *SpriteSheet::load_lazy(const uint8_t *data, uint16_t cache_cells, uint8_t cell_size) {
+    return load_lazy((const packed_image *)data, cache_cells, cell_size);
+  }
+
+  /**
+   * \overload
+   *
+   * \param[in] image
+   * \param[in] cache_cells
+   * \param[in] cell_size
+   */
+  SpriteSheet *SpriteSheet::load_lazy(const packed_image *image, uint16_t cache_cells, uint8_t cell_size) {
+    File file;
+    file.open((const uint8_t *)image, image->byte_count);
+    return load_lazy(file, cache_cells, cell_size);
+  }
+
+  /**
+   * \overload
+   *
+   * The file is kept open for the lifetime of the sheet.
+   *
+   * \param[in] filename string filename
+   * \param[in] cache_cells
+   * \param[in] cell_size
+   */
+  SpriteSheet *SpriteSheet::load_lazy(const std::string &filename, uint16_t cache_cells, uint8_t cell_size) {
+    File file;
+
+    if(!file.open(filename, OpenMode::read))
+      return nullptr;
+
+    return load_lazy(file, cache_cells, cell_size);
+  }
+
+  SpriteSheet *SpriteSheet::load_lazy(File &file, uint16_t cache_cells, uint8_t cell_size) {
+    if(!cache_cells || cache_cells == LazySpriteSource::no_slot || !cell_size)
+      return nullptr;
+
+    auto source = std::unique_ptr<LazySpriteSource>(new LazySpriteSource);
+    auto &image = source->image;
+
+    if(file.read(0, sizeof(packed_image), (char *)&image) != sizeof(packed_image))
+      return nullptr;
+
+    if(memcmp(image.type, "SPRITEPK", 8) != 0 && memcmp(image.type, "SPRITERW", 8) != 0 && memcmp(image.type, "SPRITERL", 8) != 0)
+      return nullptr;
+
+    if(image.format > (uint8_t)PixelFormat::M)
+      return nullptr;
+
+    auto format = (PixelFormat)image.format;
+
+    int palette_entry_count = image.palette_entry_count;
+    if(palette_entry_count == 0)
+      palette_entry_count = 256;
+
+    source->is_raw = image.type[6] == 'R' && image.type[7] == 'W';
+    source->is_rle = image.type[6] == 'R' && image.type[7] == 'L';
+    source->bit_depth = 1;
+    while((1 << source->bit_depth) < palette_entry_count)
+      source->bit_depth++;
+
+    // same layout as Surface::load_from_packed
+    source->data_offset = sizeof(packed_image);
+    if(format == PixelFormat::P || !source->is_raw) {
+      file.read(source->data_offset, palette_entry_count * 4, (char *)source->palette);
+      source->data_offset += palette_entry_count * 4;
+    }
+
+    source->file = std::move(file);
+
+    source->cell_size = cell_size;
+    source->cell_cols = (image.width + cell_size - 1) / cell_size;
+    source->cell_rows = (image.height + cell_size - 1) / cell_size;
+    source->pixel_stride = pixel_format_stride[image.format];
+    source->expand = !source->is_raw && format != PixelFormat::P;
+
+    source->cache_cells = cache_cells;
+    source->cache = new uint8_t[cache_cells * cell_size * cell_size * source->pixel_stride];
+
+    source->cell_slot.resize(source->cell_cols * source->cell_rows);
+    source->slot_cell.resize(cache_cells);
+    source->lru_prev.resize(cache_cells);
+    source->lru_next.resize(cache_cells);
+    source->flush();
+
+    if(source->is_rle)
+      source->build_rle_index();
+
+    auto cache = source->cache;
+    return new SpriteSheet(cache, format, Size(cell_size, cell_size * cache_cells), std::move(source));
+  }
+
+  /**
+   * \returns size in pixels of the cells a lazy sheet is decoded in, 8 for other sheets
+   */
+  uint8_t SpriteSheet::cell_size() const {
+    return lazy ? lazy->cell_size : 8;
+  }
+
+  /**
+   * Decode a cell of a lazy sheet if needed and mark it as most recently used.
+   *
+   * The returned rect is only valid until the next call, as the cell may be
+   * evicted to make room for another.
+   *
+   * \param[in] col column of the cell (in cells)
+   * \param[in] row row of the cell (in cells)
+   * \return `rect` of the cell in the sheet's cache surface or an empty `rect` if out of range
+   */
+  Rect SpriteSheet::cached_cell(uint16_t col, uint16_t row) {
+    if(!lazy || col >= lazy->cell_cols || row >= lazy->cell_rows)
+      return Rect();
+
+    uint16_t slot = lazy->lookup(col + row * lazy->cell_cols);
+    return Rect(0, slot * lazy->cell_size, lazy->cell_size, lazy->cell_size);
+  }
+
+  /**
+   * \returns cache hit/miss statistics for a lazy sheet
+   */
+  const SpriteCacheStats &SpriteSheet::get_cache_stats() const {
+    static const SpriteCacheStats no_stats;
+    return lazy ? lazy->stats : no_stats;
+  }
+
+  /**
+   * Reset the cache hit/miss statistics
+   */
+  void SpriteSheet::reset_cache_stats() {
+    if(lazy)
+      lazy->stats = SpriteCacheStats();
+  }
+
+  /**
+   * Discard all decoded cells, for example on a level transition
+   */
+  void SpriteSheet::flush_cache() {
+    if(lazy)
+      lazy->flush();
+  }
+
   /**
    * Return the bounds of a sprite by index
    * 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "surface.hpp"
 
 namespace blit {
@@ -25,19 +27,49 @@ namespace blit {
     R270 = 0b110
   };
 
+  struct SpriteCacheStats {
+    uint32_t hits = 0;        // cell lookups served from the cache
+    uint32_t misses = 0;      // cell lookups that required decoding
+    uint32_t evictions = 0;   // cells discarded to make room for another
+  };
+
+  struct LazySpriteSource;
+
   struct SpriteSheet : Surface {
     uint16_t  rows, cols;
 
     SpriteSheet(uint8_t *data, PixelFormat format, const packed_image *image);
     SpriteSheet(uint8_t *data, PixelFormat format, File &image);
+    ~SpriteSheet();
 
     static SpriteSheet *load(const uint8_t *data, uint8_t *buffer = nullptr);
     static SpriteSheet *load(const packed_image *image, uint8_t *buffer = nullptr);
     static SpriteSheet *load(const std::string& filename, uint8_t* buffer = nullptr);
 
+    static SpriteSheet *load_lazy(const uint8_t *data, uint16_t cache_cells = 64, uint8_t cell_size = 8);
+    static SpriteSheet *load_lazy(const packed_image *image, uint16_t cache_cells = 64, uint8_t cell_size = 8);
+    static SpriteSheet *load_lazy(const std::string &filename, uint16_t cache_cells = 64, uint8_t cell_size = 8);
+
     Rect sprite_bounds(uint16_t index);          
     Rect sprite_bounds(const Point &p);
     Rect sprite_bounds(const Rect &r);
+
+    /** \returns `true` if the sheet decodes cells on demand (see @ref load_lazy) */
+    bool is_lazy() const { return lazy != nullptr; }
+
+    uint8_t cell_size() const;
+    Rect cached_cell(uint16_t col, uint16_t row);
+
+    const SpriteCacheStats &get_cache_stats() const;
+    void reset_cache_stats();
+    void flush_cache();
+
+  private:
+    SpriteSheet(uint8_t *cache, PixelFormat format, const Size &cache_bounds, std::unique_ptr<LazySpriteSource> source);
+
+    static SpriteSheet *load_lazy(File &file, uint16_t cache_cells, uint8_t cell_size);
+
+    std::unique_ptr<LazySpriteSource> lazy;
   };
 
 } 
\ No newline at end of file
@@ -9,6 +9,7 @@
 #include "surface.hpp"
 
 #include "../engine/file.hpp"
+#include "../engine/jobs.hpp"
 
 using namespace blit;
 
@@ -245,33 +246,34 @@ namespace blit {
       Surface *dest = new Surface(mipmap_data, PixelFormat::RGBA, Size(w, h));
       mipmaps.push_back(dest);
       
-      for (int y = 0; y < h; y++) {      
-        for (int x = 0; x < w; x++) {
-          // sample the average ARGB values
-          Pen *c1, *c2, *c3, *c4;
-          if (src->format == PixelFormat::P) {
-            c1 = &src->palette[*src->ptr(Point(x * 2, y * 2))];
-            c2 = &src->palette[*src->ptr(Point(x * 2 + 1, y * 2))];
-            c3 = &src->palette[*src->ptr(Point(x * 2 + 1, y * 2 + 1))];
-            c4 = &src->palette[*src->ptr(Point(x * 2, y * 2 + 1))];
-          }
-          else {
-            c1 = (Pen *)(src->ptr(Point(x * 2, y * 2)));
-            c2 = (Pen *)(src->ptr(Point(x * 2 + 1, y * 2)));
-            c3 = (Pen *)(src->ptr(Point(x * 2 + 1, y * 2 + 1)));
-            c4 = (Pen *)(src->ptr(Point(x * 2, y * 2 + 1)));
-          }
+      // rows are independent, so they can be spread over the job workers
+      jobs::parallel_for(0, h, [src, dest, w](uint32_t y_begin, uint32_t y_end) {
+        for (int y = y_begin; y < int(y_end); y++) {
+          for (int x = 0; x < w; x++) {
+            // sample the average ARGB values
+            Pen *c1, *c2, *c3, *c4;
+            if (src->format == PixelFormat::P) {
+              c1 = &src->palette[*src->ptr(Point(x * 2, y * 2))];
+              c2 = &src->palette[*src->ptr(Point(x * 2 + 1, y * 2))];
+              c3 = &src->palette[*src->ptr(Point(x * 2 + 1, y * 2 + 1))];
+              c4 = &src->palette[*src->ptr(Point(x * 2, y * 2 + 1))];
+            }
+            else {
+              c1 = (Pen *)(src->ptr(Point(x * 2, y * 2)));
+              c2 = (Pen *)(src->ptr(Point(x * 2 + 1, y * 2)));
+              c3 = (Pen *)(src->ptr(Point(x * 2 + 1, y * 2 + 1)));
+              c4 = (Pen *)(src->ptr(Point(x * 2, y * 2 + 1)));
+            }
 
-          uint8_t a = (c1->a + c2->a + c3->a + c4->a) / 4;
-          uint8_t r = (c1->r + c2->r + c3->r + c4->r) / 4;
-          uint8_t g = (c1->g + c2->g + c3->g + c4->g) / 4;
-          uint8_t b = (c1->b + c2->b + c3->b + c4->b) / 4;          
-          a = 255;
+            uint8_t r = (c1->r + c2->r + c3->r + c4->r) / 4;
+            uint8_t g = (c1->g + c2->g + c3->g + c4->g) / 4;
+            uint8_t b = (c1->b + c2->b + c3->b + c4->b) / 4;
 
-          dest->pen = Pen(r, g, b, a);
-          dest->pixel(Point(x, y));
+            // written directly as the pen is shared between threads, same as drawing an opaque pixel
+            *(Pen *)dest->ptr(Point(x, y)) = Pen(r, g, b, 255);
+          }
         }
-      }
+      }, 8);
 
       src = dest;    
       mipmap_data += (src->row_stride * src->bounds.h);
@@ -286,6 +288,13 @@ namespace blit {
    * \param t
    */
   void Surface::blit_sprite(const Rect &sprite, const Point &p, uint8_t t) {
+    if (sprites->is_lazy())
+      blit_lazy_sprite(sprite, Rect(p.x, p.y, sprite.w, sprite.h), t, false);
+    else
+      blit_sprite_direct(sprite, p, t);
+  }
+
+  void Surface::blit_sprite_direct(const Rect &sprite, const Point &p, uint8_t t) {
     Rect dr = clip.intersection(Rect(p.x, p.y, sprite.w, sprite.h));  // clipped destination rect
 
     if (dr.empty())
@@ -341,6 +350,13 @@ namespace blit {
    * \param t
    */
   void Surface::stretch_blit_sprite(const Rect &sprite, const Rect &r, uint8_t t) {
+    if (sprites->is_lazy())
+      blit_lazy_sprite(sprite, r, t, true);
+    else
+      stretch_blit_sprite_direct(sprite, r, t);
+  }
+
+  void Surface::stretch_blit_sprite_direct(const Rect &sprite, const Rect &r, uint8_t t) {
     Rect dr = clip.intersection(r);  // clipped destination rect
 
     if (dr.empty())
@@ -392,6 +408,58 @@ namespace blit {
     } while (--y_count);
   }
 
+  /**
+   * Blit a sprite from a lazily decoded spritesheet
+   *
+   * The sprite is split into the sheet's cells, each cell is fetched from
+   * (or decoded into) the sheet's cache and drawn at its transformed
+   * position. As with unsplit sprites, XYSWAP expects square cells.
+   *
+   * \param sprite source rect in sheet pixels
+   * \param r destination rect (size is ignored unless stretching)
+   * \param t
+   * \param stretch `true` to scale the sprite to `r`
+   */
+  void Surface::blit_lazy_sprite(const Rect &sprite, const Rect &r, uint8_t t, bool stretch) {
+    if (sprite.empty() || clip.intersection(r).empty())
+      return;
+
+    int32_t cs = sprites->cell_size();
+
+    for (int32_t cy = sprite.y / cs; cy * cs < sprite.y + sprite.h; cy++) {
+      for (int32_t cx = sprite.x / cs; cx * cs < sprite.x + sprite.w; cx++) {
+        Rect sub = sprite.intersection(Rect(cx * cs, cy * cs, cs, cs));
+
+        // position of this part within the sprite
+        int32_t ox = sub.x - sprite.x, oy = sub.y - sprite.y;
+        int32_t dx = (t & SpriteTransform::HORIZONTAL) ? sprite.w - ox - sub.w : ox;
+        int32_t dy = (t & SpriteTransform::VERTICAL) ? sprite.h - oy - sub.h : oy;
+        int32_t dw = sub.w, dh = sub.h;
+
+        if (t & SpriteTransform::XYSWAP) {
+          dx = (t & SpriteTransform::HORIZONTAL) ? sprite.w - oy - sub.h : oy;
+          dy = (t & SpriteTransform::VERTICAL) ? sprite.h - ox - sub.w : ox;
+          std::swap(dw, dh);
+        }
+
+        Rect cell = sprites->cached_cell(cx, cy);
+        if (cell.empty())
+          continue;
+
+        Rect src(cell.x + sub.x - cx * cs, cell.y + sub.y - cy * cs, sub.w, sub.h);
+
+        if (stretch) {
+          int32_t x0 = r.x + dx * r.w / sprite.w, x1 = r.x + (dx + dw) * r.w / sprite.w;
+          int32_t y0 = r.y + dy * r.h / sprite.h, y1 = r.y + (dy + dh) * r.h / sprite.h;
+
+          if (x1 > x0 && y1 > y0)
+            stretch_blit_sprite_direct(src, Rect(x0, y0, x1 - x0, y1 - y0), t);
+        } else
+          blit_sprite_direct(src, Point(r.x + dx, r.y + dy), t);
+      }
+    }
+  }
+
   /**
    * Blit another surface to the surface
    *
@@ -113,6 +113,10 @@ namespace blit {
     void init();
     void load_from_packed(File &file);
 
+    void blit_sprite_direct(const Rect &src, const Point &p, uint8_t t);
+    void stretch_blit_sprite_direct(const Rect &src, const Rect &r, uint8_t t);
+    void blit_lazy_sprite(const Rect &src, const Rect &r, uint8_t t, bool stretch);
+
   public:
     Surface(uint8_t *data, const PixelFormat &format, const Size &bounds);
     Surface(uint8_t *data, const PixelFormat &format, const packed_image *image);
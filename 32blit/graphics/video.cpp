@@ -0,0 +1,287 @@
+/*! \file video.cpp
+    \brief Video streaming
+*/
+#include <cstring>
+
+#include "video.hpp"
+#include "surface.hpp"
+#include "../engine/api_private.hpp"
+#include "../engine/engine.hpp"
+
+namespace blit {
+
+  VideoStream::VideoStream() = default;
+
+  VideoStream::~VideoStream() {
+    delete[] frame_buf;
+  }
+
+  /**
+   * Open a video file. Playback starts paused at the first frame.
+   *
+   * \param filename File to load
+   *
+   * \return `true` if the file is a supported video
+   */
+  bool VideoStream::load(std::string filename) {
+    delete[] frame_buf;
+    frame_buf = nullptr;
+    frame_ready = false;
+    playing = false;
+
+    if(!file.open(filename))
+      return false;
+
+    if(file.read(0, sizeof(header), (char *)&header) != sizeof(header))
+      return false;
+
+    if(memcmp(header.type, "BLVD", 4) != 0 || header.format != uint16_t(VideoFormat::mjpeg))
+      return false;
+
+    if(!header.frame_rate_num || !header.frame_rate_den || !header.frame_count)
+      return false;
+
+    frame_buf = new uint8_t[header.max_frame_size];
+
+    rewind();
+
+    return frame_ready;
+  }
+
+  /**
+   * Start (or resume) playback using the stream's own clock.
+   */
+  void VideoStream::play() {
+    if(playing)
+      return;
+
+    start_time = blit::now() - pause_time;
+    playing = true;
+  }
+
+  /**
+   * Pause playback using the stream's own clock.
+   */
+  void VideoStream::pause() {
+    if(!playing)
+      return;
+
+    pause_time = blit::now() - start_time;
+    playing = false;
+  }
+
+  /**
+   * Go back to the first frame.
+   */
+  void VideoStream::rewind() {
+    file_offset = sizeof(header);
+    next_record = 0;
+    current_frame = 0;
+
+    start_time = blit::now();
+    pause_time = 0;
+
+    read_frame();
+  }
+
+  /** \returns `true` if playing using the stream's own clock */
+  bool VideoStream::get_playing() const {
+    return playing;
+  }
+
+  /**
+   * Set if the video should restart from the beginning after the last frame.
+   *
+   * \param loop Enable looping
+   */
+  void VideoStream::set_loop(bool loop) {
+    this->loop = loop;
+  }
+
+  /**
+   * Show the frame for the current time of the stream's own clock. See `play`.
+   *
+   * \param dest RGB or RGBA surface to decode into
+   * \param p Position in the surface to place the frame
+   *
+   * \return `true` if a new frame was decoded
+   */
+  bool VideoStream::update(Surface &dest, const Point &p) {
+    if(!playing)
+      return false;
+
+    uint32_t time_ms = get_time_ms();
+
+    if(time_ms >= get_duration_ms()) {
+      if(!loop) {
+        pause();
+        return false;
+      }
+
+      // wrap the clock back to the start
+      start_time += time_ms - time_ms % get_duration_ms();
+      time_ms = get_time_ms();
+    }
+
+    return update(time_ms, dest, p);
+  }
+
+  /**
+   * Show the frame for a time from an external clock. Use the play position of an
+   * audio stream to keep the video in sync with it, for example:
+   *
+   *     video.update(uint64_t(audio.get_current_sample()) * 1000 / sample_rate, screen);
+   *
+   * If the frame for the time has already been shown nothing is decoded. If frames have
+   * been missed they are skipped, so slow decoding never lets the video fall behind the clock.
+   *
+   * \param time_ms Time from the start of the video
+   * \param dest RGB or RGBA surface to decode into
+   * \param p Position in the surface to place the frame
+   *
+   * \return `true` if a new frame was decoded
+   */
+  bool VideoStream::update(uint32_t time_ms, Surface &dest, const Point &p) {
+    if(!frame_buf)
+      return false;
+
+    uint32_t target = frame_at(time_ms);
+
+    if(target >= header.frame_count) {
+      if(!loop)
+        target = header.frame_count - 1;
+      else
+        target %= header.frame_count;
+    }
+
+    // clock went backwards (or looped), start again
+    if(target + 1 < current_frame)
+      rewind();
+
+    // already shown
+    if(target + 1 == current_frame || !frame_ready)
+      return false;
+
+    // drop frames we are too late for
+    if(target > buffered_frame) {
+      frames_dropped += target - buffered_frame;
+
+      while(next_record < target) {
+        if(!skip_frame())
+          return false;
+      }
+
+      if(!read_frame())
+        return false;
+    }
+
+    return decode_next(dest, p);
+  }
+
+  /**
+   * Decode the next frame immediately, ignoring the clock.
+   *
+   * \param dest RGB or RGBA surface to decode into
+   * \param p Position in the surface to place the frame
+   *
+   * \return `true` if a frame was decoded
+   */
+  bool VideoStream::decode_next(Surface &dest, const Point &p) {
+    if(!frame_ready)
+      return false;
+
+    uint32_t start_us = now_us();
+
+    bool ret = decoder.open(frame_buf, frame_len) && decoder.decode(dest, p);
+
+    decode_us = us_diff(start_us, now_us());
+    frames_decoded++;
+    current_frame = buffered_frame + 1;
+
+    // read ahead so the next update only needs to decode
+    read_frame();
+
+    return ret;
+  }
+
+  /** \returns size of the video in pixels */
+  Size VideoStream::get_size() const {
+    return Size(header.width, header.height);
+  }
+
+  /** \returns number of frames in the video */
+  uint32_t VideoStream::get_frame_count() const {
+    return header.frame_count;
+  }
+
+  /** \returns index of the last frame shown */
+  uint32_t VideoStream::get_current_frame() const {
+    return current_frame ? current_frame - 1 : 0;
+  }
+
+  /** \returns length of the video in milliseconds */
+  uint32_t VideoStream::get_duration_ms() const {
+    if(!header.frame_rate_num)
+      return 0;
+
+    return uint64_t(header.frame_count) * 1000 * header.frame_rate_den / header.frame_rate_num;
+  }
+
+  /** \returns current time of the stream's own clock */
+  uint32_t VideoStream::get_time_ms() const {
+    return playing ? blit::now() - start_time : pause_time;
+  }
+
+  /** \returns number of frames decoded since loading */
+  uint32_t VideoStream::get_frames_decoded() const {
+    return frames_decoded;
+  }
+
+  /** \returns number of frames skipped to keep up with the clock */
+  uint32_t VideoStream::get_frames_dropped() const {
+    return frames_dropped;
+  }
+
+  /** \returns time taken to decode the last frame, in microseconds */
+  uint32_t VideoStream::get_decode_us() const {
+    return decode_us;
+  }
+
+  uint32_t VideoStream::frame_at(uint32_t time_ms) const {
+    return uint64_t(time_ms) * header.frame_rate_num / (1000 * header.frame_rate_den);
+  }
+
+  // reads the next frame into the read-ahead buffer
+  bool VideoStream::read_frame() {
+    frame_ready = false;
+
+    if(next_record >= header.frame_count)
+      return false;
+
+    uint32_t len;
+    if(file.read(file_offset, 4, (char *)&len) != 4 || len > header.max_frame_size)
+      return false;
+
+    if(file.read(file_offset + 4, len, (char *)frame_buf) != int32_t(len))
+      return false;
+
+    file_offset += 4 + len;
+    frame_len = len;
+    buffered_frame = next_record++;
+    frame_ready = true;
+
+    return true;
+  }
+
+  // skips over the next frame without reading it
+  bool VideoStream::skip_frame() {
+    uint32_t len;
+    if(next_record >= header.frame_count || file.read(file_offset, 4, (char *)&len) != 4)
+      return false;
+
+    file_offset += 4 + len;
+    next_record++;
+
+    return true;
+  }
+}
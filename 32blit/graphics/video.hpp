@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "jpeg.hpp"
+#include "../engine/file.hpp"
+#include "../types/point.hpp"
+#include "../types/size.hpp"
+
+namespace blit {
+  struct Surface;
+
+  /// Frame encoding of a video file
+  enum class VideoFormat : uint16_t {
+    mjpeg = 0 ///< each frame is a baseline JPEG image
+  };
+
+#pragma pack(push, 1)
+  /**
+   * Header of a video file (all values little-endian), followed by `frame_count` frames.
+   * Each frame is a 32 bit length followed by the frame data.
+   */
+  struct packed_video {
+    uint8_t type[4];         ///< "BLVD"
+    uint16_t format;         ///< see ::VideoFormat
+    uint16_t width;
+    uint16_t height;
+    uint16_t frame_rate_num; ///< frame rate as a fraction, in frames per second
+    uint16_t frame_rate_den;
+    uint16_t reserved;
+    uint32_t frame_count;
+    uint32_t max_frame_size; ///< largest frame, used to size the read-ahead buffer
+  };
+#pragma pack(pop)
+
+  /**
+   * Streams video frames from a file, decoding straight into a `Surface`.
+   *
+   * Frames are shown according to a clock, which can be the stream's own timer or
+   * an external one such as the play position of an `MP3Stream`. If decoding falls
+   * behind the clock, frames are dropped to catch up.
+   */
+  class VideoStream final {
+  public:
+    VideoStream();
+    ~VideoStream();
+
+    bool load(std::string filename);
+
+    void play();
+    void pause();
+    void rewind();
+
+    bool get_playing() const;
+    void set_loop(bool loop);
+
+    bool update(Surface &dest, const Point &p = Point(0, 0));
+    bool update(uint32_t time_ms, Surface &dest, const Point &p = Point(0, 0));
+    bool decode_next(Surface &dest, const Point &p = Point(0, 0));
+
+    Size get_size() const;
+    uint32_t get_frame_count() const;
+    uint32_t get_current_frame() const;
+    uint32_t get_duration_ms() const;
+    uint32_t get_time_ms() const;
+
+    uint32_t get_frames_decoded() const;
+    uint32_t get_frames_dropped() const;
+    uint32_t get_decode_us() const;
+
+  private:
+    uint32_t frame_at(uint32_t time_ms) const;
+    bool read_frame();
+    bool skip_frame();
+
+    // file io
+    blit::File file;
+    uint32_t file_offset = 0;
+
+    packed_video header{};
+
+    // read-ahead, holds the next frame to show
+    uint8_t *frame_buf = nullptr;
+    uint32_t frame_len = 0;
+    uint32_t buffered_frame = 0; // index of the frame in frame_buf
+    uint32_t next_record = 0;    // index of the frame at file_offset
+    bool frame_ready = false;
+
+    JPEGDecoder decoder;
+
+    // timing
+    bool playing = false, loop = false;
+    uint32_t start_time = 0, pause_time = 0;
+    uint32_t current_frame = 0; // last frame shown + 1
+
+    uint32_t frames_decoded = 0, frames_dropped = 0;
+    uint32_t decode_us = 0;
+  };
+}
@@ -59,6 +59,10 @@ void init() {
 }
 
 uint16_t beat = 0;
+uint16_t next_beat = 0;
+uint32_t next_beat_time = 0;
+
+const uint32_t beat_length = sample_rate / 10; // 100ms per beat
 
 void render(uint32_t time_ms) {
   screen.pen = Pen(20, 30, 40, 100);
@@ -84,21 +88,25 @@ void render(uint32_t time_ms) {
 } 
 
 void update(uint32_t time_ms) {
-  static uint16_t tick = 0;
-  static uint16_t prev_beat = 1;
-  beat = (tick / 5) % 384; // 100ms per beat
-  tick++;
-
-  if (beat == prev_beat) return;
-  prev_beat = beat;
-
-  for(uint8_t i = 0; i < 3; i++) {
-    if(notes[i][beat] > 0) {
-      channels[i].frequency = notes[i][beat];
-      channels[i].trigger_attack();
-    } else if (notes[i][beat] == -1) {
-      channels[i].trigger_release();
+  uint32_t audio_time = get_audio_time();
+
+  // start again from now if we fell behind
+  if(int32_t(next_beat_time - audio_time) < 0)
+    next_beat_time = audio_time;
+
+  // queue the notes a beat ahead, so they start at exactly the right sample
+  // no matter when update is called
+  while(int32_t(next_beat_time - audio_time) < int32_t(beat_length)) {
+    for(uint8_t i = 0; i < 3; i++) {
+      if(notes[i][next_beat] > 0)
+        queue_audio_command(next_beat_time, i, AudioCommandType::NOTE_ON, notes[i][next_beat]);
+      else if(notes[i][next_beat] == -1)
+        queue_audio_command(next_beat_time, i, AudioCommandType::NOTE_OFF);
     }
+
+    beat = next_beat;
+    next_beat = (next_beat + 1) % 384;
+    next_beat_time += beat_length;
   }
 }
   
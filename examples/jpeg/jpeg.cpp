@@ -1,6 +1,3 @@
-
-#include <cstring>
-
 #include "jpeg.hpp"
 #include "graphics/jpeg.hpp"
 
@@ -8,24 +5,28 @@
 
 using namespace blit;
 
+JPEGDecoder decoder;
+bool decoding = false;
+
 /* setup */
 void init() {
   set_screen_mode(ScreenMode::hires);
 
   // It's also possible to use decode_jpeg_file to load a file from the SD card
-  JPEGImage jpeg = decode_jpeg_buffer(asset_jpeg, asset_jpeg_length);
-
-  //Surface jpeg_surface(jpeg.data, PixelFormat::RGB, jpeg.size);
-  //screen.blit(&jpeg_surface, Rect(Point(0), jpeg.size), Point(0));
-
-  // Display fullscreen jpeg
-  memcpy(screen.data, jpeg.data, jpeg.size.area() * 3);
+  // Display fullscreen jpeg, decoding straight into the screen
+  decode_jpeg_buffer(asset_jpeg, asset_jpeg_length, screen, Point(0, 0));
 
-  delete[] jpeg.data;
+  // Decode a quarter scale thumbnail of the centre of the image into the corner,
+  // a few rows at a time (decoder.open(filename) would stream it from a file)
+  Rect centre(screen.bounds.w / 4, screen.bounds.h / 4, screen.bounds.w / 2, screen.bounds.h / 2);
+  decoding = decoder.open(asset_jpeg, asset_jpeg_length) && decoder.begin(screen, Point(8, 8), JPEGScale::quarter, centre);
 }
 
 void render(uint32_t time) {
 }
 
 void update(uint32_t time) {
+  // spend at most 1ms per update decoding
+  if(decoding)
+    decoding = decoder.step(1000) == JPEGDecodeStatus::in_progress;
 }
\ No newline at end of file
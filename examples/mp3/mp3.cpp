@@ -14,14 +14,15 @@ MP3Stream stream;
 void init() {
   set_screen_mode(ScreenMode::hires);
 
-  // Files should be encoded as 22050Hz mono, but stereo and/or 44100Hz also work.
-  // (The output is still 22050Hz/mono)
+  // Files encoded as mono at the engine's sample rate (22050Hz by default) are cheapest to play,
+  // stereo is mixed down and other rates are resampled. (The output is always mono at sample_rate)
 
   // It's also possible to load directly from the SD card.
   File::add_buffer_file("example.mp3", asset_mp3, asset_mp3_length);
 
   // Pass false for do_duration_calc if you don't need the duration.
-  // (it requires decoding the entire file, which takes a while if reading from the SD card)
+  // (files without a Xing/VBRI header need to be scanned, which takes a while if reading from the SD card.
+  //  Pass true for cache_index to save the result.)
   stream.load("example.mp3", true);
 
   // Any channel can be used here, the others are free for other sounds.
@@ -38,7 +39,7 @@ void render(uint32_t time) {
   screen.pen = Pen(0, 0, 0);
   screen.text("MP3 Playback", minimal_font, Point(5, 4));
 
-  int play_time = (stream.get_current_sample() * 1000) / 22050;
+  int play_time = (uint64_t(stream.get_current_sample()) * 1000) / sample_rate;
 
   // current time / duration
   screen.pen = Pen(255, 255, 255);
@@ -53,8 +54,23 @@ void render(uint32_t time) {
   screen.pen = Pen(255, 255, 255);
   float w = static_cast<float>(screen.bounds.w - 10) / stream.get_duration_ms() * play_time;
   screen.rectangle(Rect(5, 40, w, 10));
+
+  screen.text("Left/Right: seek, A: restart", minimal_font, Point(5, 60));
 }
 
 void update(uint32_t time) {
+  // decodes more audio on the device (on PC decoding happens in the background)
   stream.update();
+
+  int play_time = (uint64_t(stream.get_current_sample()) * 1000) / sample_rate;
+
+  if(pressed(Button::DPAD_LEFT))
+    stream.seek(std::max(play_time - 10000, 0));
+  else if(pressed(Button::DPAD_RIGHT))
+    stream.seek(play_time + 10000);
+
+  if(pressed(Button::A)) {
+    stream.seek(0);
+    stream.play(0);
+  }
 }
@@ -1,288 +1,201 @@
+// Particle effects example and benchmark
+//
+// Smoke, sparks and rain, each drawn by its own emitter.
+//
+// Button			Function
+// =====================================================
+// A					Run the benchmark
+// B					Toggle between lores and hires
+// DPAD_LEFT	Rotate the rain's gravity
+
 #include <string>
-#include <cstring>
-#include <memory>
 #include <cstdlib>
 
 #include "particle.hpp"
 
 using namespace blit;
 
-
-
-/* setup */
-void init() {
-  blit::set_screen_mode(ScreenMode::hires);
+float random_float(float from, float to) {
+  return from + (std::rand() % 1000) * (to - from) / 1000.0f;
 }
 
-struct test_particle {
-  Vec2 pos;
-  Vec2 vel;
-  int age;
-  bool generated = false;
-};
+ParticleEmitter smoke(150, 4000);
+ParticleEmitter sparks(500, 3000);
+ParticleEmitter rain(400, 4000);
 
+Pen smoke_colours[8], spark_colours[16];
+Pen rain_colour(150, 150, 255, 180);
 
-struct smoke_particle : Particle {
-  float age_boost;
+ParticleStyle smoke_style, spark_style, rain_style;
 
-  smoke_particle(Vec2 pos, Vec2 vel, float age_boost) : Particle(pos, vel), age_boost(age_boost) {};
+// benchmark results, in ns per particle
+const int bench_particles = 4096;
+struct BenchResult {
+  const char *name;
+  uint32_t ns;
 };
-
-Particle* generate_smoke() {
-  return new smoke_particle(
-    Vec2((rand() % 20) - 10, (rand() % 20) - 10),
-    Vec2(((rand() % 40) - 20) / 2, (rand() % 20) - 60),
-    (rand() % 3000) / 3000.0f
-  );
-}
-
-ParticleGenerator smoke_generator(150, 4000, generate_smoke);
-
-void render_smoke() {
-  for (auto p : smoke_generator.particles) {
-    smoke_particle *sp = static_cast<smoke_particle*>(p);
-    float age = sp->age + sp->age_boost;
-    int alpha = (255 - (age * 75.0f)) / 8.0f;
-    int radius = (age * 150.0f) / 16.0f;
-    screen.pen = Pen(255, 255, 255, alpha);
-    screen.circle(p->pos + Point(50, 240), radius);
-  }
-}
-
-
-void smoke_generate(test_particle &p) {
-  p.pos = Vec2((rand() % 20) - 10, (rand() % 20) - 10);
-  p.vel = Vec2(((rand() % 40) - 20) / 2, (rand() % 20) - 60);
-  p.age = rand() % 200;
-  p.generated = true;
+BenchResult bench_results[4]{
+  {"Update", 0},
+  {"Pixels", 0},
+  {"Rects", 0},
+  {"Legacy update", 0},
 };
+bool bench_done = false;
 
-void smoke(uint32_t time_ms) {
-  static test_particle s[150];
-  static int generate_index = 0;
-  static uint32_t last_time_ms = time_ms;
-
-  int elapsed_ms = time_ms - last_time_ms;
-  float td = (elapsed_ms) / 1000.0f;
-
-  smoke_generate(s[generate_index++]);
-  if (generate_index >= 150)
-    generate_index = 0;
+// calls `func` until at least 250ms have passed, returns ns per call per particle
+template<class F>
+uint32_t bench(F func) {
+  uint32_t start = now(), elapsed, calls = 0;
 
-  float w = sinf(time_ms / 1000.0f) * 0.05f;
+  do {
+    func(calls);
+    calls++;
+    elapsed = now() - start;
+  } while(elapsed < 250);
 
-  for (auto &p : s) {
-    if (p.generated) {
-      p.pos += p.vel * td;
-      p.vel += Vec2(w, 0);
-      p.age++;
-
-      int alpha = (255 - (p.age / 2)) / 8.0f;
-      int radius = (p.age) / 16.0f;
-      screen.pen = Pen(255, 255, 255, alpha);
-      screen.circle(p.pos + Point(50, 240), radius);
-    }
-  }
-
-  
-  last_time_ms = time_ms;
-};
+  return uint64_t(elapsed) * 1000000 / (uint64_t(calls) * bench_particles);
+}
 
+void run_benchmark() {
+  ParticleEmitter emitter(bench_particles, 1000000);
+  emitter.force = Vec2(0, 20);
+  emitter.generate = [](Vec2 &pos, Vec2 &vel) {
+    pos = Vec2(random_float(0, screen.bounds.w), random_float(0, screen.bounds.h));
+    vel = Vec2(random_float(-1, 1), random_float(-1, 1));
+  };
+  emitter.burst(bench_particles);
 
-void spark_generate(test_particle &p) {
-  p.pos = Vec2((rand() % 10) - 5, -100);
-  p.vel = Vec2(((rand() % 40) - 20), (rand() % 80) - 70);
-  p.age = 0;// rand() % 255;
-  p.generated = true;
-};
+  // time only advances 1ms per update, so nothing expires or moves far
+  bench_results[0].ns = bench([&emitter](uint32_t i) {emitter.update(i);});
 
-void spark(uint32_t time_ms) {
-  static test_particle s[500];
-  static int generate_index = 0;
-  static uint32_t last_time_ms = time_ms;
+  ParticleStyle style;
+  bench_results[1].ns = bench([&](uint32_t) {emitter.render(screen, Point(0, 0), style);});
 
-  int elapsed_ms = time_ms - last_time_ms;
-  float td = (elapsed_ms) / 1000.0f;
+  style.shape = ParticleShape::RECT;
+  style.size_start = style.size_end = 3;
+  bench_results[2].ns = bench([&](uint32_t) {emitter.render(screen, Point(0, 0), style);});
 
-  spark_generate(s[generate_index++]);
-  if (generate_index >= 500)
-    generate_index = 0;
+  // the old allocating system, filled to the same number of particles
+  ParticleGenerator legacy(bench_particles, 1000000, []() {
+    return new Particle(Vec2(random_float(0, 320), random_float(0, 240)), Vec2(random_float(-1, 1), random_float(-1, 1)));
+  });
+  legacy.force = Vec2(0, 20);
+  for(int i = 0; i < bench_particles; i++)
+    legacy.particles.push_back(legacy.generate());
 
-  float w = sinf(time_ms / 1000.0f) * 0.05f;
+  bench_results[3].ns = bench([&legacy](uint32_t i) {legacy.update(i);});
 
-  Vec2 gravity = Vec2(0, 9.8f * 2) * td;
+  bench_done = true;
+}
 
-  for (auto &p : s) {
-    if (p.generated) {
-      p.vel += gravity;
-      p.pos += p.vel * td;
-      if (p.pos.y > 0)
-        p.vel.y *= -0.7f;
-      p.age++;
+/* setup */
+void init() {
+  set_screen_mode(ScreenMode::hires);
+
+  // smoke rises and spreads out, fading as it grows
+  smoke.rate = 40.0f;
+  smoke.force = Vec2(0, -5);
+  smoke.drag = 0.2f;
+  smoke.generate = [](Vec2 &pos, Vec2 &vel) {
+    pos = Vec2(random_float(-10, 10), random_float(-10, 10));
+    vel = Vec2(random_float(-10, 10), random_float(-60, -40));
+  };
+
+  for(int i = 0; i < 8; i++)
+    smoke_colours[i] = Pen(255, 255, 255, 32 - i * 4);
+
+  smoke_style.shape = ParticleShape::RECT;
+  smoke_style.colours = smoke_colours;
+  smoke_style.colour_count = 8;
+  smoke_style.size_start = 2;
+  smoke_style.size_end = 30;
+
+  // sparks fountain upwards, cooling from white through yellow to red
+  sparks.rate = 150.0f;
+  sparks.force = Vec2(0, 40);
+  sparks.generate = [](Vec2 &pos, Vec2 &vel) {
+    pos = Vec2(random_float(-5, 5), -100);
+    vel = Vec2(random_float(-20, 20), random_float(-70, 10));
+  };
+
+  for(int i = 0; i < 16; i++)
+    spark_colours[i] = Pen(255 - i * 6, std::max(255 - i * 32, 0), std::max(255 - i * 64, 0));
+
+  spark_style.colours = spark_colours;
+  spark_style.colour_count = 16;
+
+  rain.rate = 80.0f;
+  rain.force = Vec2(0, 9.8f * 5);
+  rain.generate = [](Vec2 &pos, Vec2 &vel) {
+    pos = Vec2(random_float(-40, 40), random_float(-250, -240));
+    vel = Vec2(0, 140);
+  };
+
+  rain_style.colours = &rain_colour;
+  rain_style.colour_count = 1;
+}
 
-      int a = p.age / 2;
-      int r = 255 - (p.age / 2);
-      int g = 255 - (a * 2);
-      g = g < 0 ? 0 : g;
-      int b = 255 - (a * 4);
-      b = b < 0 ? 0 : b;
+void render(uint32_t time_ms) {
+  screen.pen = Pen(0, 0, 0, 255);
+  screen.clear();
 
-      int bloom = (255 - a) / 64;
-      screen.pen = Pen(r, g, b, 16);
-      screen.circle(p.pos + Point(160, 240), bloom);
-      screen.pen = Pen(r, g, b, 16);
-      screen.circle(p.pos + Point(160, 240), bloom / 2);
+  smoke.render(screen, Point(50, screen.bounds.h), smoke_style);
+  sparks.render(screen, Point(screen.bounds.w / 2, screen.bounds.h), spark_style);
+  rain.render(screen, Point(screen.bounds.w - 50, screen.bounds.h), rain_style);
 
-      screen.pen = Pen(r, g, b);
-      screen.pixel(p.pos + Point(160, 240));
+  screen.alpha = 255;
+  screen.pen = Pen(255, 255, 255);
+  screen.rectangle(Rect(0, 0, screen.bounds.w, 14));
+  screen.pen = Pen(0, 0, 0);
+  screen.text("Particles", minimal_font, Point(5, 4));
 
-    }
-  }
-  
-  last_time_ms = time_ms;
-};
+  screen.pen = Pen(255, 255, 255);
 
+  uint32_t total = smoke.get_count() + sparks.get_count() + rain.get_count();
+  screen.text(std::to_string(total) + " particles", minimal_font, Point(5, 20));
 
-void rain_generate(test_particle &p) {
-  p.pos = Vec2((rand() % 80) - 40, (rand() % 10) - 250);
-  p.vel = Vec2(0, 140);
-  p.age = 0;// rand() % 255;
-  p.generated = true;
-};
+  if(bench_done) {
+    screen.text("ns per particle (" + std::to_string(bench_particles) + "):", minimal_font, Point(5, 35));
 
-Vec2 g = Vec2(0, 9.8 * 5);
-
-void rain(uint32_t time_ms) {
-  static test_particle s[200];
-  static int generate_index = 0;
-  static uint32_t last_time_ms = time_ms;
-
-  int elapsed_ms = time_ms - last_time_ms;
-  float td = (elapsed_ms) / 1000.0f;
-
-  rain_generate(s[generate_index++]);
-  if (generate_index >= 200)
-    generate_index = 0;
-
-  float w = sinf(time_ms / 1000.0f) * 0.05f;
-
-  Vec2 gravity = g * td;
-
-  for (auto &p : s) {
-    if (p.generated) {
-      p.vel += gravity;
-      p.pos += p.vel * td;
-      
-      int floor = -3;
-      if (p.pos.x > 20 && p.pos.x < 46)
-        floor = -33;
-
-      if (p.pos.y >= floor) {
-        p.pos.y = floor;
-        float bounce = ((rand() % 10)) / 80.0f;
-        p.vel.y *= -bounce;
-        p.vel.x = ((rand() % 30) - 15);
-      }
-      p.age++;
-
-      int a = p.age / 2;
-      int r = 150 - (a / 2);
-      int g = 150 - (a / 2);
-      int b = 255;// -(a * 4);
-
-      if(p.vel.length() > 20) {
-        screen.pen = Pen(r, g, b, 100);
-        screen.pixel(p.pos + Point(270, 239));
-        screen.pen = Pen(r, g, b, 160);
-        screen.pixel(p.pos + Point(270, 241));
-      }
-      screen.pen = Pen(r, g, b, 180);
-      screen.pixel(p.pos + Point(270, 242));
+    int y = 45;
+    for(auto &result : bench_results) {
+      screen.text(std::string(result.name) + ": " + std::to_string(result.ns), minimal_font, Point(5, y));
+      y += 10;
     }
-  }
-
-  last_time_ms = time_ms;
-};
+  } else
+    screen.text("A: benchmark", minimal_font, Point(5, 35));
+}
 
+void update(uint32_t time_ms) {
+  if(pressed(Button::A))
+    run_benchmark();
 
+  if(pressed(Button::B))
+    set_screen_mode(screen.bounds.w == 320 ? ScreenMode::lores : ScreenMode::hires);
 
-Particle* generate_basic_rain() {  
-  return new Particle(
-    Vec2((std::rand() % 120) + 100, 0),
-    Vec2(0, 100)
-  );
-}
+  if(pressed(Button::DPAD_LEFT))
+    rain.force.rotate(0.1f);
 
-ParticleGenerator basic_rain_generator(250, 4000, generate_basic_rain);
+  smoke.update(time_ms);
+  sparks.update(time_ms);
+  rain.update(time_ms);
 
-void render_basic_rain() {
-  for (auto p : basic_rain_generator.particles) {
-    Particle *sp = static_cast<Particle*>(p);
-    if (sp->pos.y >= 239) {
-      sp->pos.y = 239;
+  // sparks bounce off the ground
+  for(uint32_t i = 0; i < sparks.get_count(); i++) {
+    if(sparks.pos_y[i] > 0.0f) {
+      sparks.pos_y[i] = 0.0f;
+      sparks.vel_y[i] *= -0.7f;
     }
-    screen.pen = Pen(128, 128, 255);
-    screen.pixel(sp->pos);
   }
-}
 
-uint32_t prev_buttons = blit::buttons;
+  // rain splashes on the ground or a ledge
+  for(uint32_t i = 0; i < rain.get_count(); i++) {
+    float floor = rain.pos_x[i] > 20.0f && rain.pos_x[i] < 46.0f ? -33.0f : -3.0f;
 
-void render(uint32_t time_ms) {
-  if ((blit::buttons ^ prev_buttons) & blit::Button::A) {
-      blit::set_screen_mode(blit::lores);
-  }
-  else if ((blit::buttons ^ prev_buttons) & blit::Button::B) {
-      blit::set_screen_mode(blit::hires);
+    if(rain.pos_y[i] >= floor) {
+      rain.pos_y[i] = floor;
+      rain.vel_y[i] *= -random_float(0.0f, 0.125f);
+      rain.vel_x[i] = random_float(-15, 15);
+    }
   }
-  prev_buttons = blit::buttons;
-
-  screen.pen = Pen(0, 0, 0, 255);
-  screen.clear();
-
-  //render_smoke();
-
-  uint32_t ms_start = now();
-  spark(time_ms);
-  smoke(time_ms); 
-  rain(time_ms);
-  //render_basic_rain();
-  uint32_t ms_end = now();
-
-  // draw grid
-  screen.alpha = 255;
-  screen.pen = Pen(255, 255, 255);
-  screen.rectangle(Rect(0, 0, 320, 14));
-  screen.pen = Pen(0, 0, 0);
-  screen.text("Rain demo", minimal_font, Point(5, 4));
-
- /* screen.pen = Pen(255, 255, 255);  
-  screen.text("Smoke:", minimal_font, point(10, 20));
-  screen.text("Sparks:", minimal_font, point(120, 20));
-  screen.text("Rain:", minimal_font, point(220, 20));  */
-
-  // draw FPS meter
-  /*screen.alpha = 255;
-  screen.pen = Pen(0, 0, 0);
-  screen.rectangle(rect(1, 240 - 10, 12, 9));
-  screen.pen = Pen(255, 255, 255, 200);
-  std::string fms = std::to_string(ms_end - ms_start);
-  screen.text(fms, minimal_font, rect(3, 240 - 9, 10, 16));
-
-  int block_size = 4;
-  for (int i = 0; i < (ms_end - ms_start); i++) {
-    screen.pen = Pen(i * 5, 255 - (i * 5), 0);
-    screen.rectangle(rect(i * (block_size + 1) + 1 + 13, screen.bounds.h - block_size - 1, block_size, block_size));
-  }*/
-
-  screen.watermark();
 }
-
-void update(uint32_t time_ms) {
-//  smoke_generator.update(time_ms);
-  basic_rain_generator.update(time_ms);
-
-  if (pressed(Button::DPAD_LEFT)) {
-    g.rotate(0.1f);
-  }
-}
\ No newline at end of file
@@ -11,11 +11,15 @@
 // DOWN				Increase rows displayed on page
 // LEFT				Back Page
 // RIGHT			Next Page
+// HOME				Log current values to CDC
+// JOYSTICK		Start recording a trace, press again to save it to profiler-test.json
+//						(or send it to CDC if there's no storage)
 
 
 #include "profiler-test.hpp"
 #include "graphics/color.hpp"
 #include "engine/profiler.hpp"
+#include "engine/trace.hpp"
 #include <cmath>
 
 using namespace blit;
@@ -98,6 +102,7 @@ void render(uint32_t time)
 	bool button_left = buttons.pressed & Button::DPAD_LEFT;
 	bool button_right = buttons.pressed & Button::DPAD_RIGHT;
 	bool button_home = buttons.pressed & Button::HOME;
+	bool button_joystick = buttons.pressed & Button::JOYSTICK;
 
 	if(button_up && (g_uRows>1))
 	{
@@ -155,6 +160,20 @@ void render(uint32_t time)
 		g_profiler.log_probes();
 	}
 
+	if(button_joystick)
+	{
+		// probes are recorded to the trace along with any other events
+		if(!trace_recorder.is_recording())
+			trace_recorder.start();
+		else
+		{
+			trace_recorder.stop();
+
+			if(!is_storage_available() || !trace_recorder.save_json("profiler-test.json"))
+				trace_recorder.debug_json();
+		}
+	}
+
 	g_pRenderProbe->start();
 
 	// clear screen
@@ -208,6 +227,8 @@ void update(uint32_t time)
 	// Scoped profiler probes automatically call Start() and at end of scope call StoreElapsedUs()
 	ScopedProfilerProbe scopedProbe(g_pUpdateProbe);
 
+	BLIT_TRACE_COUNTER("Size", g_uSize);
+
   g_uSize+=g_uSizeChange;
   if(g_uSize >= g_uSizeMax)
   {
@@ -0,0 +1,166 @@
+// Resampler benchmark
+//
+// Converts one second of audio at common source rates to the engine's rate
+// and reports how long it takes per channel. Also checks the filter: the
+// gain for a 1kHz tone should be 0dB and anything above the output's Nyquist
+// frequency should be removed rather than aliased.
+//
+// Button			Function
+// =====================================================
+// A					Run the benchmark
+
+#include <cmath>
+
+#include "resampler-bench.hpp"
+#include "audio/resampler.hpp"
+
+using namespace blit;
+
+struct Result {
+  uint32_t rate;
+  int taps;
+  uint32_t us_per_second; // of CPU time per second of audio for one channel
+  float gain_db;          // for a 1kHz tone
+  float alias_db;         // level of a tone above the output's Nyquist frequency, if the input can represent one
+};
+
+static const uint32_t rates[]{8000, 11025, 16000, 32000, 44100, 48000};
+static const int num_rates = sizeof(rates) / sizeof(rates[0]);
+
+Result results[num_rates];
+bool have_results = false;
+
+static const uint32_t block_size = 1024;
+static int16_t in_buf[block_size];
+static int16_t out_buf[block_size * 3]; // enough to convert from 8kHz
+
+// converts one second of a tone and returns the RMS level of the output
+static float convert_tone(Resampler &resampler, uint32_t rate, float freq) {
+  // skip the start, where the filter is still filling
+  const uint32_t skip = 256;
+
+  float phase = 0.0f, sum = 0.0f;
+  uint32_t out_total = 0;
+
+  for(uint32_t pos = 0; pos < rate; pos += block_size) {
+    uint32_t count = std::min(block_size, rate - pos);
+
+    for(uint32_t i = 0; i < count; i++) {
+      in_buf[i] = int16_t(sinf(phase) * 16000.0f);
+
+      phase += 2.0f * pi * freq / rate;
+      if(phase >= 2.0f * pi)
+        phase -= 2.0f * pi;
+    }
+
+    uint32_t used;
+    uint32_t out_count = resampler.process(in_buf, count, used, out_buf, block_size * 3);
+
+    for(uint32_t i = 0; i < out_count; i++, out_total++) {
+      if(out_total >= skip)
+        sum += float(out_buf[i]) * out_buf[i];
+    }
+  }
+
+  return sqrtf(sum / (out_total - skip));
+}
+
+// relative to the input tone
+static float to_db(float level) {
+  return 20.0f * log10f(std::max(level, 0.01f) / (16000.0f / sqrtf(2.0f)));
+}
+
+void run_benchmark() {
+  for(int r = 0; r < num_rates; r++) {
+    auto &result = results[r];
+    uint32_t rate = rates[r];
+
+    Resampler resampler(rate);
+
+    result.rate = rate;
+    result.taps = resampler.get_taps();
+
+    result.gain_db = to_db(convert_tone(resampler, rate, 1000.0f));
+
+    // 0.7 of the output rate aliases to 0.3, well inside the passband
+    float alias_freq = sample_rate * 0.7f;
+    if(alias_freq < rate / 2) {
+      resampler.reset();
+      result.alias_db = to_db(convert_tone(resampler, rate, alias_freq));
+    } else
+      result.alias_db = 0.0f;
+
+    // time converting noise, repeating until the measurement is long enough to be reliable
+    for(uint32_t i = 0; i < block_size; i++)
+      in_buf[i] = int16_t(blit::random() & 0xFFFF);
+
+    uint32_t start = now(), elapsed, seconds = 0;
+    do {
+      for(uint32_t pos = 0; pos < rate; pos += block_size) {
+        uint32_t used;
+        resampler.process(in_buf, std::min(block_size, rate - pos), used, out_buf, block_size * 3);
+      }
+
+      seconds++;
+      elapsed = now() - start;
+    } while(elapsed < 250);
+
+    result.us_per_second = elapsed * 1000 / seconds;
+  }
+
+  have_results = true;
+}
+
+/* setup */
+void init() {
+  set_screen_mode(ScreenMode::hires);
+}
+
+void render(uint32_t time) {
+  screen.pen = Pen(0, 0, 0);
+  screen.clear();
+
+  screen.alpha = 255;
+  screen.pen = Pen(255, 255, 255);
+  screen.rectangle(Rect(0, 0, 320, 14));
+  screen.pen = Pen(0, 0, 0);
+  screen.text("Resampler Benchmark", minimal_font, Point(5, 4));
+
+  screen.pen = Pen(255, 255, 255);
+
+  if(!have_results) {
+    screen.text("Press A to convert to " + std::to_string(sample_rate) + "Hz", minimal_font, Point(5, 20));
+    return;
+  }
+
+  screen.text("Rate", minimal_font, Point(5, 20));
+  screen.text("Taps", minimal_font, Point(55, 20));
+  screen.text("us/s/channel", minimal_font, Point(95, 20));
+  screen.text("1kHz", minimal_font, Point(175, 20));
+  screen.text("Alias", minimal_font, Point(225, 20));
+
+  for(int r = 0; r < num_rates; r++) {
+    auto &result = results[r];
+    int y = 35 + r * 12;
+
+    // dB to one decimal place
+    auto db = [](float v) {
+      int tenths = int(roundf(v * 10.0f));
+      return (tenths < 0 ? "-" : "") + std::to_string(std::abs(tenths) / 10) + "." + std::to_string(std::abs(tenths) % 10) + "dB";
+    };
+
+    screen.text(std::to_string(result.rate), minimal_font, Point(5, y));
+    screen.text(result.taps ? std::to_string(result.taps) : "-", minimal_font, Point(55, y));
+    screen.text(std::to_string(result.us_per_second), minimal_font, Point(95, y));
+    screen.text(db(result.gain_db), minimal_font, Point(175, y));
+    screen.text(result.alias_db != 0.0f ? db(result.alias_db) : "-", minimal_font, Point(225, y));
+  }
+
+  screen.text("us/s/channel: CPU time to convert one second of one channel", minimal_font, Point(5, 200));
+  screen.text("Alias: level of a tone above the output's Nyquist frequency", minimal_font, Point(5, 210));
+}
+
+void update(uint32_t time) {
+  if(pressed(Button::A))
+    run_benchmark();
+}
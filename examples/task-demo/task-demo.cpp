@@ -0,0 +1,172 @@
+// Task scheduler example
+//
+// Generates a terrain map with tasks that run for a short time each frame,
+// while the ball keeps moving smoothly.
+//
+// Button			Function
+// =====================================================
+// A					Generate a new map
+// DPAD_UP		Increase the task budget
+// DPAD_DOWN	Decrease the task budget
+
+#include <cmath>
+#include <string>
+
+#include "task-demo.hpp"
+
+using namespace blit;
+
+const int map_w = 160, map_h = 100;
+
+float heights[map_w * map_h];
+Pen colours[map_w * map_h];
+
+uint32_t seed = 1;
+int generated_rows = 0, shaded_rows = 0;
+uint32_t generate_task = 0, shade_task = 0;
+uint32_t generate_ms = 0;
+
+Vec2 ball_pos(160, 120), ball_vel(90, 70);
+
+// smoothed random values on a grid
+float value_noise(int x, int y, int scale) {
+  auto hash = [](int x, int y) {
+    uint32_t h = x * 374761393u + y * 668265263u + seed * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return float((h ^ (h >> 16)) & 0xffff) / 0xffff;
+  };
+
+  int gx = x / scale, gy = y / scale;
+  float fx = float(x % scale) / scale, fy = float(y % scale) / scale;
+
+  // smoothstep between the corners
+  fx = fx * fx * (3.0f - 2.0f * fx);
+  fy = fy * fy * (3.0f - 2.0f * fy);
+
+  float top = hash(gx, gy) + (hash(gx + 1, gy) - hash(gx, gy)) * fx;
+  float bottom = hash(gx, gy + 1) + (hash(gx + 1, gy + 1) - hash(gx, gy + 1)) * fx;
+
+  return top + (bottom - top) * fy;
+}
+
+Pen terrain_colour(float height, float light) {
+  if(height < 0.4f)
+    return Pen(0, 40 + int(height * 200), 160);
+
+  light = std::min(std::max(light, 0.3f), 1.0f);
+
+  if(height < 0.6f)
+    return Pen(int(40 * light), int(170 * light), int(40 * light));
+
+  if(height < 0.75f)
+    return Pen(int(120 * light), int(100 * light), int(70 * light));
+
+  return Pen(int(240 * light), int(240 * light), int(240 * light));
+}
+
+void start_generating() {
+  cancel_task(generate_task);
+  cancel_task(shade_task);
+
+  seed++;
+  generated_rows = shaded_rows = 0;
+  uint32_t start = now();
+
+  // one row per step, each is many noise samples
+  generate_task = add_task([]() {
+    int y = generated_rows;
+
+    for(int x = 0; x < map_w; x++) {
+      float h = 0.0f, amplitude = 0.5f;
+
+      for(int scale = 64; scale >= 1; scale /= 2) {
+        h += value_noise(x, y, scale) * amplitude;
+        amplitude *= 0.5f;
+      }
+
+      heights[x + y * map_w] = h;
+    }
+
+    return ++generated_rows == map_h;
+  }, TaskPriority::NORMAL, [start]() {
+    // lighting needs the whole map, so it's a second task started when the first finishes
+    shade_task = add_task([]() {
+      int y = shaded_rows;
+
+      for(int x = 0; x < map_w; x++) {
+        float h = heights[x + y * map_w];
+        float left = heights[std::max(x - 1, 0) + y * map_w];
+        float up = heights[x + std::max(y - 1, 0) * map_w];
+
+        colours[x + y * map_w] = terrain_colour(h, 0.7f + (h * 2.0f - left - up) * 20.0f);
+      }
+
+      return ++shaded_rows == map_h;
+    }, TaskPriority::LOW, [start]() {
+      generate_ms = now() - start;
+    });
+  });
+}
+
+/* setup */
+void init() {
+  set_screen_mode(ScreenMode::hires);
+
+  start_generating();
+}
+
+void render(uint32_t time) {
+  screen.pen = Pen(0, 0, 0);
+  screen.clear();
+
+  // map, scaled up twice
+  for(int y = 0; y < shaded_rows; y++) {
+    for(int x = 0; x < map_w; x++) {
+      screen.pen = colours[x + y * map_w];
+      screen.rectangle(Rect(x * 2, 16 + y * 2, 2, 2));
+    }
+  }
+
+  screen.pen = Pen(255, 255, 255);
+  screen.rectangle(Rect(0, 0, 320, 14));
+  screen.pen = Pen(0, 0, 0);
+  screen.text("Task demo", minimal_font, Point(5, 4));
+
+  // progress of each task
+  screen.pen = Pen(80, 80, 80);
+  screen.rectangle(Rect(5, 220, 150, 4));
+  screen.rectangle(Rect(165, 220, 150, 4));
+  screen.pen = Pen(255, 200, 0);
+  screen.rectangle(Rect(5, 220, generated_rows * 150 / map_h, 4));
+  screen.rectangle(Rect(165, 220, shaded_rows * 150 / map_h, 4));
+
+  screen.pen = Pen(255, 255, 255);
+  screen.text("Budget: " + std::to_string(get_task_budget()) + "us", minimal_font, Point(5, 228));
+
+  if(shaded_rows == map_h)
+    screen.text("Done in " + std::to_string(generate_ms) + "ms", minimal_font, Point(165, 228));
+  else
+    screen.text(std::to_string(get_task_count()) + " task(s) running", minimal_font, Point(165, 228));
+
+  screen.pen = Pen(255, 0, 0);
+  screen.circle(Point(ball_pos.x, ball_pos.y), 6);
+}
+
+void update(uint32_t time) {
+  if(pressed(Button::A))
+    start_generating();
+
+  if(pressed(Button::DPAD_UP))
+    set_task_budget(get_task_budget() * 2);
+  else if(pressed(Button::DPAD_DOWN))
+    set_task_budget(std::max(get_task_budget() / 2, uint32_t(125)));
+
+  // keeps moving while the map is generated
+  ball_pos += ball_vel * 0.01f;
+
+  if(ball_pos.x < 6 || ball_pos.x > 314)
+    ball_vel.x = -ball_vel.x;
+
+  if(ball_pos.y < 20 || ball_pos.y > 214)
+    ball_vel.y = -ball_vel.y;
+}
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Generate the test module used by the tracker example (test.mod).
+
+The samples are synthesised and the patterns use most of the ProTracker
+effects, so the module doubles as a test of the player.
+"""
+
+import math
+import random
+import struct
+
+PERIODS = [
+    856, 808, 762, 720, 678, 640, 604, 570, 538, 508, 480, 453,
+    428, 404, 381, 360, 339, 320, 302, 285, 269, 254, 240, 226,
+    214, 202, 190, 180, 170, 160, 151, 143, 135, 127, 120, 113
+]
+NOTES = ['C-', 'C#', 'D-', 'D#', 'E-', 'F-', 'F#', 'G-', 'G#', 'A-', 'A#', 'B-']
+
+
+def period(note):
+    """'C-2' -> period, octaves 1-3 like ProTracker."""
+    return PERIODS[(int(note[2]) - 1) * 12 + NOTES.index(note[:2])]
+
+
+def clamp8(v):
+    return max(-128, min(127, int(round(v))))
+
+
+def make_samples():
+    random.seed(32)
+
+    # single cycle waveforms, looped
+    saw = [clamp8(127 - i * 8) for i in range(32)]
+    pulse = [100 if i < 12 else -100 for i in range(32)]
+    sine = [clamp8(math.sin(i / 32 * 2 * math.pi) * 120) for i in range(32)]
+
+    # drums, one-shot at 16574Hz (C-3)
+    kick, phase = [], 0.0
+    for i in range(3000):
+        t = i / 16574
+        phase += 2 * math.pi * (50 + 150 * math.exp(-t * 30)) / 16574
+        kick.append(clamp8(math.sin(phase) * 127 * math.exp(-t * 8)))
+
+    snare = [clamp8((random.uniform(-1, 1) * 0.8 + math.sin(i * 0.12) * 0.3) * 127 * math.exp(-i / 1200))
+             for i in range(3000)]
+    hat = [clamp8(random.uniform(-1, 1) * 90 * math.exp(-i / 250)) for i in range(1200)]
+
+    # name, data, volume, finetune, looped
+    return [
+        ('bass', saw, 32, 0, True),
+        ('lead', pulse, 28, 0, True),
+        ('pad', sine, 28, 0, True),
+        ('kick', kick, 48, 0, False),
+        ('snare', snare, 40, 0, False),
+        ('hat', hat, 28, 0, False),
+    ]
+
+
+class Pattern:
+    def __init__(self, channels=4):
+        self.rows = [[(0, 0, 0, 0) for _ in range(channels)] for _ in range(64)]
+
+    def set(self, row, channel, note=None, sample=0, effect=0, param=0):
+        self.rows[row][channel] = (period(note) if note else 0, sample, effect, param)
+
+    def pack(self):
+        out = b''
+        for row in self.rows:
+            for p, s, e, x in row:
+                out += struct.pack('>BBBB', (s & 0xF0) | (p >> 8), p & 0xFF, ((s & 0xF) << 4) | e, x)
+        return out
+
+
+def drums(pat, fill=False):
+    for bar in range(4):
+        r = bar * 16
+        pat.set(r, 3, 'C-3', 4)
+        pat.set(r + 8, 3, 'C-3', 5)
+        pat.set(r + 10, 3, 'C-3', 4, 0xC, 40)
+        for h in (2, 6, 12, 14):
+            pat.set(r + h, 3, 'C-3', 6)
+    if fill:
+        # retriggered snare roll with a volume slide
+        pat.set(56, 3, 'C-3', 5, 0xE, 0x93)
+        pat.set(60, 3, 'C-3', 5, 0xE, 0x92)
+
+
+def bassline(pat, roots):
+    for bar, root in enumerate(roots):
+        r = bar * 16
+        for step in range(0, 16, 2):
+            note = root if step % 8 != 6 else root[:2] + str(int(root[2]) + 1)
+            pat.set(r + step, 0, note, 1)
+            pat.set(r + step + 1, 0, None, 0, 0xA, 0x04)
+
+
+def main():
+    samples = make_samples()
+
+    patterns = []
+
+    # 0: intro, pad chords with arpeggio, tempo/speed set
+    p = Pattern()
+    p.set(0, 0, None, 0, 0xF, 6)
+    p.set(0, 1, None, 0, 0xF, 125)
+    for bar, (root, arp) in enumerate([('C-2', 0x47), ('A-1', 0x37), ('F-1', 0x47), ('G-1', 0x47)]):
+        p.set(bar * 16, 2, root, 3, 0x0, arp)
+        for r in range(1, 16):
+            p.set(bar * 16 + r, 2, None, 0, 0x0, arp)
+    drums(p)
+    patterns.append(p)
+
+    # 1: bass + lead with vibrato and tone portamento
+    p = Pattern()
+    bassline(p, ['C-1', 'A-1', 'F-1', 'G-1'])
+    melody = [(0, 'G-2'), (4, 'E-2'), (8, 'C-3'), (14, 'B-2'), (16, 'A-2'), (24, 'E-2'),
+              (32, 'F-2'), (36, 'A-2'), (40, 'C-3'), (48, 'D-3'), (56, 'B-2')]
+    for r, n in melody:
+        p.set(r, 1, n, 2, 0x4, 0x46)
+        p.set(r + 2, 1, None, 0, 0x4, 0x00)
+    p.set(44, 1, 'G-2', 0, 0x3, 0x08)
+    p.set(45, 1, None, 0, 0x3, 0x00)
+    p.set(46, 1, None, 0, 0x5, 0x02)
+    drums(p, fill=True)
+    patterns.append(p)
+
+    # 2: variation, portamento slides, tremolo pad, sample offset on the kick
+    p = Pattern()
+    bassline(p, ['F-1', 'G-1', 'E-1', 'A-1'])
+    p.set(0, 2, 'A-2', 3, 0x7, 0x48)
+    p.set(32, 2, 'C-3', 3, 0x7, 0x48)
+    for r in (8, 40):
+        p.set(r, 1, 'C-3', 2, 0x2, 0x02)
+        p.set(r + 4, 1, None, 0, 0x1, 0x03)
+        p.set(r + 8, 1, None, 0, 0xE, 0xC3)
+    drums(p)
+    p.set(24, 3, 'C-3', 4, 0x9, 0x04)
+    patterns.append(p)
+
+    # 3: ending, note delays, pattern delay, then jump back to pattern 1
+    p = Pattern()
+    bassline(p, ['C-1', 'C-1'])
+    for r in range(32, 64, 4):
+        p.set(r, 2, 'C-2', 3, 0xE, 0xD2)
+    p.set(32, 1, 'E-3', 2, 0xA, 0x01)
+    p.set(48, 0, None, 0, 0xE, 0xE3)
+    drums(p)
+    p.set(63, 0, None, 0, 0xB, 1)
+    patterns.append(p)
+
+    orders = [0, 1, 2, 1, 3]
+
+    out = b'blit tracker test'.ljust(20, b'\0')
+    for i in range(31):
+        if i < len(samples):
+            name, data, vol, ft, looped = samples[i]
+            length = len(data) // 2
+            out += name.encode().ljust(22, b'\0')
+            out += struct.pack('>HBBHH', length, ft & 0xF, vol, 0, length if looped else 1)
+        else:
+            out += b'\0' * 22 + struct.pack('>HBBHH', 0, 0, 0, 0, 1)
+
+    out += bytes([len(orders), 127]) + bytes(orders + [0] * (128 - len(orders))) + b'M.K.'
+
+    for p in patterns:
+        out += p.pack()
+
+    for s in samples:
+        out += bytes(v & 0xFF for v in s[1][:len(s[1]) // 2 * 2])
+
+    with open('test.mod', 'wb') as f:
+        f.write(out)
+
+    print(f'{len(out)} bytes')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,146 @@
+// Tracker module playback example
+//
+// Plays music.mod from the SD card, or a built-in test module
+// (see make-test-mod.py).
+//
+// Button			Function
+// =====================================================
+// A					Render the song to tracker.wav and benchmark it
+// B					Stop/restart playback
+
+#include <cstring>
+
+#include "tracker.hpp"
+#include "audio/tracker-player.hpp"
+
+#include "assets.hpp"
+
+using namespace blit;
+
+TrackerPlayer player;
+
+std::string filename;
+
+// results of the render test
+uint32_t render_samples = 0, render_ms = 0;
+bool render_saved = false;
+
+// renders the whole song with a second player, so playback isn't affected
+void render_test() {
+  TrackerPlayer renderer;
+  if(!renderer.load(filename))
+    return;
+
+  renderer.set_loop(false);
+
+  File wav;
+  render_saved = is_storage_available() && wav.open("tracker.wav", OpenMode::write);
+
+  // header, sizes are filled in at the end
+  const int header_size = 44;
+  uint8_t header[header_size] = {
+    'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+    'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0, // PCM, mono
+    0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 16, 0,         // rate, bytes/s, 16-bit
+    'd', 'a', 't', 'a', 0, 0, 0, 0
+  };
+
+  static int16_t buf[1024];
+  uint32_t total = 0, elapsed = 0, count;
+
+  do {
+    uint32_t start = now();
+    count = renderer.render(buf, 1024);
+    elapsed += now() - start;
+
+    if(render_saved)
+      wav.write(header_size + total * 2, count * 2, (const char *)buf);
+
+    total += count;
+  } while(count == 1024);
+
+  if(render_saved) {
+    uint32_t data_size = total * 2, riff_size = data_size + 36, byte_rate = sample_rate * 2;
+    memcpy(header + 4, &riff_size, 4);
+    memcpy(header + 24, &sample_rate, 4);
+    memcpy(header + 28, &byte_rate, 4);
+    memcpy(header + 40, &data_size, 4);
+    wav.write(0, header_size, (const char *)header);
+  }
+
+  render_samples = total;
+  render_ms = elapsed;
+}
+
+/* setup */
+void init() {
+  set_screen_mode(ScreenMode::hires);
+
+  if(file_exists("music.mod"))
+    filename = "music.mod";
+  else {
+    // modules are played from memory, so one added like this isn't copied
+    File::add_buffer_file("test.mod", asset_test_mod, asset_test_mod_length);
+    filename = "test.mod";
+  }
+
+  player.load(filename);
+
+  // the module uses one channel per track, starting from this one
+  player.play(0);
+}
+
+void render(uint32_t time) {
+  screen.pen = Pen(0, 0, 0);
+  screen.clear();
+
+  screen.alpha = 255;
+  screen.pen = Pen(255, 255, 255);
+  screen.rectangle(Rect(0, 0, 320, 14));
+  screen.pen = Pen(0, 0, 0);
+  screen.text("Tracker Playback", minimal_font, Point(5, 4));
+
+  screen.pen = Pen(255, 255, 255);
+  screen.text(filename + ": " + player.get_title(), minimal_font, Point(5, 20));
+  screen.text(std::to_string(player.get_channel_count()) + " channels", minimal_font, Point(5, 30));
+
+  screen.text("Order " + std::to_string(player.get_order()) + "/" + std::to_string(player.get_song_length())
+            + " row " + std::to_string(player.get_row()), minimal_font, Point(5, 45));
+
+  // channel levels
+  int bar_w = std::min(40, 310 / std::max(player.get_channel_count(), 1));
+  for(int c = 0; c < player.get_channel_count() && c < CHANNEL_COUNT; c++) {
+    auto &channel = channels[c];
+    int h = channel.adsr_phase == ADSRPhase::OFF ? 0 : channel.volume * 60 / 0xffff;
+
+    screen.pen = Pen(0, 255, 100);
+    screen.rectangle(Rect(5 + c * bar_w, 130 - h, bar_w - 2, h));
+  }
+
+  screen.pen = Pen(255, 255, 255);
+
+  if(render_samples) {
+    uint32_t audio_ms = uint64_t(render_samples) * 1000 / sample_rate;
+
+    screen.text("Rendered " + std::to_string(audio_ms / 1000) + "s of audio in " + std::to_string(render_ms) + "ms", minimal_font, Point(5, 150));
+    screen.text(std::to_string(audio_ms ? uint64_t(render_ms) * 1000000 / audio_ms : 0) + "us of CPU per second of audio", minimal_font, Point(5, 160));
+
+    if(render_saved)
+      screen.text("Saved to tracker.wav", minimal_font, Point(5, 170));
+  } else
+    screen.text("Press A to render to a file", minimal_font, Point(5, 150));
+
+  screen.text(player.get_playing() ? "B: stop" : "B: play", minimal_font, Point(5, 225));
+}
+
+void update(uint32_t time) {
+  if(pressed(Button::A))
+    render_test();
+
+  if(pressed(Button::B)) {
+    if(player.get_playing())
+      player.stop();
+    else
+      player.play(0);
+  }
+}
@@ -4,29 +4,72 @@
 
 using namespace blit;
 
-Tween tween;
-
-struct TweenInfo {
-  Tween::TweenFunction func;
+struct EasingInfo {
+  Easing easing;
   const char *name;
 };
 
-static const int num_tween_funcs = 5;
-TweenInfo tween_funcs[num_tween_funcs]{
-  {tween_linear, "Linear"},
-  {tween_ease_in_quad, "Ease in quad"},
-  {tween_ease_out_quad, "Ease out quad"},
-  {tween_ease_in_out_quad, "Ease in out quad"},
-  {tween_sine, "Sine"},
+static const int num_easings = int(Easing::COUNT);
+EasingInfo easings[num_easings]{
+  {Easing::LINEAR, "Linear"},
+  {Easing::IN_QUAD, "In quad"},
+  {Easing::OUT_QUAD, "Out quad"},
+  {Easing::IN_OUT_QUAD, "In out quad"},
+  {Easing::IN_CUBIC, "In cubic"},
+  {Easing::OUT_CUBIC, "Out cubic"},
+  {Easing::IN_OUT_CUBIC, "In out cubic"},
+  {Easing::IN_SINE, "In sine"},
+  {Easing::OUT_SINE, "Out sine"},
+  {Easing::IN_OUT_SINE, "In out sine"},
+  {Easing::IN_EXPO, "In expo"},
+  {Easing::OUT_EXPO, "Out expo"},
+  {Easing::IN_OUT_EXPO, "In out expo"},
+  {Easing::IN_BACK, "In back"},
+  {Easing::OUT_BACK, "Out back"},
+  {Easing::IN_OUT_BACK, "In out back"},
+  {Easing::OUT_ELASTIC, "Out elastic"},
+  {Easing::OUT_BOUNCE, "Out bounce"},
 };
 
-int current_tween_func = 0;
+int current_easing = 0;
+
+// position of the ball next to the graph
+float ball_y = 0.0f;
+TweenHandle ball_tween;
+
+// a square moving around the edge of the graph, one tween per side
+Vec2 square_pos;
+
+const int graph_x = 20, graph_y = 34, graph_w = 260, graph_h = 160;
+
+void start_ball() {
+  tween_group.remove(ball_tween);
+
+  // down and back up again forever
+  ball_tween = tween_group.add(&ball_y, 0.0f, graph_h, 2000, easings[current_easing].easing);
+  tween_group.set_loops(ball_tween, -1, true);
+}
+
+void start_square() {
+  float left = graph_x, right = graph_x + graph_w, top = graph_y, bottom = graph_y + graph_h;
+  square_pos = Vec2(left, top);
+
+  auto handle = tween_group.add(&square_pos.x, left, right, 1500, Easing::IN_OUT_CUBIC);
+  handle = tween_group.then(handle, &square_pos.y, top, bottom, 1000, Easing::OUT_BOUNCE, 200);
+  handle = tween_group.then(handle, &square_pos.x, right, left, 1500, Easing::IN_OUT_CUBIC, 200);
+  handle = tween_group.then(handle, &square_pos.y, bottom, top, 1000, Easing::OUT_BACK, 200);
+
+  // go around again when the last side is done
+  tween_group.set_callback(handle, [](TweenHandle, void *) {
+    start_square();
+  });
+}
 
 void init() {
   set_screen_mode(ScreenMode::hires);
 
-  tween.init(tween_linear, 0.0f, 200.0f, 5000, -1);
-  tween.start();
+  start_ball();
+  start_square();
 }
 
 void render(uint32_t time_ms) {
@@ -37,38 +80,40 @@ void render(uint32_t time_ms) {
   screen.rectangle(Rect(0, 0, 320, 14));
 
   screen.pen = Pen(0, 0, 0);
-  screen.text(std::string("Tween demo - ") + tween_funcs[current_tween_func].name, minimal_font, Point(5, 4));
+  screen.text(std::string("Tween demo - ") + easings[current_easing].name, minimal_font, Point(5, 4));
 
   screen.pen = Pen(255, 255, 255);
-  screen.circle(Point(310, 24 + tween.value), 5);
+  screen.circle(Point(305, graph_y + ball_y), 5);
 
   // graph curve
-  const int graph_y = 24, graph_w = 280, graph_h = 200;
-  int prev_y = tween.function(0, 0, graph_h, 200);
+  auto easing = easings[current_easing].easing;
+  int prev_y = ease(easing, 0.0f) * graph_h;
 
   for(int x = 1; x < graph_w; x++) {
-    int y = tween.function(x, 0, graph_h, graph_w);
+    int y = ease(easing, float(x) / graph_w) * graph_h;
 
-    screen.line(Point(x + 20 - 1, prev_y + graph_y), Point(x + 20, y + graph_y));
+    screen.line(Point(x + graph_x - 1, prev_y + graph_y), Point(x + graph_x, y + graph_y));
     prev_y = y;
   }
 
   screen.pen = Pen(127, 127, 127);
 
-  screen.h_span(Point(20, graph_y + graph_h), graph_w);
-  screen.v_span(Point(20, graph_y), graph_h);
+  screen.h_span(Point(graph_x, graph_y + graph_h), graph_w);
+  screen.v_span(Point(graph_x, graph_y), graph_h);
+
+  screen.pen = Pen(255, 100, 0);
+  screen.rectangle(Rect(square_pos.x - 3, square_pos.y - 3, 7, 7));
+
+  screen.pen = Pen(255, 255, 255);
+  screen.text(std::to_string(tween_group.get_count()) + " tweens", minimal_font, Point(5, 225));
 }
 
 void update(uint32_t time_ms) {
   if(buttons.released & Button::DPAD_LEFT) {
-    current_tween_func = current_tween_func == 0 ? num_tween_funcs - 1 : current_tween_func - 1;
-
-    tween.function = tween_funcs[current_tween_func].func;
-    tween.start();
+    current_easing = current_easing == 0 ? num_easings - 1 : current_easing - 1;
+    start_ball();
   } else if(buttons.released & Button::DPAD_RIGHT) {
-    current_tween_func = current_tween_func + 1 == num_tween_funcs ? 0 : current_tween_func + 1;
-
-    tween.function = tween_funcs[current_tween_func].func;
-    tween.start();
+    current_easing = current_easing + 1 == num_easings ? 0 : current_easing + 1;
+    start_ball();
   }
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+// Video playback example
+//
+// Plays video.blv from the SD card (and video.mp3 in sync, if present),
+// or a built-in test clip. See tools/video/pack-video.py for creating videos.
+//
+// Button			Function
+// =====================================================
+// A					Run decode benchmark
+// B					Pause/resume
+
+#include "video.hpp"
+#include "audio/mp3-stream.hpp"
+#include "graphics/video.hpp"
+
+#include "assets.hpp"
+
+using namespace blit;
+
+VideoStream video;
+MP3Stream audio;
+bool audio_sync = false;
+
+Point video_pos;
+
+uint32_t bench_fps = 0;
+
+/* setup */
+void init() {
+  set_screen_mode(ScreenMode::hires);
+
+  screen.pen = Pen(0, 0, 0);
+  screen.clear();
+
+  if(file_exists("video.blv"))
+    video.load("video.blv");
+  else {
+    File::add_buffer_file("test.blv", asset_video, asset_video_length);
+    video.load("test.blv");
+  }
+
+  video_pos = Point((screen.bounds.w - video.get_size().w) / 2, (screen.bounds.h - 60 - video.get_size().h) / 2);
+
+  // the audio track drives the video clock
+  if(file_exists("video.mp3") && audio.load("video.mp3")) {
+    audio.play(0);
+    audio_sync = true;
+  } else {
+    video.set_loop(true);
+    video.play();
+  }
+}
+
+void render(uint32_t time) {
+  // frames are decoded straight into the screen
+  if(audio_sync)
+    video.update(uint64_t(audio.get_current_sample()) * 1000 / sample_rate, screen, video_pos);
+  else
+    video.update(screen, video_pos);
+
+  // stats
+  Rect stats_rect(0, screen.bounds.h - 50, screen.bounds.w, 50);
+  screen.pen = Pen(0, 0, 0);
+  screen.rectangle(stats_rect);
+
+  screen.pen = Pen(255, 255, 255);
+  Point text_pos = stats_rect.tl() + Point(5, 5);
+
+  auto decode_us = video.get_decode_us();
+  screen.text("Frame: " + std::to_string(video.get_current_frame() + 1) + "/" + std::to_string(video.get_frame_count()), minimal_font, text_pos);
+  screen.text("Decode: " + std::to_string(decode_us) + "us (" + std::to_string(decode_us ? 1000000 / decode_us : 0) + " fps)", minimal_font, text_pos + Point(0, 10));
+  screen.text("Dropped: " + std::to_string(video.get_frames_dropped()), minimal_font, text_pos + Point(0, 20));
+
+  if(bench_fps)
+    screen.text("Benchmark: " + std::to_string(bench_fps) + " fps", minimal_font, text_pos + Point(0, 30));
+  else
+    screen.text("Press A to benchmark", minimal_font, text_pos + Point(0, 30));
+}
+
+void update(uint32_t time) {
+  if(audio_sync)
+    audio.update();
+
+  if(pressed(Button::A)) {
+    // decode every frame as fast as possible
+    uint32_t start = now(), frames = 0;
+
+    video.rewind();
+    while(video.decode_next(screen, video_pos))
+      frames++;
+
+    uint32_t elapsed = now() - start;
+    bench_fps = elapsed ? frames * 1000 / elapsed : frames * 1000;
+
+    video.rewind();
+  }
+
+  if(pressed(Button::B) && !audio_sync) {
+    if(video.get_playing())
+      video.pause();
+    else
+      video.play();
+  }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+#include "32blit.hpp"
+
+void init();
+void update(uint32_t time);
+void render(uint32_t time);
\ No newline at end of file
@@ -23,6 +23,10 @@ struct BlitGameHeader {
 
   uint32_t end;
   uint32_t start;
+
+  // only valid if api_magic is blit::api_game_magic, games built before api_version 4 don't have these
+  uint32_t api_magic;
+  uint32_t api_version;
 };
 
 // missing the "BLITMETA" header and size
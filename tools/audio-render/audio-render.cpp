@@ -0,0 +1,486 @@
+// Renders audio engine scenarios without any audio/video output, to measure
+// the cost of the engine and to catch changes to its output.
+//
+// Each scenario sets up the channels and queues commands, then is rendered
+// with get_audio_frames in blocks and with get_audio_frame one sample at a time.
+// The two must match and the block output is checked against a known checksum.
+// (Channels share the noise generator, so only one channel in a scenario uses
+// noise. Otherwise the two renders would take values from it in a different order.)
+//
+// Usage: audio-render [options] [scenario...]
+//   --block N     samples per get_audio_frames call (default 256)
+//   --seconds N   length of each scenario (default: the scenario's own)
+//   --wav DIR     write each scenario to DIR/<name>.wav
+//   --mod FILE    also render a tracker module with TrackerPlayer
+//   --no-frame    skip the one sample at a time render
+//
+// Returns 1 if any output didn't match.
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "audio/audio.hpp"
+#include "audio/resampler.hpp"
+#include "audio/tracker-player.hpp"
+#include "engine/api_private.hpp"
+#include "math/constants.hpp"
+
+using namespace blit;
+
+// the noise waveform's generator, reset so every render is the same
+namespace blit {
+  extern uint32_t prng_lfsr;
+}
+
+static AudioChannel render_channels[CHANNEL_COUNT];
+static std::unique_ptr<AudioCommandQueue> render_queue;
+
+struct Scenario {
+  const char *name;
+  const char *description;
+  int voices;                       // channels used, for the per-voice cost
+  uint32_t seconds;
+  void (*setup)();                  // configure the channels and add to the script
+  void (*update)(uint32_t time);    // called before each block, can be null
+  uint32_t checksum;                // of the block render with 8 channels at 22050Hz, 0 if unknown
+};
+
+static int voices(int count) {
+  return count < CHANNEL_COUNT ? count : CHANNEL_COUNT;
+}
+
+// deterministic data for the sample scenarios
+static uint32_t data_seed;
+
+static uint32_t next_random() {
+  data_seed = data_seed * 1664525 + 1013904223;
+  return data_seed >> 8;
+}
+
+// commands for the scenario, queued a block ahead while rendering as the queue is small
+static std::vector<AudioCommand> script;
+
+static void command(uint32_t ms, int channel, AudioCommandType type, uint16_t value = 0) {
+  script.push_back({uint32_t(uint64_t(ms) * sample_rate / 1000), uint8_t(channel), type, value});
+}
+
+static void note(uint32_t on_ms, uint32_t off_ms, int channel, uint16_t frequency) {
+  command(on_ms, channel, AudioCommandType::NOTE_ON, frequency);
+  command(off_ms, channel, AudioCommandType::NOTE_OFF);
+}
+
+// each of the oscillator waveforms and some combinations, with envelopes
+static void setup_tones() {
+  static const uint8_t waveforms[]{
+    Waveform::SQUARE, Waveform::SAW, Waveform::TRIANGLE, Waveform::SINE,
+    Waveform::NOISE, Waveform::SQUARE | Waveform::SAW, Waveform::TRIANGLE | Waveform::SAW, Waveform::SINE | Waveform::SQUARE
+  };
+
+  for(int c = 0; c < voices(8); c++) {
+    auto &channel = channels[c];
+    channel.waveforms = waveforms[c];
+    channel.volume = 0x2000;
+    channel.attack_ms = 5 + c * 10;
+    channel.decay_ms = 100;
+    channel.sustain = 0xa000;
+    channel.release_ms = 50 + c * 20;
+    channel.pulse_width = 0x4000 + c * 0x1000;
+
+    // a rising arpeggio per channel, some notes overlapping their release
+    for(int n = 0; n < 8; n++) {
+      uint32_t start = c * 70 + n * 450;
+      note(start, start + 300, c, 110 + c * 55 + n * 40);
+    }
+  }
+}
+
+// resonant filters with the cutoff swept by commands
+static void setup_filters() {
+  static const FilterType types[]{FilterType::LOW_PASS, FilterType::HIGH_PASS, FilterType::BAND_PASS};
+
+  for(int c = 0; c < voices(8); c++) {
+    auto &channel = channels[c];
+    channel.waveforms = c == 0 ? Waveform::SQUARE | Waveform::NOISE : (c & 1 ? Waveform::SAW : Waveform::SQUARE);
+    channel.volume = 0x1000;
+    channel.frequency = 80 + c * 30;
+    channel.attack_ms = 10;
+    channel.release_ms = 100;
+    channel.filter_enable = true;
+    channel.filter_type = types[c % 3];
+    channel.filter_cutoff_frequency = 200;
+    channel.filter_resonance = 0x100 + c * 0x80;
+
+    channel.trigger_attack();
+
+    for(uint32_t step = 0; step < 100; step++) {
+      uint16_t cutoff = 200 + uint16_t((sinf(step * 0.15f + c) + 1.0f) * 2500.0f);
+      command(step * 40, c, AudioCommandType::FILTER_CUTOFF_FREQUENCY, cutoff);
+    }
+  }
+}
+
+// PCM8/PCM16/ADPCM samples at various rates, looped and one-shot
+static void setup_samples() {
+  static int16_t pcm16[4096];
+  static int8_t pcm8[3000];
+  static uint8_t adpcm[2048];
+
+  data_seed = 1;
+
+  for(int i = 0; i < 4096; i++)
+    pcm16[i] = int16_t(sinf(2.0f * pi * i / 256.0f) * 12000.0f + sinf(2.0f * pi * i / 64.0f) * 4000.0f);
+
+  for(int i = 0; i < 3000; i++)
+    pcm8[i] = int8_t((int(next_random() & 0xff) - 128) * (3000 - i) / 3000);
+
+  // any nibbles are valid ADPCM
+  for(auto &b : adpcm)
+    b = next_random() & 0xff;
+
+  static const uint32_t rates[]{8000, 11025, 16000, 22050, 32000, 44100};
+
+  for(int c = 0; c < voices(8); c++) {
+    auto &channel = channels[c];
+    channel.waveforms = Waveform::SAMPLE;
+    channel.volume = 0x2800;
+    channel.attack_ms = 1;
+    channel.release_ms = 20;
+
+    switch(c % 3) {
+      case 0:
+        channel.set_sample(pcm16, 4096, SampleFormat::PCM16, rates[c % 6]);
+        channel.set_sample_loop(256, 4096);
+        break;
+      case 1:
+        channel.set_sample(pcm8, 3000, SampleFormat::PCM8, rates[c % 6]);
+        break;
+      case 2:
+        channel.set_sample(adpcm, 4096, SampleFormat::IMA_ADPCM, rates[c % 6]);
+        channel.set_sample_loop(0, 4096);
+        break;
+    }
+
+    for(int n = 0; n < 10; n++) {
+      uint32_t start = c * 35 + n * 390;
+      note(start, start + 250, c, 0);
+    }
+  }
+}
+
+// a 44.1kHz source resampled into a stream, fed between blocks like a game would
+static int16_t stream_buf[4096];
+static SampleStream stream(stream_buf, 4096);
+static Resampler resampler;
+static uint32_t stream_time;
+static float stream_phase;
+
+static void setup_stream() {
+  stream.reset();
+  resampler.set_rates(44100);
+  stream_time = 0;
+  stream_phase = 0.0f;
+
+  auto &channel = channels[0];
+  channel.waveforms = Waveform::SAMPLE;
+  channel.volume = 0xc000;
+  channel.set_sample_stream(&stream);
+  channel.adsr = 0xffff00;
+  channel.trigger_sustain();
+}
+
+static void update_stream(uint32_t) {
+  int16_t in[441];
+
+  while(stream.get_free() >= resampler.get_max_output(441)) {
+    // a sweep from 100Hz to 20kHz over four seconds, well above the output's Nyquist frequency
+    for(auto &s : in) {
+      float freq = std::min(100.0f * powf(200.0f, stream_time++ / (4.0f * 44100.0f)), 20000.0f);
+      s = int16_t(sinf(stream_phase * 2.0f * pi) * 20000.0f);
+
+      stream_phase += freq / 44100.0f;
+      if(stream_phase >= 1.0f)
+        stream_phase -= 1.0f;
+    }
+
+    resampler.write(stream, in, 441);
+  }
+}
+
+// everything at once, on every channel
+static void setup_full() {
+  setup_tones();
+
+  for(int c = 0; c < CHANNEL_COUNT; c++) {
+    auto &channel = channels[c];
+    channel.filter_enable = true;
+    channel.filter_type = FilterType::LOW_PASS;
+    channel.filter_cutoff_frequency = 1000 + c * 400;
+    channel.filter_resonance = 0x200;
+
+    if(c >= 8) {
+      channel.waveforms = Waveform::SAW | Waveform::SQUARE;
+      channel.volume = 0x1000;
+      channel.trigger_attack();
+    }
+  }
+}
+
+static const Scenario scenarios[]{
+  {"tones", "oscillators with envelopes", voices(8), 4, setup_tones, nullptr, 0xbd1a4d88},
+  {"filters", "swept resonant filters", voices(8), 4, setup_filters, nullptr, 0x3610136c},
+  {"samples", "PCM8/PCM16/ADPCM samples", voices(8), 4, setup_samples, nullptr, 0xe5b76925},
+  {"stream", "44.1kHz stream resampled", 1, 4, setup_stream, update_stream, 0xdce40f4a},
+  {"full", "all channels with filters", CHANNEL_COUNT, 4, setup_full, nullptr, 0x39ccd42c},
+};
+
+static void reset_engine() {
+  for(auto &channel : render_channels)
+    channel = AudioChannel();
+
+  render_queue.reset(new AudioCommandQueue);
+
+  api.channels = render_channels;
+  api.audio_commands = render_queue.get();
+
+  prng_lfsr = 0x32B71700;
+  blit::volume = 0xffff;
+}
+
+// FNV-1a over the samples
+static uint32_t checksum(const std::vector<int16_t> &samples) {
+  uint32_t hash = 2166136261u;
+
+  for(auto s : samples) {
+    hash = (hash ^ (uint16_t(s) & 0xff)) * 16777619u;
+    hash = (hash ^ (uint16_t(s) >> 8)) * 16777619u;
+  }
+
+  return hash;
+}
+
+static bool write_wav(const std::string &filename, const std::vector<int16_t> &samples) {
+  FILE *f = fopen(filename.c_str(), "wb");
+  if(!f)
+    return false;
+
+  uint32_t data_size = samples.size() * 2, riff_size = data_size + 36, rate = sample_rate, byte_rate = sample_rate * 2;
+  uint16_t format = 1, channel_count = 1, block_align = 2, bits = 16;
+  uint32_t fmt_size = 16;
+
+  // assumes a little-endian host, like the rest of the engine
+  fwrite("RIFF", 1, 4, f);
+  fwrite(&riff_size, 4, 1, f);
+  fwrite("WAVEfmt ", 1, 8, f);
+  fwrite(&fmt_size, 4, 1, f);
+  fwrite(&format, 2, 1, f);
+  fwrite(&channel_count, 2, 1, f);
+  fwrite(&rate, 4, 1, f);
+  fwrite(&byte_rate, 4, 1, f);
+  fwrite(&block_align, 2, 1, f);
+  fwrite(&bits, 2, 1, f);
+  fwrite("data", 1, 4, f);
+  fwrite(&data_size, 4, 1, f);
+  fwrite(samples.data(), 2, samples.size(), f);
+
+  return fclose(f) == 0;
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsed_ns(Clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// renders a scenario, returns the time taken
+static double render_scenario(const Scenario &scenario, uint32_t seconds, uint32_t block_size, std::vector<int16_t> &out) {
+  reset_engine();
+
+  script.clear();
+  scenario.setup();
+  std::stable_sort(script.begin(), script.end(), [](const AudioCommand &a, const AudioCommand &b) {return a.time < b.time;});
+
+  uint32_t total = seconds * sample_rate;
+  out.resize(total);
+
+  // updates happen every 256 samples whatever the block size, so they don't change the output
+  const uint32_t update_interval = 256;
+  auto next_command = script.begin();
+
+  auto start = Clock::now();
+
+  for(uint32_t pos = 0; pos < total;) {
+    if(pos % update_interval == 0) {
+      for(; next_command != script.end() && next_command->time < pos + update_interval; ++next_command)
+        queue_audio_command(next_command->time, next_command->channel, next_command->type, next_command->value);
+
+      if(scenario.update)
+        scenario.update(pos);
+    }
+
+    uint32_t count = std::min(std::min(block_size, total - pos), update_interval - pos % update_interval);
+
+    if(block_size == 1)
+      out[pos] = int16_t(get_audio_frame() - 0x8000);
+    else
+      get_audio_frames(out.data() + pos, count);
+
+    pos += block_size == 1 ? 1 : count;
+  }
+
+  return elapsed_ns(start);
+}
+
+static void print_stats(const char *name, const char *mode, int voices, size_t samples, double ns) {
+  double ns_per_sample = ns / samples;
+  double audio_ns = double(samples) * 1e9 / sample_rate;
+
+  printf("  %-8s %-6s %2d voices  %9.0f samples/s  %8.1f ns/sample  %7.1f ns/sample/voice  %5.2f%% of real time\n",
+         name, mode, voices, samples * 1e9 / ns, ns_per_sample, ns_per_sample / std::max(voices, 1), ns * 100.0 / audio_ns);
+}
+
+static bool render_module(const std::string &filename, uint32_t seconds, uint32_t block_size, const std::string &wav_dir) {
+  TrackerPlayer player;
+  if(!player.load(filename)) {
+    printf("%s: failed to load\n", filename.c_str());
+    return false;
+  }
+
+  player.set_loop(false);
+
+  std::vector<int16_t> out(seconds * sample_rate);
+  uint32_t total = 0;
+
+  auto start = Clock::now();
+
+  while(total < out.size()) {
+    uint32_t count = std::min(block_size, uint32_t(out.size() - total));
+    uint32_t rendered = player.render(out.data() + total, count);
+    total += rendered;
+
+    if(rendered < count)
+      break;
+  }
+
+  double ns = elapsed_ns(start);
+  out.resize(total);
+
+  printf("%s: \"%s\", %d channels, checksum %08" PRIx32 "\n", filename.c_str(), player.get_title().c_str(), player.get_channel_count(), checksum(out));
+  print_stats("module", "block", player.get_channel_count(), total, ns);
+
+  if(!wav_dir.empty())
+    write_wav(wav_dir + "/module.wav", out);
+
+  return true;
+}
+
+// stdio file access, for loading modules
+static void *open_file(const std::string &file, int mode) {
+  return fopen(file.c_str(), mode & OpenMode::write ? "wb" : "rb");
+}
+
+static int32_t read_file(void *fh, uint32_t offset, uint32_t length, char *buffer) {
+  auto f = static_cast<FILE *>(fh);
+  if(fseek(f, offset, SEEK_SET) != 0)
+    return -1;
+
+  return fread(buffer, 1, length, f);
+}
+
+static int32_t close_file(void *fh) {
+  return fclose(static_cast<FILE *>(fh));
+}
+
+static uint32_t get_file_length(void *fh) {
+  auto f = static_cast<FILE *>(fh);
+  fseek(f, 0, SEEK_END);
+  return ftell(f);
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t block_size = 256, seconds = 0;
+  std::string wav_dir, module;
+  bool frame_render = true;
+  std::vector<std::string> only;
+
+  for(int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+
+    if(arg == "--block" && has_value)
+      block_size = std::max(atoi(argv[++i]), 1);
+    else if(arg == "--seconds" && has_value)
+      seconds = atoi(argv[++i]);
+    else if(arg == "--wav" && has_value)
+      wav_dir = argv[++i];
+    else if(arg == "--mod" && has_value)
+      module = argv[++i];
+    else if(arg == "--no-frame")
+      frame_render = false;
+    else if(arg[0] == '-') {
+      printf("Usage: %s [--block N] [--seconds N] [--wav DIR] [--mod FILE] [--no-frame] [scenario...]\n", argv[0]);
+      return 1;
+    } else
+      only.push_back(arg);
+  }
+
+  api.open_file = open_file;
+  api.read_file = read_file;
+  api.close_file = close_file;
+  api.get_file_length = get_file_length;
+
+  // the checksums are for the default configuration
+  bool check = CHANNEL_COUNT == 8 && sample_rate == 22050;
+
+  printf("%d channels at %" PRIu32 "Hz, blocks of %" PRIu32 " samples\n", CHANNEL_COUNT, sample_rate, block_size);
+
+  bool ok = true;
+
+  for(auto &scenario : scenarios) {
+    if(!only.empty() && std::find(only.begin(), only.end(), scenario.name) == only.end())
+      continue;
+
+    uint32_t scenario_seconds = seconds ? seconds : scenario.seconds;
+
+    std::vector<int16_t> block_out, frame_out;
+    double block_ns = render_scenario(scenario, scenario_seconds, block_size, block_out);
+
+    uint32_t sum = checksum(block_out);
+    const char *result = "";
+
+    // the checksum only covers the scenario's own length
+    if(check && scenario_seconds == scenario.seconds && scenario.checksum) {
+      result = sum == scenario.checksum ? " ok" : " MISMATCH";
+      ok = ok && sum == scenario.checksum;
+    }
+
+    printf("%s: %s, checksum %08" PRIx32 "%s\n", scenario.name, scenario.description, sum, result);
+    print_stats(scenario.name, "block", scenario.voices, block_out.size(), block_ns);
+
+    if(frame_render) {
+      double frame_ns = render_scenario(scenario, scenario_seconds, 1, frame_out);
+      print_stats(scenario.name, "frame", scenario.voices, frame_out.size(), frame_ns);
+
+      if(frame_out != block_out) {
+        auto diff = std::mismatch(block_out.begin(), block_out.end(), frame_out.begin());
+        printf("  get_audio_frame output differs from get_audio_frames at sample %u\n", unsigned(diff.first - block_out.begin()));
+        ok = false;
+      }
+    }
+
+    if(!wav_dir.empty() && !write_wav(wav_dir + "/" + scenario.name + ".wav", block_out))
+      printf("  failed to write %s/%s.wav\n", wav_dir.c_str(), scenario.name);
+  }
+
+  if(!module.empty())
+    ok = render_module(module, seconds ? seconds : 600, block_size, wav_dir) && ok;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Pack a sequence of JPEG images into a 32blit video file (blit::VideoStream).
+
+Frames must be baseline (not progressive) JPEGs of the same size. ffmpeg can
+produce suitable frames from any video:
+
+    ffmpeg -i input.mp4 -vf scale=320:240 -q:v 8 frames/%05d.jpg
+    pack-video.py --fps 25 -o video.blv frames/*.jpg
+
+or a test pattern for benchmarking:
+
+    ffmpeg -f lavfi -i testsrc=size=320x240:rate=25 -t 10 -q:v 8 frames/%05d.jpg
+
+The audio track can be converted separately and played with MP3Stream:
+
+    ffmpeg -i input.mp4 -vn -ac 1 -ar 22050 -b:a 64k audio.mp3
+"""
+
+import argparse
+import fractions
+import struct
+import sys
+
+HEADER = struct.Struct('<4sHHHHHHII')
+FORMAT_MJPEG = 0
+
+
+def jpeg_size(data, name):
+    """Return (width, height) of a JPEG, rejecting ones the decoder can't handle."""
+    if data[:2] != b'\xff\xd8':
+        raise ValueError(f'{name}: not a JPEG')
+
+    pos = 2
+    while pos + 4 <= len(data):
+        if data[pos] != 0xFF:
+            raise ValueError(f'{name}: corrupt marker')
+
+        marker = data[pos + 1]
+        if marker == 0xFF:
+            pos += 1
+            continue
+
+        length = struct.unpack('>H', data[pos + 2:pos + 4])[0]
+
+        if marker in (0xC0, 0xC1):
+            precision, height, width, comps = struct.unpack('>BHHB', data[pos + 4:pos + 10])
+            if precision != 8 or comps not in (1, 3):
+                raise ValueError(f'{name}: unsupported precision/components')
+            return width, height
+
+        if 0xC2 <= marker <= 0xCF and marker not in (0xC4, 0xC8, 0xCC):
+            raise ValueError(f'{name}: progressive/arithmetic JPEGs are not supported')
+
+        pos += 2 + length
+
+    raise ValueError(f'{name}: no frame header')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('frames', nargs='+', help='JPEG frames, in order')
+    parser.add_argument('-o', '--output', required=True, help='output file')
+    parser.add_argument('--fps', default='25', help='frame rate, can be a fraction (30000/1001)')
+    args = parser.parse_args()
+
+    fps = fractions.Fraction(args.fps).limit_denominator(0xFFFF)
+    if fps <= 0 or fps.numerator > 0xFFFF:
+        parser.error('invalid frame rate')
+
+    size = None
+    max_frame_size = 0
+
+    with open(args.output, 'wb') as out:
+        out.write(b'\0' * HEADER.size)
+
+        for name in args.frames:
+            with open(name, 'rb') as f:
+                data = f.read()
+
+            frame_size = jpeg_size(data, name)
+            if size is None:
+                size = frame_size
+            elif frame_size != size:
+                sys.exit(f'{name}: size {frame_size} does not match first frame {size}')
+
+            out.write(struct.pack('<I', len(data)))
+            out.write(data)
+            max_frame_size = max(max_frame_size, len(data))
+
+        out.seek(0)
+        out.write(HEADER.pack(b'BLVD', FORMAT_MJPEG, size[0], size[1], fps.numerator, fps.denominator, 0,
+                              len(args.frames), max_frame_size))
+
+    print(f'{len(args.frames)} frames, {size[0]}x{size[1]} @ {float(fps):.2f} fps, largest frame {max_frame_size} bytes')
+
+
+if __name__ == '__main__':
+    main()